@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Latency of small captures queued behind a huge one, `CaptureService`
+versus the fair `pywebcopy.daemon.Daemon`.
+
+Every point submits the crawl of the whole synthetic site (`bench_site.py`)
+first and then `small` captures of single pages of it. The service runs
+every job on a worker of its own from start to end, so the small jobs wait
+for a free worker while the site keeps its worker; the daemon shares
+`workers` threads between all the jobs file by file by deficit round
+robin. The latency of the small jobs (submit to done) and the time of the
+site crawl are measured.
+
+    python bench_daemon.py
+    python bench_daemon.py --pages 1000 --small 50 --workers 2,8
+
+Results go to a CSV (default res/daemon.csv).
+"""
+
+import os, sys, csv, time, shutil, argparse, tempfile, statistics
+from typing import Dict, List
+
+from pywebcopy.daemon import Daemon
+from pywebcopy.service import CaptureService
+
+from bench_site import page_path, serve_site
+
+# ------------------------------ Captures --------------------------------------
+
+def with_service(site: str, smalls: List[str], workers: int, folder: str) -> Dict:
+    with CaptureService(folder, workers=workers, bypass_robots=True) as service:
+        t0 = time.perf_counter()
+        big = service.submit_site(site)
+        ends = {}
+        futures = []
+        for u in smalls:
+            start, future = time.perf_counter(), service.submit_page(u)
+            future.add_done_callback(lambda f, start=start: ends.__setitem__(f, time.perf_counter() - start))
+            futures.append(future)
+        big.add_done_callback(lambda f: ends.__setitem__(f, time.perf_counter() - t0))
+        for future in futures + [big]:
+            future.result()
+        return {"site_s": ends[big], "latencies": [ends[f] for f in futures]}
+
+
+def with_daemon(site: str, smalls: List[str], workers: int, folder: str) -> Dict:
+    daemon = Daemon(os.path.join(folder, "bench.sock"), folder, workers=workers, bypass_robots=True)
+    try:
+        t0 = time.time()
+        big = daemon.submit(site, kind="site", tenant="huge")
+        jobs = [daemon.submit(u, tenant="small") for u in smalls]
+        for job in jobs + [big]:
+            job.done.wait()
+        return {"site_s": big.finished - t0,
+                "latencies": [job.finished - job.created for job in jobs]}
+    finally:
+        daemon.server_close()
+
+
+def run(mode: str, site: str, smalls: List[str], workers: int) -> Dict:
+    folder = tempfile.mkdtemp(prefix="pwc-daemon-")
+    try:
+        r = (with_service if mode == "service" else with_daemon)(site, smalls, workers, folder)
+    finally:
+        shutil.rmtree(folder, ignore_errors=True)
+    lat = sorted(r.pop("latencies"))
+    return {"mode": mode, "workers": workers, "small_p50_s": statistics.median(lat),
+            "small_max_s": lat[-1], **r}
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Small captures behind a huge one, service versus daemon.")
+    p.add_argument("--pages", type=int, default=300, help="Pages of the site crawled.")
+    p.add_argument("--small", type=int, default=20, help="Single page captures queued after it.")
+    p.add_argument("--workers", default="2,8", help="Comma separated worker counts.")
+    p.add_argument("--csv", default="res/daemon.csv", help="CSV output file.")
+    args = p.parse_args()
+
+    counts = [int(x) for x in args.workers.split(",") if x.strip()]
+    rows = []
+    with serve_site(pages=args.pages, processes=min(4, os.cpu_count() or 1)) as url:
+        smalls = [url.rstrip("/") + page_path(i) for i in range(args.small)]
+        for workers in counts:
+            for mode in ("service", "daemon"):
+                rows.append(run(mode, url, smalls, workers))
+
+    print("-----------------------------------------------------------------")
+    print(f"{'mode':<8} {'workers':>7} {'small p50':>10} {'small max':>10} {'site s':>9}")
+    for r in rows:
+        print(f"{r['mode']:<8} {r['workers']:>7} {r['small_p50_s']:>10.3f} {r['small_max_s']:>10.3f} "
+              f"{r['site_s']:>9.3f}")
+
+    os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+    fields = ["mode", "workers", "small_p50_s", "small_max_s", "site_s"]
+    with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+        w = csv.DictWriter(fh, fieldnames=fields)
+        w.writeheader()
+        w.writerows(rows)
+    print(f"Wrote CSV -> {args.csv}")
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Page captures with a deadline versus without one when some assets stall.
+
+The synthetic site (`bench_site.py`) is served with a share `--slow` of
+its images answering only after `--stall` seconds, like a stuck third
+party server. Every point captures the first page with `save_complete()`
+and with `save_complete(deadline=...)` for every deadline given, and
+reports the time taken, the files fetched and the ones left online
+(dropped before being requested or cancelled while being fetched).
+
+    python bench_deadline.py
+    python bench_deadline.py --stall 5 --slow 20 --deadlines 0.5,1,2
+
+Results go to a CSV (default res/deadline.csv).
+"""
+
+import os, sys, csv, time, zlib, shutil, argparse, tempfile
+from typing import Dict, Optional
+
+from pywebcopy.configs import get_config
+
+from bench_site import Site, SiteHandler, SiteServer, serve_site
+
+# ------------------------------ Stalling server -------------------------------
+
+class StallHandler(SiteHandler):
+    def do_GET(self):
+        server = self.server
+        path = self.path.split("?", 1)[0]
+        if path.startswith("/img/") and zlib.crc32(path.encode()) % 100 < server.slow:
+            time.sleep(server.stall)
+        super().do_GET()
+
+
+def stall_server(slow: int, stall: float):
+    class StallServer(SiteServer):
+        def __init__(self, site: Site, **kwargs):
+            kwargs["handler"] = StallHandler
+            super().__init__(site, **kwargs)
+            self.slow, self.stall = slow, stall
+    return StallServer
+
+# ------------------------------ Captures --------------------------------------
+
+def capture(url: str, deadline: Optional[float]) -> Dict:
+    folder = tempfile.mkdtemp(prefix="pwc-deadline-")
+    try:
+        config = get_config(url, folder, "deadline", bypass_robots=True)
+        page = config.create_page()
+        t0 = time.perf_counter()
+        report = page.save_complete(deadline=deadline)
+        wall = time.perf_counter() - t0
+        page.session.close()
+    finally:
+        shutil.rmtree(folder, ignore_errors=True)
+    if deadline is None:
+        return {"deadline": "none", "seconds": wall, "fetched": len(page.scheduler.index),
+                "dropped": 0, "cancelled": 0}
+    return {"deadline": deadline, "seconds": wall, "fetched": len(report.fetched),
+            "dropped": len(report.dropped), "cancelled": len(report.cancelled)}
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Page captures with and without a deadline.")
+    p.add_argument("--slow", type=int, default=15, help="Percent of the images which stall.")
+    p.add_argument("--stall", type=float, default=3.0, help="Seconds a stalling image waits.")
+    p.add_argument("--deadlines", default="0.5,1,2", help="Comma separated deadlines in seconds.")
+    p.add_argument("--csv", default="res/deadline.csv", help="CSV output file.")
+    args = p.parse_args()
+
+    deadlines = [float(x) for x in args.deadlines.split(",") if x.strip()]
+    rows = []
+    with serve_site(pages=10, server_cls=stall_server(args.slow, args.stall)) as url:
+        for deadline in [None] + deadlines:
+            rows.append(capture(url, deadline))
+
+    print("-----------------------------------------------------------------")
+    print(f"{'deadline':>8} {'seconds':>9} {'fetched':>8} {'dropped':>8} {'cancelled':>10}")
+    for r in rows:
+        print(f"{r['deadline']:>8} {r['seconds']:>9.3f} {r['fetched']:>8} {r['dropped']:>8} "
+              f"{r['cancelled']:>10}")
+
+    os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+    fields = ["deadline", "seconds", "fetched", "dropped", "cancelled"]
+    with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+        w = csv.DictWriter(fh, fieldnames=fields)
+        w.writeheader()
+        w.writerows(rows)
+    print(f"Wrote CSV -> {args.csv}")
+
+if __name__ == "__main__":
+    sys.exit(main())
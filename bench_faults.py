@@ -0,0 +1,344 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Resilience benchmark: crawl the synthetic site through a fault injecting
+server and report goodput and wasted work for every scheduler.
+
+Fault profiles (see PROFILES, combine with --profiles):
+
+    clean        no faults, the baseline
+    429          random 429 Too Many Requests with a Retry-After header
+    503-burst    every response is a 503 during periodic bursts
+    slowloris    bodies trickle out in small chunks with pauses
+    reset        connection reset (RST) half way through the body
+    gzip-bomb    small gzip payloads which inflate to many megabytes
+    redirects    chains of 302 redirects before the real resource
+    mixed        a bit of everything
+
+Clients ("schedulers"):
+
+    sync, threading, pool   pywebcopy crawls with the respective scheduler
+    scrape-retry            bench_scrape's fetch loop (429/503 backoff + retries)
+
+For each pair the benchmark reports: good pages (saved with the expected
+content) per second, the fraction of expected pages captured, requests and
+bytes the server spent on responses that produced nothing useful, and the
+bytes the client wrote to disk beyond the useful ones (e.g. inflated bombs).
+
+    python bench_faults.py
+    python bench_faults.py --pages 100 --profiles 429,reset --clients sync,scrape-retry
+"""
+
+import os, re, sys, csv, gzip, time, random, socket, struct, shutil, argparse, tempfile, threading
+from collections import Counter, deque
+from functools import partial
+from urllib.parse import urljoin, urlparse
+
+from bench_site import Site, SiteHandler, SiteServer, serve_site
+
+# ------------------------------ Fault profiles --------------------------------
+
+class FaultProfile(object):
+    """Probabilities and parameters of the injected faults.
+
+    The server records what it did in `stats` so the numbers survive the
+    server shutting down.
+    """
+
+    def __init__(self, name, p429=0.0, retry_after=1, burst_every=0.0, burst_len=0.0,
+                 p_slow=0.0, slow_chunk=256, slow_pause=0.02, p_reset=0.0,
+                 p_bomb=0.0, bomb_mb=16, p_redirect=0.0, redirect_hops=3, seed=0):
+        self.name = name
+        self.p429, self.retry_after = p429, retry_after
+        self.burst_every, self.burst_len = burst_every, burst_len
+        self.p_slow, self.slow_chunk, self.slow_pause = p_slow, slow_chunk, slow_pause
+        self.p_reset = p_reset
+        self.p_bomb, self.bomb_mb = p_bomb, bomb_mb
+        self.p_redirect, self.redirect_hops = p_redirect, redirect_hops
+        self.rng = random.Random(seed)
+        self.lock = threading.Lock()
+        self.started = time.monotonic()
+        self.stats = Counter()
+        self._bomb = None
+
+    def roll(self, p: float) -> bool:
+        if p <= 0:
+            return False
+        with self.lock:
+            return self.rng.random() < p
+
+    def in_burst(self) -> bool:
+        if not self.burst_every:
+            return False
+        # the burst closes each period so the very first request gets through
+        phase = (time.monotonic() - self.started) % self.burst_every
+        return phase >= self.burst_every - self.burst_len
+
+    def bomb(self) -> bytes:
+        if self._bomb is None:
+            self._bomb = gzip.compress(b"\0" * (self.bomb_mb << 20), 9)
+        return self._bomb
+
+    def count(self, key: str, n: int = 1):
+        with self.lock:
+            self.stats[key] += n
+
+    def reset_stats(self):
+        with self.lock:
+            self.stats = Counter()
+            self.started = time.monotonic()
+
+
+PROFILES = {
+    "clean": dict(),
+    "429": dict(p429=0.2, retry_after=1),
+    "503-burst": dict(burst_every=0.5, burst_len=0.1),
+    "slowloris": dict(p_slow=0.15, slow_chunk=256, slow_pause=0.02),
+    "reset": dict(p_reset=0.1),
+    "gzip-bomb": dict(p_bomb=0.05, bomb_mb=16),
+    "redirects": dict(p_redirect=0.3, redirect_hops=4),
+    "mixed": dict(p429=0.05, burst_every=1.0, burst_len=0.1, p_slow=0.05,
+                  p_reset=0.03, p_bomb=0.01, p_redirect=0.1),
+}
+
+# ------------------------------ Server ----------------------------------------
+
+class FaultHandler(SiteHandler):
+
+    def _send(self, status, headers, body=b""):
+        self.send_response(status)
+        for k, v in headers:
+            self.send_header(k, v)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        prof: FaultProfile = self.server.profile
+        prof.count("requests")
+        path, _, query = self.path.partition("?")
+        hop = re.match(r"^/__hop/(\d+)(/.*)$", path)
+
+        if prof.in_burst():
+            prof.count("faults.503")
+            body = b"burst in progress"
+            prof.count("wasted_bytes", len(body))
+            return self._send(503, [("Content-Type", "text/plain"), ("Retry-After", "1")], body)
+        if prof.roll(prof.p429):
+            prof.count("faults.429")
+            body = b"too many requests"
+            prof.count("wasted_bytes", len(body))
+            return self._send(429, [("Content-Type", "text/plain"),
+                                    ("Retry-After", str(prof.retry_after))], body)
+        if hop is None and path != "/robots.txt" and prof.roll(prof.p_redirect):
+            prof.count("faults.redirect")
+            return self._send(302, [("Location", "/__hop/%d%s" % (prof.redirect_hops - 1, self.path))])
+        if hop is not None:
+            left, rest = int(hop.group(1)), hop.group(2)
+            prof.count("redirect_hops")
+            if left > 0:
+                return self._send(302, [("Location", "/__hop/%d%s" % (left - 1, rest))])
+            return self._send(302, [("Location", rest + ("?" + query if query else ""))])
+
+        status, ctype, body = self.server.site.route(self.path)
+        if status == 200 and prof.roll(prof.p_bomb):
+            bomb = prof.bomb()
+            prof.count("faults.gzip_bomb")
+            prof.count("wasted_bytes", len(bomb))
+            return self._send(200, [("Content-Type", ctype), ("Content-Encoding", "gzip")], bomb)
+        if status == 200 and prof.roll(prof.p_reset):
+            prof.count("faults.reset")
+            self.send_response(200)
+            self.send_header("Content-Type", ctype)
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            half = body[: len(body) // 2]
+            self.wfile.write(half)
+            prof.count("wasted_bytes", len(half))
+            # SO_LINGER(1, 0) turns close() into a RST
+            self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+            self.close_connection = True
+            self.connection.close()
+            return
+        if status == 200 and prof.roll(prof.p_slow):
+            prof.count("faults.slowloris")
+            self.send_response(200)
+            self.send_header("Content-Type", ctype)
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            for i in range(0, len(body), prof.slow_chunk):
+                self.wfile.write(body[i:i + prof.slow_chunk])
+                time.sleep(prof.slow_pause)
+            prof.count("useful_bytes", len(body))
+            return
+        if status != 200:
+            prof.count("wasted_bytes", len(body))
+        else:
+            prof.count("useful_bytes", len(body))
+        return self._send(status, [("Content-Type", ctype)], body)
+
+    def finish(self):
+        try:
+            super().finish()
+        except OSError:  # the socket was reset on purpose
+            pass
+
+
+class FaultServer(SiteServer):
+    def __init__(self, site: Site, profile: FaultProfile = None, **kwargs):
+        self.profile = profile
+        super().__init__(site, handler=FaultHandler, **kwargs)
+
+    def handle_error(self, request, client_address):
+        if not isinstance(sys.exc_info()[1], OSError):
+            super().handle_error(request, client_address)
+
+# ------------------------------ Clients ---------------------------------------
+
+def crawl_pywebcopy(url: str, sched: str, workers: int, folder: str, timeout: float):
+    from pywebcopy.configs import get_config
+    from pywebcopy.core import Crawler
+    from pywebcopy import schedulers
+
+    cfg = get_config(url, project_folder=folder, project_name="faults", bypass_robots=True)
+    session = cfg.create_session()
+    # a hanging slowloris body would otherwise block the benchmark forever
+    session.request = partial(session.request, timeout=timeout)
+    statuses = Counter()
+    session.hooks["response"].append(lambda r, *a, **k: statuses.update([r.status_code]))
+    if sched == "sync":
+        scheduler = schedulers.crawler_scheduler()
+    elif sched == "threading":
+        scheduler = schedulers.threading_crawler_scheduler()
+    else:
+        scheduler = schedulers.thread_pool_crawler_scheduler(maxsize=workers)
+    crawler = Crawler(session, cfg, scheduler, cfg.create_context())
+    try:
+        crawler.get(url)
+        crawler.save_complete(pop=False)
+    except Exception as e:
+        statuses["error:" + e.__class__.__name__] += 1
+    join = getattr(scheduler, "join", None)
+    if join is not None:
+        join()
+    close = getattr(scheduler, "close", None)
+    if close is not None:
+        close()
+    return statuses
+
+def crawl_scrape_retry(url: str, folder: str, timeout: float):
+    """Breadth first crawl of the html pages using bench_scrape's retrying fetch."""
+    import bench_scrape
+    from pywebcopy.session import Session
+
+    bench_scrape.BACKOFF_CAP = 1.0
+    sess = Session(); sess.headers.update(bench_scrape.DEFAULT_HEADERS)
+    statuses = Counter()
+    sess.hooks["response"].append(lambda r, *a, **k: statuses.update([r.status_code]))
+    host = urlparse(url).netloc
+    seen, queue = {url}, deque([url])
+    while queue:
+        u = queue.popleft()
+        try:
+            code, body, final = bench_scrape._fetch_optimized(sess, u, timeout, False)
+        except Exception as e:
+            statuses["error:" + e.__class__.__name__] += 1
+            continue
+        path = os.path.join(folder, re.sub(r"[^A-Za-z0-9_.-]+", "_", urlparse(u).path or "_") + ".html")
+        with open(path, "wb") as fh:
+            fh.write(body)
+        soup, _, _ = bench_scrape._parse_title_links(body)
+        for a in soup.find_all("a", href=True):
+            v = urljoin(final, a["href"]).split("#", 1)[0]
+            if urlparse(v).netloc == host and v not in seen:
+                seen.add(v); queue.append(v)
+    return statuses
+
+# ------------------------------ Scoring ---------------------------------------
+
+_marker = re.compile(rb"<h1>Page (\d+)</h1>")
+
+def score(folder: str, pages: int):
+    """Returns (good page ids, bytes on disk)."""
+    good, disk = set(), 0
+    for root, _, files in os.walk(folder):
+        for f in files:
+            p = os.path.join(root, f)
+            size = os.path.getsize(p)
+            disk += size
+            if size > (4 << 20):  # inflated bombs are never pages
+                continue
+            with open(p, "rb") as fh:
+                m = _marker.search(fh.read())
+            if m and int(m.group(1)) < pages:
+                good.add(int(m.group(1)))
+    return good, disk
+
+def run_point(profile: FaultProfile, client: str, pages: int, workers: int, timeout: float, site: Site):
+    folder = tempfile.mkdtemp(prefix="pwc-faults-")
+    try:
+        with serve_site(site=site, server_cls=partial(FaultServer, profile=profile)) as url:
+            profile.reset_stats()
+            t0 = time.perf_counter()
+            if client == "scrape-retry":
+                statuses = crawl_scrape_retry(url, folder, timeout)
+            else:
+                statuses = crawl_pywebcopy(url, client, workers, folder, timeout)
+            wall = time.perf_counter() - t0
+        good, disk = score(folder, pages)
+    finally:
+        shutil.rmtree(folder, ignore_errors=True)
+    st = profile.stats
+    useful = sum(len(site.page(i)) for i in good)
+    faults = {k[7:]: v for k, v in st.items() if k.startswith("faults.")}
+    return {
+        "profile": profile.name, "client": client,
+        "seconds": round(wall, 3),
+        "good_pages": len(good),
+        "captured": round(len(good) / pages, 3),
+        "goodput_pages_s": round(len(good) / wall, 2) if wall else 0.0,
+        "requests": st["requests"],
+        "requests_per_good_page": round(st["requests"] / max(1, len(good)), 2),
+        "server_wasted_bytes": st["wasted_bytes"],
+        "disk_bytes": disk,
+        "disk_wasted_bytes": max(0, disk - useful),
+        "faults": " ".join("%s=%d" % kv for kv in sorted(faults.items())),
+        "statuses": " ".join("%s=%d" % (k, v) for k, v in sorted(statuses.items(), key=str)),
+    }
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Goodput and wasted work of crawls under injected faults.")
+    p.add_argument("--pages", type=int, default=60, help="Pages of the synthetic site.")
+    p.add_argument("--profiles", default=",".join(PROFILES), help="Comma separated fault profiles.")
+    p.add_argument("--clients", default="sync,threading,pool,scrape-retry", help="Comma separated clients.")
+    p.add_argument("--workers", type=int, default=8, help="Workers of the pool scheduler.")
+    p.add_argument("--timeout", type=float, default=10.0, help="Per-request timeout (s).")
+    p.add_argument("--seed", type=int, default=0, help="Seed of the fault dice.")
+    p.add_argument("--csv", default="res/faults.csv", help="CSV output file.")
+    args = p.parse_args()
+
+    site = Site(args.pages)
+    rows = []
+    for pname in [x.strip() for x in args.profiles.split(",") if x.strip()]:
+        if pname not in PROFILES:
+            print(f"unknown profile {pname!r}, choose from {', '.join(PROFILES)}"); continue
+        for client in [x.strip() for x in args.clients.split(",") if x.strip()]:
+            prof = FaultProfile(pname, seed=args.seed, **PROFILES[pname])
+            r = run_point(prof, client, args.pages, args.workers, args.timeout, site)
+            rows.append(r)
+            print(f"{pname:<10} {client:<12} captured={r['captured']*100:5.1f}%  "
+                  f"goodput={r['goodput_pages_s']:7.1f} pages/s  req/page={r['requests_per_good_page']:5.2f}  "
+                  f"wasted srv={r['server_wasted_bytes']/1024:8.0f}KB disk={r['disk_wasted_bytes']/1024:8.0f}KB  "
+                  f"[{r['faults']}]")
+
+    if rows:
+        os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+        with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+            w = csv.DictWriter(fh, fieldnames=list(rows[0].keys()))
+            w.writeheader(); w.writerows(rows)
+        print(f"Wrote CSV -> {args.csv}")
+
+if __name__ == "__main__":
+    sys.exit(main())
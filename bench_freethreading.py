@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Parallel speedup of page processing on free-threaded CPython (3.13t+).
+
+Parsing, rewriting and writing html pages is CPU bound; with the GIL a
+second thread adds nothing. Every point processes the same synthetic pages
+(`bench_site.py`) from memory on `threads` threads sharing one scheduler,
+so the shared `Index`, url path cache and config are exercised exactly like
+in a threaded crawl, without the network in the way. A crawl of the local
+site with the thread pool scheduler is measured too unless `--no-crawl`.
+
+With `--offload` the pages are parsed and rewritten by a
+`pywebcopy.offload.Offloader` (subinterpreters on 3.14+, else processes)
+and the threads only schedule the links.
+
+    python bench_freethreading.py
+    python -X gil=0 bench_freethreading.py --threads 1,2,4,8,16 --pages 400
+    python bench_freethreading.py --offload processes --workers 4
+
+Results go to a CSV (default res/freethreading.csv).
+"""
+
+import os, io, sys, csv, time, shutil, argparse, tempfile, threading, sysconfig
+from typing import Dict, List
+
+from requests import Response
+
+from pywebcopy.configs import get_config
+from pywebcopy.core import Crawler
+from pywebcopy.elements import HTMLResource
+from pywebcopy.offload import Offloader
+from pywebcopy.schedulers import crawler_scheduler, thread_pool_crawler_scheduler
+from pywebcopy.urls import Context, HIERARCHY
+
+from bench_site import Site, page_path, serve_site
+
+# ------------------------------ Interpreter -----------------------------------
+
+def gil_state() -> str:
+    if not sysconfig.get_config_var("Py_GIL_DISABLED"):
+        return "gil"
+    enabled = getattr(sys, "_is_gil_enabled", lambda: True)()
+    return "free-threaded (gil re-enabled)" if enabled else "free-threaded"
+
+# ------------------------------ Page processing -------------------------------
+
+def process_pages(bodies: List[bytes], threads: int, folder: str, offload=None) -> Dict:
+    base = "http://127.0.0.1/"
+    config = get_config(base, folder, "freethreading", bypass_robots=True).freeze()
+    scheduler = crawler_scheduler()
+    scheduler.offload = offload
+    # children are claimed in the shared index but not fetched
+    scheduler._handle_resource = lambda resource: None
+
+    def work(offset: int):
+        for i in range(offset, len(bodies), threads):
+            response = Response()
+            response.status_code = 200
+            response.url = base + page_path(i)
+            response.headers["Content-Type"] = "text/html"
+            response.raw = io.BytesIO(bodies[i])
+            context = Context(response.url, base, folder, HIERARCHY)
+            HTMLResource(None, config, scheduler, context, response).retrieve()
+
+    workers = [threading.Thread(target=work, args=(k,)) for k in range(threads)]
+    c0, t0 = os.times(), time.perf_counter()
+    for t in workers:
+        t.start()
+    for t in workers:
+        t.join()
+    c1, t1 = os.times(), time.perf_counter()
+    wall = t1 - t0
+    cpu = (c1.user - c0.user) + (c1.system - c0.system)
+    return {"seconds": wall, "pages_per_s": len(bodies) / wall if wall else 0.0,
+            "cpu_util": cpu / wall if wall else 0.0, "index": len(scheduler.index)}
+
+# ---------------------------------- Crawl -------------------------------------
+
+def crawl(url: str, threads: int, folder: str, offload=None) -> Dict:
+    cfg = get_config(url, project_folder=folder, project_name="freethreading", bypass_robots=True)
+    scheduler = thread_pool_crawler_scheduler(maxsize=threads)
+    scheduler.offload = offload
+    crawler = Crawler(cfg.create_session(), cfg, scheduler, cfg.create_context())
+    t0 = time.perf_counter()
+    crawler.get(url)
+    crawler.save_complete(pop=False)
+    scheduler.join()
+    scheduler.close()
+    wall = time.perf_counter() - t0
+    pages = sum(1 for v in scheduler.index.items() if v[1] and v[1].endswith(".html"))
+    return {"seconds": wall, "pages_per_s": pages / wall if wall else 0.0, "index": len(scheduler.index)}
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Parallel speedup of pywebcopy on free-threaded CPython.")
+    p.add_argument("--threads", default="1,2,4,8", help="Comma separated thread counts.")
+    p.add_argument("--pages", type=int, default=200, help="Pages processed per point.")
+    p.add_argument("--repeat", type=int, default=3, help="Runs per point; the fastest is kept.")
+    p.add_argument("--no-crawl", action="store_true", help="Skip the crawl of the local site.")
+    p.add_argument("--offload", choices=("auto", "interpreters", "processes", "threads"),
+                   help="Parse and rewrite in an Offloader of this mode.")
+    p.add_argument("--workers", type=int, default=None, help="Offloader workers (default: cpus).")
+    p.add_argument("--csv", default="res/freethreading.csv", help="CSV output file.")
+    args = p.parse_args()
+
+    counts = [int(x) for x in args.threads.split(",") if x.strip()]
+    site = Site(args.pages)
+    bodies = [site.page(i) for i in range(args.pages)]
+    state = gil_state()
+    offload = Offloader(args.workers, args.offload) if args.offload else None
+    if offload is not None:
+        state += " + offload:" + offload.mode
+        # start the workers before measuring
+        offload.links(bodies[0], "utf-8").result()
+    print(f"Python {sys.version.split()[0]}  {state}  cpus={os.cpu_count()}")
+
+    rows = []
+    # ---- In-memory page processing ----
+    for threads in counts:
+        best = None
+        for _ in range(args.repeat):
+            folder = tempfile.mkdtemp(prefix="pwc-ft-")
+            try:
+                r = process_pages(bodies, threads, folder, offload)
+            finally:
+                shutil.rmtree(folder, ignore_errors=True)
+            if best is None or r["seconds"] < best["seconds"]:
+                best = r
+        rows.append({"bench": "process", "threads": threads, **best})
+
+    # ---- Crawl of the local site ----
+    if not args.no_crawl:
+        with serve_site(pages=args.pages, processes=min(4, os.cpu_count() or 1)) as url:
+            for threads in counts:
+                folder = tempfile.mkdtemp(prefix="pwc-ft-")
+                try:
+                    rows.append({"bench": "crawl", "threads": threads, **crawl(url, threads, folder, offload)})
+                finally:
+                    shutil.rmtree(folder, ignore_errors=True)
+
+    print("-----------------------------------------------------------------")
+    print(f"{'bench':<8} {'threads':>7} {'seconds':>9} {'pages/s':>9} {'speedup':>8} {'cpu':>6}")
+    single = {}
+    for r in rows:
+        single.setdefault(r["bench"], r["pages_per_s"])
+        r["speedup"] = r["pages_per_s"] / single[r["bench"]] if single[r["bench"]] else 0.0
+        r["interpreter"] = state
+        cpu = f"{r['cpu_util']:.2f}" if "cpu_util" in r else ""
+        print(f"{r['bench']:<8} {r['threads']:>7} {r['seconds']:>9.3f} {r['pages_per_s']:>9.1f} "
+              f"{r['speedup']:>7.2f}x {cpu:>6}")
+
+    if offload is not None:
+        offload.close()
+
+    os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+    fields = ["interpreter", "bench", "threads", "seconds", "pages_per_s", "speedup", "cpu_util", "index"]
+    with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+        w = csv.DictWriter(fh, fieldnames=fields, extrasaction="ignore")
+        w.writeheader()
+        w.writerows(rows)
+    print(f"Wrote CSV -> {args.csv}")
+
+if __name__ == "__main__":
+    sys.exit(main())
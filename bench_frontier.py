@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Budgeted crawl benchmark: how many of a site's heavily linked pages does a
+crawl limited to a fraction of the pages capture, in discovery (fifo)
+order versus OPIC importance order (pywebcopy.frontier).
+
+The synthetic site is a binary tree of pages (so everything is reachable)
+plus extra links whose targets follow a Zipf distribution over a random
+permutation of the pages, so popular pages sit at any depth. The "top"
+pages are the `--top` fraction with the highest in-degree.
+
+    python bench_frontier.py
+    python bench_frontier.py --pages 2000 --budgets 0.05,0.1,0.2
+"""
+
+import os, csv, time, random, shutil, argparse, tempfile
+from bisect import bisect
+from itertools import accumulate
+
+from bench_site import Site, page_path, serve_site
+
+# ------------------------------ Power-law site --------------------------------
+
+
+class PopularSite(Site):
+    """Pages with Zipf distributed extra links."""
+
+    def __init__(self, pages: int = 1000, seed: int = 0, extra_links: int = 8, skew: float = 1.1):
+        super().__init__(pages, seed)
+        rng = random.Random(seed)
+        order = list(range(1, self.pages))
+        rng.shuffle(order)
+        weights = list(accumulate(1.0 / (r + 1) ** skew for r in range(len(order))))
+        self.links = {}
+        self.indegree = [0] * self.pages
+        for i in range(self.pages):
+            out = [c for c in (2 * i + 1, 2 * i + 2) if c < self.pages]
+            if order:
+                out += [order[bisect(weights, rng.random() * weights[-1])] for _ in range(extra_links)]
+            out = sorted(set(out) - {i})
+            self.links[i] = out
+            for j in out:
+                self.indegree[j] += 1
+
+    def page(self, i: int) -> bytes:
+        body = self._cache.get(i)
+        if body is None:
+            links = "".join('<a href="%s">p%d</a> ' % (page_path(j), j) for j in self.links[i])
+            body = self._cache[i] = ("<!DOCTYPE html><html><head><title>Page %d</title></head>"
+                                     "<body><h1>Page %d</h1><p>%s</p></body></html>" % (i, i, links)).encode()
+        return body
+
+    def top(self, fraction: float):
+        ranked = sorted(range(self.pages), key=lambda i: -self.indegree[i])
+        return set(ranked[:max(1, int(self.pages * fraction))])
+
+
+# ------------------------------ Crawl -----------------------------------------
+
+def crawl(url: str, order: str, max_pages: int, folder: str):
+    from pywebcopy.configs import get_config
+    from pywebcopy.core import Crawler
+    from pywebcopy.frontier import frontier_crawler_scheduler
+
+    cfg = get_config(url, project_folder=folder, project_name="frontier", bypass_robots=True)
+    scheduler = frontier_crawler_scheduler(order, max_pages=max_pages)
+    crawler = Crawler(cfg.create_session(), cfg, scheduler, cfg.create_context())
+    crawler.get(url)
+    crawler.save_complete(pop=False)
+    return scheduler
+
+
+def captured(scheduler, base: str):
+    ids = set()
+    for url in scheduler.frontier.history:
+        path = "/" + url[len(base):]
+        if path == "/":
+            ids.add(0)
+        elif path.startswith("/page/") and path.endswith(".html"):
+            ids.add(int(path[6:-5]))
+    return ids
+
+
+def run_point(site: PopularSite, order: str, budget: float, top: set):
+    folder = tempfile.mkdtemp(prefix="pwc-frontier-")
+    try:
+        with serve_site(site=site) as url:
+            t0 = time.perf_counter()
+            sched = crawl(url, order, max(1, int(site.pages * budget)), folder)
+            wall = time.perf_counter() - t0
+            got = captured(sched, url)
+    finally:
+        shutil.rmtree(folder, ignore_errors=True)
+    return {
+        "order": order, "budget": budget, "pages": sched.stats["pages"],
+        "top_captured": round(len(got & top) / len(top), 4),
+        "indegree_share": round(sum(site.indegree[i] for i in got) / max(1, sum(site.indegree)), 4),
+        "seconds": round(wall, 3),
+    }
+
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Heavily linked pages captured by a budgeted crawl.")
+    p.add_argument("--pages", type=int, default=1000, help="Pages of the synthetic site.")
+    p.add_argument("--budgets", default="0.1", help="Comma separated page budgets as fractions of the site.")
+    p.add_argument("--orders", default="fifo,opic", help="Comma separated frontier orders.")
+    p.add_argument("--top", type=float, default=0.1, help="Fraction of pages counted as heavily linked.")
+    p.add_argument("--seed", type=int, default=0, help="Random seed of the site.")
+    p.add_argument("--csv", default="res/frontier.csv", help="CSV output file.")
+    args = p.parse_args()
+
+    site = PopularSite(args.pages, args.seed)
+    top = site.top(args.top)
+    rows = []
+    for budget in [float(x) for x in args.budgets.split(",") if x.strip()]:
+        for order in [x.strip() for x in args.orders.split(",") if x.strip()]:
+            r = run_point(site, order, budget, top)
+            rows.append(r)
+            print(f"budget={budget:5.2f} {order:<5} pages={r['pages']:5d}  "
+                  f"top {args.top:.0%} captured={r['top_captured']*100:5.1f}%  "
+                  f"in-link share={r['indegree_share']*100:5.1f}%  {r['seconds']:6.2f}s")
+
+    if rows:
+        os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+        with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+            w = csv.DictWriter(fh, fieldnames=list(rows[0].keys()))
+            w.writeheader(); w.writerows(rows)
+        print(f"Wrote CSV -> {args.csv}")
+
+
+if __name__ == "__main__":
+    main()
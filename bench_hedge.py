@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Tail latency of asset fetches with and without hedged requests.
+
+The server answers a share `--stuck` of the requests only after `--stall`
+seconds, like a stuck connection to a cdn edge; a second request for the
+same file is answered at once. Every point fetches `--requests` files
+through one `pywebcopy.session.Session` from `--threads` threads, once
+plainly and once with `session.enable_hedging(ratio)` for every ratio, and
+reports the latency percentiles and the extra requests sent.
+
+    python bench_hedge.py
+    python bench_hedge.py --requests 2000 --stuck 2 --ratios 0.02,0.05,0.1
+
+Results go to a CSV (default res/hedge.csv).
+"""
+
+import os, sys, csv, time, random, argparse, threading
+from concurrent.futures import ThreadPoolExecutor
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Dict, List, Optional
+
+from pywebcopy.session import Session
+
+# ------------------------------ Stalling server -------------------------------
+
+class StallHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_GET(self):
+        server = self.server
+        with server.lock:
+            server.requests += 1
+            first = self.path not in server.seen
+            server.seen.add(self.path)
+        if first and server.rng.random() < server.stuck:
+            time.sleep(server.stall)
+        body = b"x" * 2048
+        self.send_response(200)
+        self.send_header("Content-Type", "image/png")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+def serve(stuck: float, stall: float, seed: int) -> ThreadingHTTPServer:
+    srv = ThreadingHTTPServer(("127.0.0.1", 0), StallHandler)
+    srv.daemon_threads = True
+    srv.handle_error = lambda request, address: None
+    srv.lock, srv.seen, srv.requests = threading.Lock(), set(), 0
+    srv.rng, srv.stuck, srv.stall = random.Random(seed), stuck, stall
+    threading.Thread(target=srv.serve_forever, kwargs={"poll_interval": 0.05}, daemon=True).start()
+    return srv
+
+# ---------------------------------- Fetches -----------------------------------
+
+def percentile(values: List[float], p: float) -> float:
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100.0))]
+
+
+def run(args, ratio: Optional[float]) -> Dict:
+    srv = serve(args.stuck / 100.0, args.stall, args.seed)
+    base = "http://127.0.0.1:%d/" % srv.server_address[1]
+    session = Session()
+    if ratio is not None:
+        session.enable_hedging(ratio)
+
+    def fetch(i: int) -> float:
+        t0 = time.perf_counter()
+        r = session.get(base + "img/%d.png" % i, stream=True)
+        r.content
+        return time.perf_counter() - t0
+
+    try:
+        t0 = time.perf_counter()
+        with ThreadPoolExecutor(args.threads) as pool:
+            lat = list(pool.map(fetch, range(args.requests)))
+        wall = time.perf_counter() - t0
+    finally:
+        session.close()
+        srv.shutdown()
+        srv.server_close()
+    stats = session.hedge.stats if session.hedge is not None else {"hedged": 0, "won": 0}
+    return {"ratio": "off" if ratio is None else ratio, "seconds": wall,
+            "p50_ms": percentile(lat, 50) * 1e3, "p95_ms": percentile(lat, 95) * 1e3,
+            "p99_ms": percentile(lat, 99) * 1e3, "max_ms": max(lat) * 1e3,
+            "extra_pct": 100.0 * (srv.requests - args.requests) / args.requests,
+            "hedged": stats["hedged"], "won": stats["won"]}
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Tail latency with and without hedged requests.")
+    p.add_argument("--requests", type=int, default=1000, help="Files fetched per point.")
+    p.add_argument("--threads", type=int, default=8, help="Fetching threads.")
+    p.add_argument("--stuck", type=float, default=2.0, help="Percent of the requests which stall.")
+    p.add_argument("--stall", type=float, default=1.0, help="Seconds a stalling request waits.")
+    p.add_argument("--ratios", default="0.02,0.05", help="Comma separated hedging budgets.")
+    p.add_argument("--seed", type=int, default=0, help="Random seed of the stalls.")
+    p.add_argument("--csv", default="res/hedge.csv", help="CSV output file.")
+    args = p.parse_args()
+
+    ratios = [float(x) for x in args.ratios.split(",") if x.strip()]
+    rows = [run(args, ratio) for ratio in [None] + ratios]
+
+    print("-----------------------------------------------------------------")
+    print(f"{'ratio':>6} {'seconds':>8} {'p50 ms':>8} {'p95 ms':>8} {'p99 ms':>8} {'max ms':>8} "
+          f"{'extra %':>8} {'won':>5}")
+    for r in rows:
+        print(f"{r['ratio']:>6} {r['seconds']:>8.3f} {r['p50_ms']:>8.2f} {r['p95_ms']:>8.2f} "
+              f"{r['p99_ms']:>8.2f} {r['max_ms']:>8.1f} {r['extra_pct']:>8.2f} {r['won']:>5}")
+
+    os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+    fields = ["ratio", "seconds", "p50_ms", "p95_ms", "p99_ms", "max_ms", "extra_pct", "hedged", "won"]
+    with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+        w = csv.DictWriter(fh, fieldnames=fields)
+        w.writeheader()
+        w.writerows(rows)
+    print(f"Wrote CSV -> {args.csv}")
+
+if __name__ == "__main__":
+    sys.exit(main())
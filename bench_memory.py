@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Memory profile of a crawl: RSS samples and tracemalloc peaks per stage
+(fetch, buffer, parse, rewrite, write) and per resource type, plus the
+bytes retained by every queued resource object, its compact `ResourceRecord`
+and every `Index` entry.
+
+    python bench_memory.py --pages 500
+    python bench_memory.py --pages 2000 --threaded --json res/memory.json
+    python bench_memory.py --url https://example.com/ --mode page
+"""
+
+import os, sys, json, time, argparse, tempfile, shutil, tracemalloc
+from typing import Dict, List
+
+from pywebcopy import memtrace
+from pywebcopy.configs import get_config
+from pywebcopy.elements import ResourceRecord
+from pywebcopy.schedulers import Index
+
+from bench_site import serve_site
+
+# ------------------------------ Retention -------------------------------------
+
+def _traced_delta(build):
+    """Runs `build()` and returns (object, traced bytes it holds on to)."""
+    import gc
+    gc.collect()
+    before = tracemalloc.get_traced_memory()[0]
+    obj = build()
+    gc.collect()
+    return obj, tracemalloc.get_traced_memory()[0] - before
+
+def bytes_per_index_entry(items) -> float:
+    items = list(items)
+    if not items:
+        return 0.0
+    def build():
+        ans = Index()
+        for k, v in items:
+            ans.add_entry(k, v)
+        return ans
+    _, delta = _traced_delta(build)
+    return delta / len(items)
+
+def bytes_per_queued_resource(crawler, urls: List[str]) -> Dict[str, float]:
+    """Bytes held by a resource object waiting in a scheduler queue, i.e. created
+    and with its output path resolved but not yet fetched."""
+    sch, out = crawler.scheduler, {}
+    groups = {"a": urls, "img": urls, "link": urls}
+    for tag, us in groups.items():
+        if not us:
+            continue
+        def build():
+            ans = []
+            for u in us:
+                r = sch.get_handler(tag, crawler.session, crawler.config, sch,
+                                    crawler.context.create_new_from_url(u))
+                r.filepath  # noqa: resolved like the scheduler does before queueing
+                ans.append(r)
+            return ans
+        objs, delta = _traced_delta(build)
+        name = objs[0].__class__.__name__
+        out["%s:%s" % (tag, name)] = delta / len(us)
+        if getattr(objs[0], "stateless", False):
+            # rewritten by the handler class, nothing is queued at all
+            out["%s:%s (stateless)" % (tag, name)] = 0.0
+        else:
+            records, delta = _traced_delta(lambda: [ResourceRecord.from_resource(r) for r in objs])
+            out["%s:ResourceRecord" % tag] = delta / len(us)
+            del records
+        del objs
+    return out
+
+# ------------------------------ One crawl -------------------------------------
+
+def run(url: str, mode: str, threaded: bool, folder: str, interval: float):
+    cfg = get_config(url, project_folder=folder, project_name="memory",
+                     bypass_robots=True, threaded=threaded)
+    crawler = cfg.create_crawler() if mode == "site" else cfg.create_page()
+
+    tracer = memtrace.enable(interval=interval)
+    t0 = time.perf_counter()
+    try:
+        crawler.get(url)
+        crawler.save_complete(pop=False)
+        close = getattr(crawler.scheduler, "close", None)
+        if close is not None:
+            close()
+        elapsed = time.perf_counter() - t0
+        index = crawler.scheduler.index
+        entries = list(index.items())
+        per_entry = bytes_per_index_entry(entries)
+        per_resource = bytes_per_queued_resource(crawler, [k for k, _ in entries][:2000])
+        summary = tracer.summary()
+    finally:
+        memtrace.disable()
+
+    pages = sum(1 for k, v in entries if v and v.endswith(".html"))
+    summary.update({
+        "url": url, "mode": mode, "threaded": threaded, "seconds": elapsed,
+        "index_entries": len(entries), "pages": pages,
+        "bytes_per_index_entry": per_entry,
+        "bytes_per_queued_resource": per_resource,
+        "rss_growth_per_page": (tracer.rss_peak - tracer.rss_start) / max(1, pages),
+    })
+    return tracer, summary
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Memory profile of a pywebcopy crawl, per stage and resource type.")
+    p.add_argument("--url", help="Crawl this url instead of the local synthetic site.")
+    p.add_argument("--pages", type=int, default=200, help="Pages of the local synthetic site.")
+    p.add_argument("--mode", choices=("site", "page"), default="site", help="save_website or save_webpage.")
+    p.add_argument("--threaded", action="store_true", help="Use the threading scheduler.")
+    p.add_argument("--interval", type=float, default=0.02, help="RSS sampling interval (s).")
+    p.add_argument("--plan-pages", type=int, default=100000,
+                   help="Extrapolate the peak RSS for a crawl of this many pages.")
+    p.add_argument("--json", help="Optional file to write the full summary to.")
+    p.add_argument("--keep", action="store_true", help="Keep the downloaded files.")
+    args = p.parse_args()
+
+    folder = tempfile.mkdtemp(prefix="pwc-mem-")
+    try:
+        if args.url:
+            tracer, summary = run(args.url, args.mode, args.threaded, folder, args.interval)
+        else:
+            with serve_site(pages=args.pages) as url:
+                tracer, summary = run(url, args.mode, args.threaded, folder, args.interval)
+    finally:
+        if not args.keep:
+            shutil.rmtree(folder, ignore_errors=True)
+
+    fb = memtrace.format_bytes
+    print(f"\nTarget: {summary['url']}  mode={summary['mode']} threaded={summary['threaded']}")
+    print(f"Pages: {summary['pages']}  index entries: {summary['index_entries']}  "
+          f"time: {summary['seconds']:.2f}s")
+    print("-----------------------------------------------------------------")
+    print(tracer.report())
+    print("\nRetention:")
+    print(f"  per Index entry:      {summary['bytes_per_index_entry']:.0f} B")
+    for k, v in summary["bytes_per_queued_resource"].items():
+        print(f"  per queued resource:  {v:.0f} B  ({k})")
+    growth = summary["rss_growth_per_page"]
+    print(f"  RSS growth per page:  {fb(growth)}")
+    print(f"  Planned peak RSS for {args.plan_pages} pages: "
+          f"{fb(tracer.rss_start + growth * args.plan_pages)}")
+
+    if args.json:
+        os.makedirs(os.path.dirname(args.json) or ".", exist_ok=True)
+        with open(args.json, "w", encoding="utf-8") as fh:
+            json.dump(summary, fh, indent=2, default=str)
+        print(f"Wrote JSON -> {args.json}")
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Parser backend comparison over a fixed, stored html corpus.
+
+Every available parse path reads the same documents and extracts the same
+kind of links (the attributes of `lxml.html.defs.link_attrs`, srcset and
+inline css `url()` where the path supports it):
+
+    iterparse   pywebcopy.parsers.iterparse, the path used by the crawler
+    lxml        lxml.html.fromstring + iterlinks
+    bs4-lxml    BeautifulSoup(html, "lxml") as in bench_scrape._parse_title_links
+    htmlparser  the stdlib html.parser tokenizer
+    selectolax  lexbor based native tokenizer (only if installed)
+
+Each parser runs in its own process so the RSS high-water mark is its own.
+Reported: throughput (MB/s, best of --repeat), python allocations (tracemalloc
+peak and the blocks held by the parse result), RSS growth, and the diff of the
+extracted url sets against iterparse.
+
+    python bench_parsers.py                             # generates res/corpus
+    python bench_parsers.py --corpus path/to/html/files --repeat 5
+    python bench_parsers.py --fetch https://www.python.org/ --corpus res/corpus
+"""
+
+import os, re, sys, csv, gc, time, argparse, tracemalloc
+from io import BytesIO
+from typing import Callable, Dict, List, Set, Tuple
+from urllib.parse import urljoin
+
+from lxml.html.defs import link_attrs
+
+# ------------------------------ Corpus ----------------------------------------
+
+def generate_corpus(folder: str, pages: int, seed: int = 0):
+    from bench_site import render_page
+    os.makedirs(folder, exist_ok=True)
+    for i in range(pages):
+        with open(os.path.join(folder, "page-%05d.html" % i), "wb") as fh:
+            fh.write(render_page(i, pages, seed, extra_links=20, paragraphs=40))
+
+def fetch_into_corpus(folder: str, urls: List[str]):
+    import requests
+    os.makedirs(folder, exist_ok=True)
+    for u in urls:
+        r = requests.get(u, timeout=30)
+        r.raise_for_status()
+        name = re.sub(r"[^A-Za-z0-9_.-]+", "_", u)[:120] + ".html"
+        with open(os.path.join(folder, name), "wb") as fh:
+            fh.write(r.content)
+
+def load_corpus(folder: str) -> List[Tuple[str, bytes]]:
+    docs = []
+    for name in sorted(os.listdir(folder)):
+        if name.endswith((".html", ".htm")):
+            with open(os.path.join(folder, name), "rb") as fh:
+                docs.append((name, fh.read()))
+    return docs
+
+# ------------------------------ Parse paths -----------------------------------
+
+_css_url = re.compile(r"""url\((["'][^"']*["']|[^)]*)\)""", re.I)
+_srcset = re.compile(r"([^\s,]{4,})")
+LINK_ATTRS = frozenset(link_attrs)
+
+def _strip(u: str) -> str:
+    u = u.strip()
+    if u[:1] in "\"'" and u[-1:] in "\"'":
+        u = u[1:-1]
+    return u
+
+def parse_iterparse(html: bytes) -> Set[str]:
+    from pywebcopy.parsers import iterparse
+    it = iterparse(BytesIO(html), "utf-8")
+    return {url for _, _, url, _ in it if url}
+
+def parse_lxml(html: bytes) -> Set[str]:
+    from lxml.html import fromstring
+    return {link for _, _, link, _ in fromstring(html).iterlinks() if link}
+
+def parse_bs4(html: bytes) -> Set[str]:
+    from bs4 import BeautifulSoup
+    out = set()
+    for tag in BeautifulSoup(html, "lxml").find_all(True):
+        for k, v in tag.attrs.items():
+            if k in LINK_ATTRS and isinstance(v, str) and v:
+                out.add(v)
+            elif k == "srcset" and isinstance(v, str):
+                out.update(m.group(1) for m in _srcset.finditer(v))
+            elif k == "style" and isinstance(v, str):
+                out.update(_strip(m.group(1)) for m in _css_url.finditer(v))
+        if tag.name == "style" and tag.string:
+            out.update(_strip(m.group(1)) for m in _css_url.finditer(tag.string))
+    return out
+
+def parse_htmlparser(html: bytes) -> Set[str]:
+    from html.parser import HTMLParser
+    out: Set[str] = set()
+
+    class P(HTMLParser):
+        def handle_starttag(self, tag, attrs):
+            for k, v in attrs:
+                if not v:
+                    continue
+                if k in LINK_ATTRS:
+                    out.add(v)
+                elif k == "srcset":
+                    out.update(m.group(1) for m in _srcset.finditer(v))
+                elif k == "style":
+                    out.update(_strip(m.group(1)) for m in _css_url.finditer(v))
+
+    p = P(convert_charrefs=True)
+    p.feed(html.decode("utf-8", "replace"))
+    p.close()
+    return out
+
+def parse_selectolax(html: bytes) -> Set[str]:
+    from selectolax.lexbor import LexborHTMLParser
+    out = set()
+    for node in LexborHTMLParser(html).css("*"):
+        for k, v in node.attributes.items():
+            if v and k in LINK_ATTRS:
+                out.add(v)
+    return out
+
+PARSERS: Dict[str, Callable[[bytes], Set[str]]] = {
+    "iterparse": parse_iterparse,
+    "lxml": parse_lxml,
+    "bs4-lxml": parse_bs4,
+    "htmlparser": parse_htmlparser,
+    "selectolax": parse_selectolax,
+}
+
+def available(name: str) -> bool:
+    mod = {"bs4-lxml": "bs4", "selectolax": "selectolax"}.get(name)
+    if mod is None:
+        return True
+    try:
+        __import__(mod)
+        return True
+    except ImportError:
+        return False
+
+# ------------------------------ Measurement -----------------------------------
+
+def _max_rss() -> int:
+    import resource
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return rss if sys.platform == "darwin" else rss * 1024
+
+def measure(name: str, docs: List[Tuple[str, bytes]], repeat: int) -> Dict:
+    fn = PARSERS[name]
+    for _, html in docs[:3]:  # warm imports and caches
+        fn(html)
+    rss0 = _max_rss()
+    total = sum(len(h) for _, h in docs)
+
+    best = float("inf")
+    for _ in range(max(1, repeat)):
+        gc.collect()
+        t0 = time.perf_counter()
+        for _, html in docs:
+            fn(html)
+        best = min(best, time.perf_counter() - t0)
+
+    # python allocations: tracemalloc slows parsing down so it is a separate pass
+    gc.collect()
+    tracemalloc.start()
+    peak, blocks, urls = 0, 0, {}
+    for doc, html in docs:
+        tracemalloc.reset_peak()
+        b0 = sys.getallocatedblocks()
+        found = fn(html)
+        blocks += sys.getallocatedblocks() - b0
+        peak = max(peak, tracemalloc.get_traced_memory()[1])
+        urls[doc] = found
+    tracemalloc.stop()
+
+    return {
+        "parser": name,
+        "docs": len(docs),
+        "mbytes": total / 1e6,
+        "seconds": best,
+        "mb_per_s": (total / 1e6) / best if best else 0.0,
+        "tracemalloc_peak": peak,
+        "blocks_per_doc": blocks / max(1, len(docs)),
+        "rss_growth": max(0, _max_rss() - rss0),
+        "urls": urls,
+    }
+
+def _worker(conn, name, folder, repeat):
+    try:
+        conn.send(measure(name, load_corpus(folder), repeat))
+    except Exception as e:  # report instead of hanging the parent
+        conn.send({"parser": name, "error": repr(e)})
+    conn.close()
+
+def run_isolated(name: str, folder: str, repeat: int) -> Dict:
+    import multiprocessing as mp
+    parent, child = mp.Pipe(duplex=False)
+    proc = mp.Process(target=_worker, args=(child, name, folder, repeat))
+    proc.start()
+    ans = parent.recv()
+    proc.join()
+    return ans
+
+def diff(ref: Dict[str, Set[str]], got: Dict[str, Set[str]]) -> Tuple[int, int, List[str]]:
+    missing = extra = 0
+    samples: List[str] = []
+    for doc, urls in ref.items():
+        other = got.get(doc, set())
+        m, e = urls - other, other - urls
+        missing += len(m); extra += len(e)
+        for u in sorted(m)[:2]:
+            if len(samples) < 6:
+                samples.append("-%s" % u)
+        for u in sorted(e)[:2]:
+            if len(samples) < 6:
+                samples.append("+%s" % u)
+    return missing, extra, samples
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Compare html parse paths on a stored corpus.")
+    p.add_argument("--corpus", default="res/corpus", help="Folder with .html files (generated if missing).")
+    p.add_argument("--pages", type=int, default=200, help="Pages to generate when the corpus is missing.")
+    p.add_argument("--fetch", action="append", help="Download this url into the corpus first.")
+    p.add_argument("--parsers", default=",".join(PARSERS), help="Comma separated parsers to run.")
+    p.add_argument("--repeat", type=int, default=3, help="Timed passes per parser; the best is kept.")
+    p.add_argument("--csv", help="Optional CSV file to write the results to.")
+    args = p.parse_args()
+
+    if args.fetch:
+        fetch_into_corpus(args.corpus, args.fetch)
+    if not os.path.isdir(args.corpus) or not load_corpus(args.corpus):
+        print(f"Generating {args.pages} pages into {args.corpus}")
+        generate_corpus(args.corpus, args.pages)
+    docs = load_corpus(args.corpus)
+    print(f"Corpus: {args.corpus}  docs={len(docs)}  size={sum(len(h) for _, h in docs)/1e6:.2f}MB")
+    print("-----------------------------------------------------------------")
+
+    results = []
+    for name in [n.strip() for n in args.parsers.split(",") if n.strip()]:
+        if name not in PARSERS:
+            print(f"unknown parser {name!r}, choose from {', '.join(PARSERS)}"); continue
+        if not available(name):
+            print(f"{name:<11} not installed, skipped"); continue
+        r = run_isolated(name, args.corpus, args.repeat)
+        if "error" in r:
+            print(f"{name:<11} failed: {r['error']}"); continue
+        results.append(r)
+
+    ref = next((r["urls"] for r in results if r["parser"] == "iterparse"), None)
+    rows = []
+    print(f"{'parser':<11} {'MB/s':>8} {'seconds':>8} {'py peak':>10} {'blocks/doc':>10} "
+          f"{'rss +':>10} {'missing':>8} {'extra':>7}")
+    for r in results:
+        missing, extra, samples = diff(ref, r["urls"]) if ref is not None else (0, 0, [])
+        rows.append({k: v for k, v in r.items() if k != "urls"})
+        rows[-1].update(missing=missing, extra=extra)
+        print(f"{r['parser']:<11} {r['mb_per_s']:>8.2f} {r['seconds']:>8.3f} "
+              f"{r['tracemalloc_peak']/1024:>8.0f}KB {r['blocks_per_doc']:>10.0f} "
+              f"{r['rss_growth']/1024:>8.0f}KB {missing:>8} {extra:>7}")
+        if samples:
+            print("            " + "  ".join(samples))
+
+    if args.csv and rows:
+        os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+        with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+            w = csv.DictWriter(fh, fieldnames=list(rows[0].keys()))
+            w.writeheader(); w.writerows(rows)
+        print(f"Wrote CSV -> {args.csv}")
+
+if __name__ == "__main__":
+    sys.exit(main())
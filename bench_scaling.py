@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Scaling curves of the crawl schedulers: throughput vs. worker count and site size.
+
+Every (scheduler, workers, pages) point crawls the local synthetic site
+(`bench_site.py`, served from separate processes so the server does not share
+the GIL with the crawler) and records pages/s, CPU utilisation of the crawler
+process and p50/p99 page latency (request sent -> headers received, as seen by
+the crawler, which includes time spent waiting for the GIL and a connection).
+
+    python bench_scaling.py
+    python bench_scaling.py --workers 1,4,16,64 --sizes 100,10000,100000 --schedulers pool
+    python bench_scaling.py --pool-size default     # keep requests' 10-connection pool
+
+Results go to a CSV (default res/scaling.csv) and, if matplotlib is available,
+a plot next to it.
+"""
+
+import os, sys, csv, time, shutil, argparse, tempfile, threading, statistics
+from typing import Dict, List, Optional
+
+from requests.adapters import HTTPAdapter
+
+from pywebcopy.configs import get_config
+from pywebcopy.core import Crawler
+from pywebcopy import schedulers
+
+from bench_site import serve_site
+
+# ------------------------------ Schedulers ------------------------------------
+
+def make_scheduler(name: str, workers: int):
+    if name == "sync":
+        return schedulers.crawler_scheduler()
+    if name == "threading":
+        return schedulers.threading_crawler_scheduler()
+    if name == "pool":
+        return schedulers.thread_pool_crawler_scheduler(maxsize=workers)
+    raise ValueError("unknown scheduler %r" % name)
+
+def uses_workers(name: str) -> bool:
+    return name == "pool"
+
+def drain(scheduler):
+    join = getattr(scheduler, "join", None)
+    if join is not None:
+        join()
+    close = getattr(scheduler, "close", None)
+    if close is not None:
+        close()
+
+# ------------------------------ Measurement -----------------------------------
+
+class Latencies(object):
+    """requests response hook collecting time-to-headers of html pages."""
+
+    def __init__(self):
+        self.values: List[float] = []
+        self.lock = threading.Lock()
+
+    def __call__(self, response, *args, **kwargs):
+        if response.headers.get("Content-Type", "").startswith("text/html"):
+            with self.lock:
+                self.values.append(response.elapsed.total_seconds())
+        return response
+
+def pct(xs: List[float], q: float) -> float:
+    if not xs:
+        return float("nan")
+    xs = sorted(xs)
+    return xs[min(len(xs) - 1, int(round(q * (len(xs) - 1))))]
+
+def run_point(url: str, sched: str, workers: int, pool_size: Optional[int], folder: str) -> Dict:
+    cfg = get_config(url, project_folder=folder, project_name="scaling", bypass_robots=True)
+    session = cfg.create_session()
+    if pool_size:
+        adapter = HTTPAdapter(pool_connections=4, pool_maxsize=pool_size)
+        session.mount("http://", adapter)
+        session.mount("https://", adapter)
+    lat = Latencies()
+    session.hooks["response"].append(lat)
+    scheduler = make_scheduler(sched, workers)
+    crawler = Crawler(session, cfg, scheduler, cfg.create_context())
+
+    c0, t0 = os.times(), time.perf_counter()
+    crawler.get(url)
+    crawler.save_complete(pop=False)
+    drain(scheduler)
+    c1, t1 = os.times(), time.perf_counter()
+
+    wall = t1 - t0
+    cpu = (c1.user - c0.user) + (c1.system - c0.system)
+    pages = len(lat.values)
+    return {
+        "scheduler": sched,
+        "workers": workers if uses_workers(sched) else "",
+        "pages": pages,
+        "resources": len(scheduler.index),
+        "seconds": round(wall, 4),
+        "pages_per_s": round(pages / wall, 2) if wall else 0.0,
+        "cpu_util": round(cpu / wall, 3) if wall else 0.0,  # 1.0 == one core busy
+        "p50_ms": round(pct(lat.values, 0.50) * 1e3, 2),
+        "p99_ms": round(pct(lat.values, 0.99) * 1e3, 2),
+    }
+
+# --------------------------------- Plot ---------------------------------------
+
+def plot(rows: List[Dict], path: str) -> bool:
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        return False
+    fig, (ax1, ax2) = plt.subplots(1, 2, figsize=(12, 4.5))
+    series: Dict[tuple, List[Dict]] = {}
+    for r in rows:
+        series.setdefault((r["scheduler"], r["site_pages"]), []).append(r)
+    for (sched, size), rs in sorted(series.items()):
+        if uses_workers(sched):
+            xs = [r["workers"] for r in rs]
+            ax1.plot(xs, [r["pages_per_s"] for r in rs], marker="o", label=f"{sched} n={size}")
+            ax2.plot(xs, [r["p99_ms"] for r in rs], marker="o", label=f"{sched} n={size}")
+        else:
+            ax1.axhline(rs[0]["pages_per_s"], linestyle="--", linewidth=1, label=f"{sched} n={size}")
+    for ax, title in ((ax1, "pages / s"), (ax2, "p99 page latency (ms)")):
+        ax.set_xscale("log", base=2)
+        ax.set_xlabel("workers")
+        ax.set_title(title)
+        ax.grid(True, alpha=0.3)
+    ax1.legend(fontsize=7)
+    fig.tight_layout()
+    fig.savefig(path, dpi=120)
+    return True
+
+# ---------------------------------- CLI ---------------------------------------
+
+def _ints(s: str) -> List[int]:
+    return [int(x) for x in s.split(",") if x.strip()]
+
+def main():
+    p = argparse.ArgumentParser(description="Throughput vs worker count and site size for pywebcopy schedulers.")
+    p.add_argument("--workers", default="1,2,4,8,16,32,64", help="Comma separated worker counts.")
+    p.add_argument("--sizes", default="10,100,1000", help="Comma separated site sizes (pages).")
+    p.add_argument("--schedulers", default="sync,threading,pool",
+                   help="Comma separated: sync, threading, pool.")
+    p.add_argument("--pool-size", default="auto",
+                   help="Connection pool size: 'auto' (= workers), 'default' (requests' 10) or a number.")
+    p.add_argument("--server-procs", type=int, default=min(4, os.cpu_count() or 1),
+                   help="Processes serving the synthetic site.")
+    p.add_argument("--repeat", type=int, default=1, help="Runs per point; the fastest is kept.")
+    p.add_argument("--csv", default="res/scaling.csv", help="CSV output file.")
+    p.add_argument("--plot", default=None, help="Plot file (default: CSV name with .png).")
+    args = p.parse_args()
+
+    rows = []
+    for size in _ints(args.sizes):
+        with serve_site(pages=size, processes=args.server_procs) as url:
+            for sched in [s.strip() for s in args.schedulers.split(",") if s.strip()]:
+                for workers in (_ints(args.workers) if uses_workers(sched) else [1]):
+                    if args.pool_size == "auto":
+                        pool_size = max(10, workers)
+                    elif args.pool_size == "default":
+                        pool_size = None
+                    else:
+                        pool_size = int(args.pool_size)
+                    best = None
+                    for _ in range(max(1, args.repeat)):
+                        folder = tempfile.mkdtemp(prefix="pwc-scale-")
+                        try:
+                            r = run_point(url, sched, workers, pool_size, folder)
+                        finally:
+                            shutil.rmtree(folder, ignore_errors=True)
+                        if best is None or r["pages_per_s"] > best["pages_per_s"]:
+                            best = r
+                    best["site_pages"] = size
+                    rows.append(best)
+                    print(f"n={size:<7} {sched:<9} workers={str(best['workers']):<3} "
+                          f"pages={best['pages']:<6} {best['pages_per_s']:>8.1f} pages/s  "
+                          f"cpu={best['cpu_util']:.2f}  p50={best['p50_ms']:.1f}ms  p99={best['p99_ms']:.1f}ms")
+
+    if rows:
+        os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+        fields = ["site_pages"] + [k for k in rows[0] if k != "site_pages"]
+        with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+            w = csv.DictWriter(fh, fieldnames=fields)
+            w.writeheader(); w.writerows(rows)
+        print(f"Wrote CSV -> {args.csv}")
+        png = args.plot or os.path.splitext(args.csv)[0] + ".png"
+        if plot(rows, png):
+            print(f"Wrote plot -> {png}")
+        else:
+            print("matplotlib not installed; skipped the plot.")
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Throughput of many page captures, `save_page` per url versus one
+`pywebcopy.service.CaptureService`.
+
+Every point captures the same `pages` urls of the synthetic site
+(`bench_site.py`) with `workers` captures running at once. `save_page`
+builds a config, session, scheduler and connection pool per url, so every
+capture opens new connections, resolves the host and fetches robots.txt
+again; the service shares them. New connections and dns lookups are
+counted along with the time.
+
+    python bench_service.py
+    python bench_service.py --pages 500 --workers 1,4,16
+
+Results go to a CSV (default res/service.csv).
+"""
+
+import os, sys, csv, time, shutil, socket, argparse, tempfile, threading
+from concurrent.futures import ThreadPoolExecutor
+from typing import Dict, List
+
+from urllib3.connectionpool import HTTPConnectionPool
+
+from pywebcopy.configs import get_config
+from pywebcopy.service import CaptureService
+
+from bench_site import page_path, serve_site
+
+# ------------------------------ Counters --------------------------------------
+
+class Counters(object):
+    """Counts new connections and dns lookups."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.connections = self.lookups = 0
+
+    def __enter__(self):
+        self._new_conn, self._getaddrinfo = HTTPConnectionPool._new_conn, socket.getaddrinfo
+        counters, new_conn, getaddrinfo = self, self._new_conn, self._getaddrinfo
+
+        def counted_conn(pool):
+            with counters.lock:
+                counters.connections += 1
+            return new_conn(pool)
+
+        def counted_lookup(*args, **kwargs):
+            with counters.lock:
+                counters.lookups += 1
+            return getaddrinfo(*args, **kwargs)
+
+        HTTPConnectionPool._new_conn = counted_conn
+        socket.getaddrinfo = counted_lookup
+        return self
+
+    def __exit__(self, *exc):
+        HTTPConnectionPool._new_conn, socket.getaddrinfo = self._new_conn, self._getaddrinfo
+
+# ------------------------------ Captures --------------------------------------
+
+def save_pages(urls: List[str], workers: int, folder: str) -> None:
+    def capture(i: int):
+        # what save_page does, without the browser
+        config = get_config(urls[i], folder, "page_%d" % i)
+        page = config.create_page()
+        page.get(urls[i])
+        page.save_complete()
+        page.session.close()
+
+    with ThreadPoolExecutor(workers) as pool:
+        list(pool.map(capture, range(len(urls))))
+
+
+def service_pages(urls: List[str], workers: int, folder: str) -> None:
+    with CaptureService(folder, workers=workers) as service:
+        for future in [service.submit_page(u) for u in urls]:
+            future.result()
+
+
+def run(mode: str, urls: List[str], workers: int) -> Dict:
+    folder = tempfile.mkdtemp(prefix="pwc-svc-")
+    try:
+        with Counters() as c:
+            t0 = time.perf_counter()
+            (save_pages if mode == "save_page" else service_pages)(urls, workers, folder)
+            wall = time.perf_counter() - t0
+    finally:
+        shutil.rmtree(folder, ignore_errors=True)
+    return {"mode": mode, "workers": workers, "seconds": wall,
+            "pages_per_s": len(urls) / wall if wall else 0.0,
+            "connections": c.connections, "dns_lookups": c.lookups}
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="save_page per url versus a CaptureService.")
+    p.add_argument("--pages", type=int, default=100, help="Pages captured per point.")
+    p.add_argument("--workers", default="1,4,8", help="Comma separated concurrent captures.")
+    p.add_argument("--csv", default="res/service.csv", help="CSV output file.")
+    args = p.parse_args()
+
+    counts = [int(x) for x in args.workers.split(",") if x.strip()]
+    rows = []
+    with serve_site(pages=args.pages, processes=min(4, os.cpu_count() or 1)) as url:
+        # a host name, so that the captures resolve it
+        url = url.replace("127.0.0.1", "localhost")
+        urls = [url.rstrip("/") + page_path(i) for i in range(args.pages)]
+        for workers in counts:
+            for mode in ("save_page", "service"):
+                rows.append(run(mode, urls, workers))
+
+    print("-----------------------------------------------------------------")
+    print(f"{'mode':<10} {'workers':>7} {'seconds':>9} {'pages/s':>9} {'conns':>7} {'dns':>6}")
+    for r in rows:
+        print(f"{r['mode']:<10} {r['workers']:>7} {r['seconds']:>9.3f} {r['pages_per_s']:>9.1f} "
+              f"{r['connections']:>7} {r['dns_lookups']:>6}")
+
+    os.makedirs(os.path.dirname(args.csv) or ".", exist_ok=True)
+    fields = ["mode", "workers", "seconds", "pages_per_s", "connections", "dns_lookups"]
+    with open(args.csv, "w", newline="", encoding="utf-8") as fh:
+        w = csv.DictWriter(fh, fieldnames=fields)
+        w.writeheader()
+        w.writerows(rows)
+    print(f"Wrote CSV -> {args.csv}")
+
+if __name__ == "__main__":
+    sys.exit(main())
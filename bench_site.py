@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Deterministic synthetic website served from memory on localhost.
+
+Used by the benchmark scripts so that crawls are reproducible and do not
+depend on the network. Page ``i`` links to pages ``2i+1`` and ``2i+2`` (so
+every page is reachable from ``/`` in O(log n) hops) plus a few seeded random
+pages, one shared stylesheet, one script and a couple of images. The
+stylesheet references more images through ``url()`` so the CSS path is
+exercised too.
+
+    with serve_site(pages=500) as base_url:
+        save_website(base_url, ...)
+
+    python bench_site.py --pages 1000 --port 8000      # serve until ^C
+"""
+
+import argparse, random, sys, threading, time
+from contextlib import contextmanager
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Dict, Optional, Tuple
+
+# ------------------------------ Corpus ----------------------------------------
+
+PNG_1PX = (b"\x89PNG\r\n\x1a\n\x00\x00\x00\rIHDR\x00\x00\x00\x01\x00\x00\x00\x01\x08\x06"
+           b"\x00\x00\x00\x1f\x15\xc4\x89\x00\x00\x00\rIDATx\x9cc\xf8\x0f\x00\x00\x01\x01\x00"
+           b"\x05\x18\xd8N\x00\x00\x00\x00IEND\xaeB`\x82")
+
+WORDS = ("lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod "
+         "tempor incididunt ut labore et dolore magna aliqua enim ad minim veniam "
+         "quis nostrud exercitation ullamco laboris nisi aliquip ex ea commodo").split()
+
+
+def page_path(i: int) -> str:
+    return "/" if i == 0 else "/page/%d.html" % i
+
+
+def _text(rng: random.Random, n: int) -> str:
+    return " ".join(rng.choice(WORDS) for _ in range(n))
+
+
+def render_page(i: int, pages: int, seed: int = 0, extra_links: int = 3, paragraphs: int = 8) -> bytes:
+    rng = random.Random(seed * 1000003 + i)
+    links = [c for c in (2 * i + 1, 2 * i + 2) if c < pages]
+    links += [rng.randrange(pages) for _ in range(extra_links)] if pages > 1 else []
+    body = []
+    for p in range(paragraphs):
+        body.append("<p>%s</p>" % _text(rng, 40))
+    for j in links:
+        body.append('<a href="%s">%s</a>' % (page_path(j), _text(rng, 3)))
+    body.append('<img src="/img/%d.png" alt="x">' % (i % 50))
+    body.append('<img src="/img/shared.png" alt="y">')
+    return ("<!DOCTYPE html><html><head><meta charset=\"utf-8\">"
+            "<title>Page %d</title>"
+            "<link rel=\"stylesheet\" href=\"/static/site.css\">"
+            "<script src=\"/static/site.js\"></script>"
+            "</head><body><h1>Page %d</h1>%s</body></html>"
+            % (i, i, "\n".join(body))).encode("utf-8")
+
+
+SITE_CSS = ("body{background:url('/img/bg.png')}\n"
+            + "".join(".c%d{background-image:url(/img/c%d.png)}\n" % (k, k) for k in range(10))).encode()
+SITE_JS = b"var x = 1; function f(){ return x; }\n"
+
+
+class Site(object):
+    """Routes a path to ``(status, content_type, body)``."""
+
+    def __init__(self, pages: int = 100, seed: int = 0):
+        self.pages = max(1, int(pages))
+        self.seed = seed
+        self._cache: Dict[int, bytes] = {}
+
+    def page(self, i: int) -> bytes:
+        body = self._cache.get(i)
+        if body is None:
+            body = self._cache[i] = render_page(i, self.pages, self.seed)
+        return body
+
+    def route(self, path: str) -> Tuple[int, str, bytes]:
+        path = path.split("?", 1)[0]
+        if path in ("/", "/index.html"):
+            return 200, "text/html; charset=utf-8", self.page(0)
+        if path.startswith("/page/") and path.endswith(".html"):
+            try:
+                i = int(path[6:-5])
+            except ValueError:
+                i = -1
+            if 0 <= i < self.pages:
+                return 200, "text/html; charset=utf-8", self.page(i)
+        elif path == "/static/site.css":
+            return 200, "text/css", SITE_CSS
+        elif path == "/static/site.js":
+            return 200, "application/javascript", SITE_JS
+        elif path.startswith("/img/"):
+            return 200, "image/png", PNG_1PX
+        elif path == "/robots.txt":
+            return 200, "text/plain", b"User-agent: *\nAllow: /\n"
+        return 404, "text/plain", b"not found"
+
+
+# ------------------------------ Server ----------------------------------------
+
+class SiteHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    disable_nagle_algorithm = True  # headers and body go out as separate writes
+
+    def do_GET(self):
+        status, ctype, body = self.server.site.route(self.path)
+        self.send_response(status)
+        self.send_header("Content-Type", ctype)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *args):  # keep benchmark output clean
+        pass
+
+
+class SiteServer(ThreadingHTTPServer):
+    daemon_threads = True
+    request_queue_size = 256
+
+    def __init__(self, site: Site, host: str = "127.0.0.1", port: int = 0, handler=SiteHandler,
+                 reuse_port: bool = False):
+        self.site = site
+        self.reuse_port = reuse_port
+        super().__init__((host, port), handler)
+
+    def server_bind(self):
+        if self.reuse_port:
+            import socket
+            self.socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+        super().server_bind()
+
+    def handle_error(self, request, client_address):
+        # clients dropping keep-alive connections are not errors here
+        if not isinstance(sys.exc_info()[1], ConnectionError):
+            super().handle_error(request, client_address)
+
+    @property
+    def base_url(self) -> str:
+        host, port = self.server_address[:2]
+        return "http://%s:%d/" % (host, port)
+
+
+def _serve_in_child(conn, site, port, server_cls, reuse_port):
+    srv = server_cls(site, port=port, reuse_port=reuse_port)
+    conn.send(srv.base_url)
+    conn.close()
+    srv.serve_forever(poll_interval=0.05)
+
+
+@contextmanager
+def serve_site(pages: int = 100, seed: int = 0, port: int = 0, site: Optional[Site] = None,
+               server_cls=SiteServer, processes: int = 0):
+    """Runs the site and yields its base url.
+
+    The server runs on a background thread unless `processes` is given, in
+    which case that many server processes share the port (SO_REUSEPORT) so
+    they do not compete for the GIL with the crawler being measured; use that
+    for throughput numbers.
+    """
+    site = site or Site(pages, seed)
+    if processes:
+        import multiprocessing as mp
+        procs, url = [], None
+        try:
+            for _ in range(processes):
+                parent, child = mp.Pipe(duplex=False)
+                proc = mp.Process(target=_serve_in_child, daemon=True,
+                                  args=(child, site, port, server_cls, processes > 1))
+                proc.start()
+                procs.append(proc)
+                url = parent.recv()
+                port = int(url.rstrip("/").rsplit(":", 1)[1])
+            yield url
+        finally:
+            for proc in procs:
+                proc.terminate()
+                proc.join()
+        return
+    srv = server_cls(site, port=port)
+    th = threading.Thread(target=srv.serve_forever, kwargs={"poll_interval": 0.05}, daemon=True)
+    th.start()
+    try:
+        yield srv.base_url
+    finally:
+        srv.shutdown()
+        srv.server_close()
+
+
+# ---------------------------------- CLI ---------------------------------------
+
+def main():
+    p = argparse.ArgumentParser(description="Serve a deterministic synthetic website for benchmarks.")
+    p.add_argument("--pages", type=int, default=100, help="Number of html pages.")
+    p.add_argument("--seed", type=int, default=0, help="Random seed for link structure and text.")
+    p.add_argument("--port", type=int, default=8000, help="Port to listen on (0 = any).")
+    args = p.parse_args()
+    with serve_site(args.pages, args.seed, args.port) as url:
+        print(f"Serving {args.pages} pages at {url} (Ctrl+C to stop)")
+        try:
+            while True:
+                time.sleep(3600)
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == "__main__":
+    main()
@@ -15,7 +15,8 @@ def save_page(url,
               debug=False,
               open_in_browser=True,
               delay=None,
-              threaded=None,):
+              threaded=None,
+              deadline=None):
     """Easiest way to save any single webpage with images, css and js.
 
     example::
@@ -44,15 +45,23 @@ def save_page(url,
     :type open_in_browser: bool
     :param delay: amount of delay between two concurrent requests to a same server.
     :param threaded: whether to use threading or not (it can break some site).
+    :param deadline: seconds the capture may take, the files not fetched by
+        then are left online; only then is something returned, the
+        :class:`pywebcopy.deadline.DeadlineReport` of the capture.
+    :rtype: pywebcopy.deadline.DeadlineReport | None
     """
     from .configs import get_config
     config = get_config(url, project_folder, project_name, bypass_robots, debug, delay, threaded)
     page = config.create_page()
-    page.get(url)
     if threaded:
         warnings.warn(
             "Opening in browser is not supported when threading is enabled!")
         open_in_browser = False
+    if deadline is not None:
+        # the only request of the page is the one bounded by the deadline
+        page.save_complete(pop=open_in_browser, deadline=deadline)
+        return page.deadline_report
+    page.get(url)
     page.save_complete(pop=open_in_browser)
 
 
@@ -15,7 +15,9 @@ from pywebcopy import save_website
 parser = optparse.OptionParser(
     usage='%prog [-p|--page|-s|--site|-t|--tests] '
           '[--url=URL [,--location=LOCATION [,--name=NAME '
-          '[,--pop [,--bypass_robots [,--quite [,--delay=DELAY]]]]]]] ',
+          '[,--pop [,--bypass_robots [,--quite [,--delay=DELAY]]]]]]] '
+          '[--profile=FILE [,--profile-interval=SECONDS [,--profile-mode=MODE]]]\n'
+          '       %prog --daemon --socket=PATH [--location=LOCATION [,--workers=N]]',
     version=__version__,
     prog=__title__,
     description=__description__
@@ -27,6 +29,8 @@ options.add_option('-p', '--page', action='store_true', help='Quickly saves a si
 options.add_option('-s', '--site', action='store_true', help='Saves the complete site.')
 options.add_option('-t', '--tests', action='store_true', help='Runs tests for this library.')
 
+options.add_option('--daemon', action='store_true', help='Serves capture jobs over a unix socket.')
+
 parser.add_option_group(options)
 
 #: Required params
@@ -44,6 +48,25 @@ parser.add_option('-q', '--quite', default=False, action='store_true', help='Sup
 parser.add_option('--pop', default=False, action='store_true',
                   help='open the html page in default browser window after finishing the task.')
 
+#: Profiling
+profiling = optparse.OptionGroup(parser, 'Profiling', 'Low overhead sampling of all the threads.')
+profiling.add_option('--profile', type='string', metavar='FILE',
+                     help='Write collapsed stacks (flamegraph input) to FILE and a summary at exit.')
+profiling.add_option('--profile-interval', type='float', default=0.005, metavar='SECONDS',
+                     help='Seconds between two samples [default: %default].')
+profiling.add_option('--profile-mode', type='choice', choices=['thread', 'signal', 'py-spy'],
+                     default='thread', help='Sampler: thread, signal or py-spy [default: %default].')
+profiling.add_option('--profile-top', type='int', default=20, metavar='N',
+                     help='Frames listed in the summary [default: %default].')
+parser.add_option_group(profiling)
+
+#: Daemon
+daemon = optparse.OptionGroup(parser, 'Daemon', 'Capture jobs of many clients sharing the workers fairly.')
+daemon.add_option('--socket', type='string', metavar='PATH', help='Unix socket the daemon listens on.')
+daemon.add_option('--workers', type='int', default=8, metavar='N',
+                  help='Files fetched at once by all the jobs [default: %default].')
+parser.add_option_group(daemon)
+
 args, remainder = parser.parse_args()
 
 # type checks
@@ -55,6 +78,14 @@ if bool(args.page) or bool(args.site):
     if args.name and not isinstance(args.name, six.string_types):
         parser.error("--name option requires 1 string type argument")
 
+if args.daemon and not args.socket:
+    parser.error("--daemon option requires --socket")
+
+if args.profile:
+    from pywebcopy.profiler import profile_to_file
+    profile_to_file(args.profile, interval=args.profile_interval,
+                    mode=args.profile_mode, top=args.profile_top)
+
 if args.page:
     save_webpage(
         url=args.url,
@@ -75,6 +106,18 @@ elif args.site:
         delay=args.delay,
         threaded=args.threaded,
     )
+elif args.daemon:
+    import logging
+    from pywebcopy.daemon import Daemon
+    logging.basicConfig(level=logging.WARNING if args.quite else logging.INFO)
+    server = Daemon(args.socket, args.location, workers=args.workers,
+                    bypass_robots=args.bypass_robots, delay=args.delay)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.server_close()
 elif args.tests:
     os.system('%s -m unittest discover -s pywebcopy/tests' % sys.executable)
 else:
@@ -0,0 +1,119 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Canonical url driven deduplication of crawled pages.
+
+Sites serve one page under many parameterized urls (tracking parameters,
+sort orders, session ids) which all declare the same canonical url with
+`<link rel=canonical>`, `<meta property=og:url>` or a `Content-Location`
+header. The index only knows the request url and the redirects, so every
+variant used to be fetched, rewritten, stored and expanded again.
+
+The canonical url is read from the first chunks of the body, before the
+page is parsed. The first page declaring it is stored as usual and also
+indexed under the canonical url, so links to the canonical url reuse it.
+Every later page declaring the same canonical url is a duplicate:
+
+    skip_children - the page is saved but its links are left absolute, so
+                    nothing linked from it is crawled again.
+    skip          - only the head is downloaded and a small redirect to the
+                    local copy of the first page is written in its place.
+
+With a `dedup` or `offload` plug-in on the scheduler as well, the whole
+body is read before the head is looked at, for the fingerprint or the
+worker. `skip` then saves the parsing and the children of the page but
+none of the download.
+
+Canonical urls pointing to another host are ignored by default, any page
+could otherwise claim to be the copy of another site.
+
+Usage::
+
+    scheduler.canonicals = Canonicals(policy='skip')
+"""
+import logging
+import threading
+
+from six.moves.urllib.parse import urldefrag
+from six.moves.urllib.parse import urljoin
+from six.moves.urllib.parse import urlsplit
+
+from .parsers import head_urls
+
+__all__ = ['Canonicals', 'POLICIES']
+
+logger = logging.getLogger(__name__)
+
+#: what happens to pages declaring the canonical url of an earlier page,
+#: see the module docs.
+POLICIES = ('skip_children', 'skip')
+
+
+class Canonicals(object):
+    """Scheduler plug-in which aliases html pages to the first page of the
+    crawl declaring the same canonical url (see
+    :attr:`SchedulerBase.canonicals`).
+
+    :param policy: one of :data:`POLICIES`.
+    :param same_host: ignore canonical urls on another host.
+    """
+
+    def __init__(self, policy='skip_children', same_host=True):
+        if policy not in POLICIES:
+            raise ValueError("Policy must be one of %r, got %r" % (POLICIES, policy))
+        self.policy = policy
+        self.same_host = same_host
+        self.lock = threading.Lock()
+        self.pages = {}  # canonical url -> (url, filepath) of the first page
+        self.duplicates = []  # (url, canonical url)
+
+    def __len__(self):
+        return len(self.pages)
+
+    def canonical_url(self, resource, head, encoding=None):
+        """Returns the absolute canonical url declared by `resource` or None.
+
+        `<link rel=canonical>` wins over the `Content-Location` header which
+        wins over `og:url`; the urls are resolved against the response url.
+        """
+        response = resource.response
+        base = getattr(response, 'url', None) or resource.url
+        canonical, og_url = head_urls(head, encoding) if head else (None, None)
+        location = response.headers.get('Content-Location') if response is not None else None
+        for url in (canonical, location, og_url):
+            if not url:
+                continue
+            url = urldefrag(urljoin(base, url))[0]
+            parts = urlsplit(url)
+            if parts.scheme not in ('http', 'https'):
+                continue
+            if self.same_host and parts.netloc.lower() != urlsplit(base).netloc.lower():
+                logger.debug("Ignoring canonical url [%s] of [%s] on another host.", url, base)
+                continue
+            return url
+        return None
+
+    def check(self, resource, head, encoding=None):
+        """Returns `(url, filepath)` of the first page declaring the same
+        canonical url as `resource`, or None after registering the resource
+        as that page."""
+        canonical = self.canonical_url(resource, head, encoding)
+        if canonical is None:
+            return None
+        url = resource.url
+        with self.lock:
+            original = self.pages.get(canonical)
+            if original is None:
+                self.pages[canonical] = (url, resource.filepath)
+            elif original[0] == url:
+                return None
+            else:
+                self.duplicates.append((url, canonical))
+        if original is None:
+            # links to the canonical url itself resolve to this copy
+            index = resource.scheduler.index
+            if canonical != url:
+                index.claim(canonical, resource.filepath)
+            return None
+        logger.info("Page [%s] duplicates canonical url [%s]", url, canonical)
+        return original
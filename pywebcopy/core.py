@@ -29,16 +29,19 @@ class WebPage(WebElement):
 
     __slots__ = ()  # no extra per-instance dict; attrs live in WebElement
 
+    #: :class:`pywebcopy.deadline.DeadlineReport` of the last capture
+    #: with a deadline, see :meth:`save_complete`.
+    deadline_report = None
+
     @classmethod
     def from_config(cls, config) -> "WebPage":
         """Create a WebPage from a configured config object."""
         if config and not config.is_set():
             raise AttributeError("Configuration is not setup.")
 
-        # Localize lookups once
-        threaded = config.get('threaded')
-        if threaded:
-            scheduler = threading_default_scheduler(timeout=config.get_thread_join_timeout())
+        snapshot = config.freeze()
+        if snapshot.threaded:
+            scheduler = threading_default_scheduler(timeout=snapshot.thread_join_timeout)
         else:
             scheduler = default_scheduler()
 
@@ -55,14 +58,26 @@ class WebPage(WebElement):
         """
         return self.scheduler.data
 
-    def save_complete(self, pop: bool = False) -> str:
-        """Save complete html+assets to disk and optionally open in a browser."""
-        # Bind to locals to reduce attribute lookups in tight call paths.
-        scheduler = self.scheduler
-        scheduler.handle_resource(self)
+    def save_complete(self, pop: bool = False, deadline: Optional[float] = None) -> Any:
+        """Save complete html+assets to disk and optionally open in a browser.
+
+        With a `deadline` in seconds the files are fetched by priority and
+        the ones left when time is up stay online; the path is returned
+        all the same and the :class:`pywebcopy.deadline.DeadlineReport` of
+        what was left out is kept as :attr:`deadline_report`.
+        """
+        if deadline is not None:
+            from .deadline import capture_before
+            self.deadline_report = capture_before(self, deadline)
+            ans = self.deadline_report.filepath
+        else:
+            # Bind to locals to reduce attribute lookups in tight call paths.
+            scheduler = self.scheduler
+            scheduler.handle_resource(self)
+            ans = self.filepath
         if pop:
             self.open_in_browser()
-        return self.filepath
+        return ans
 
     def open_in_browser(self) -> bool:
         """Open the page in the default browser if it has been saved."""
@@ -94,9 +109,9 @@ class Crawler(WebPage):
         if config and not config.is_set():
             raise AttributeError("Configuration is not setup.")
 
-        threaded = config.get('threaded')
-        if threaded:
-            scheduler = threading_crawler_scheduler(timeout=config.get_thread_join_timeout())
+        snapshot = config.freeze()
+        if snapshot.threaded:
+            scheduler = threading_crawler_scheduler(timeout=snapshot.thread_join_timeout)
         else:
             scheduler = crawler_scheduler()
 
@@ -0,0 +1,506 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Capture daemon sharing one box fairly between many jobs.
+
+`python -m pywebcopy --daemon --socket /run/pywebcopy.sock` serves capture
+jobs over a unix socket. Every line sent is a json request and every line
+received its json answer::
+
+    {"op": "submit", "url": "https://example.com/", "kind": "site",
+     "tenant": "docs", "weight": 2, "max_pages": 500}
+    {"ok": true, "job": 1}
+    {"op": "stats", "job": 1}
+    {"ok": true, "job": {"id": 1, "state": "running", "pages": 12, ...}}
+    {"op": "cancel", "job": 1}
+    {"op": "list"}
+    {"op": "shutdown"}
+
+All jobs share one session, its connection pools and robots.txt rules,
+and one :class:`FairPool` of worker threads. Each file of each job is a
+task and the pool picks the next task by deficit round robin over the
+jobs with work queued:
+
+* every visit of the round adds `quantum * weight` bytes to the deficit
+  of a job, a job is served while its deficit is positive and every task
+  is charged the bytes it wrote once done, so the jobs share the
+  bandwidth in proportion to their weights however large their files;
+* a job never has more tasks running than its weighted share of the
+  workers, which also bounds its connections, so one huge site cannot
+  take every worker while smaller jobs wait.
+
+A job ends when it runs out of work, its budget (`max_pages`, `max_bytes`,
+`max_seconds`) is spent or it is cancelled; the files being fetched at
+that moment are finished, the queued ones are dropped.
+
+Usage::
+
+    daemon = Daemon('/run/pywebcopy.sock', '/captures', workers=16)
+    daemon.serve_forever()
+
+    client = DaemonClient('/run/pywebcopy.sock')
+    job = client.submit('https://example.com/', kind='site', weight=2)
+    client.stats(job)
+"""
+import collections
+import errno
+import itertools
+import json
+import logging
+import math
+import os
+import socket
+import stat
+import threading
+import time
+
+from six.moves import socketserver
+
+from .configs import get_config
+from .core import Crawler
+from .core import WebPage
+from .schedulers import Scheduler
+from .schedulers import crawler_scheduler
+from .schedulers import default_scheduler
+from .service import DNSCache
+from .service import KINDS
+from .service import shared_session
+from .urls import Context
+from .urls import get_host
+from .urls import secure_filename
+
+__all__ = ['Daemon', 'DaemonClient', 'FairPool', 'FairScheduler', 'Job', 'STATES']
+
+logger = logging.getLogger(__name__)
+
+#: queued    - waiting for its first task to run.
+#: running   - tasks queued or running.
+#: done      - ran out of work.
+#: exhausted - its budget is spent.
+#: cancelled - cancelled by a client.
+STATES = ('queued', 'running', 'done', 'exhausted', 'cancelled')
+
+
+class Job(object):
+    """A capture job and the queue of its files.
+
+    :param budget: `(max_pages, max_bytes, max_seconds)`, None for no limit.
+    """
+
+    def __init__(self, id, url, kind='page', tenant=None, weight=1.0, budget=(None, None, None),
+                 folder=None):
+        if kind not in KINDS:
+            raise ValueError("Kind must be one of %r, got %r" % (KINDS, kind))
+        if not weight or weight <= 0:
+            raise ValueError("Weight must be positive, got %r" % weight)
+        self.id = id
+        self.url = url
+        self.kind = kind
+        self.tenant = tenant
+        self.weight = float(weight)
+        self.max_pages, self.max_bytes, self.max_seconds = budget
+        self.folder = folder
+        self.filepath = None
+        self.state = 'queued'
+        self.queue = collections.deque()
+        self.deficit = 0.0
+        self.running = 0
+        self.stats = {'pages': 0, 'files': 0, 'bytes': 0, 'errors': 0, 'dropped': 0}
+        self.created = time.time()
+        self.started = self.finished = None
+        self.done = threading.Event()
+
+    def __repr__(self):
+        return '<Job(id=%d, url=%s, state=%s)>' % (self.id, self.url, self.state)
+
+    @property
+    def active(self):
+        return self.state in ('queued', 'running')
+
+    def exhausted(self):
+        stats = self.stats
+        return ((self.max_pages is not None and stats['pages'] >= self.max_pages) or
+                (self.max_bytes is not None and stats['bytes'] >= self.max_bytes) or
+                (self.max_seconds is not None and self.started is not None and
+                 time.time() - self.started >= self.max_seconds))
+
+    def as_dict(self):
+        end = self.finished or time.time()
+        ans = dict(self.stats)
+        ans.update(id=self.id, url=self.url, kind=self.kind, tenant=self.tenant,
+                   weight=self.weight, state=self.state, folder=self.folder,
+                   filepath=self.filepath, queued=len(self.queue), running=self.running,
+                   seconds=end - self.started if self.started else 0.0)
+        return ans
+
+
+class FairPool(object):
+    """Worker threads running the tasks of many jobs by deficit round
+    robin, see the module docs.
+
+    :param workers: number of threads.
+    :param quantum: bytes added to the deficit of a job of weight 1 every
+        round.
+    :param task_cost: bytes charged for a task on top of what it wrote,
+        the cost of the request itself.
+    """
+
+    def __init__(self, workers=8, quantum=64 * 1024, task_cost=1024):
+        self.workers = workers
+        self.quantum = quantum
+        self.task_cost = task_cost
+        self.ring = []
+        self.busy = 0
+        self._cursor = 0
+        self._closed = False
+        self._lock = threading.Condition()
+        self._threads = [threading.Thread(target=self._work, name='pywebcopy-fair-%d' % i)
+                         for i in range(workers)]
+        for t in self._threads:
+            t.daemon = True
+            t.start()
+
+    def submit(self, job, func, *args):
+        """Queues `func(*args)` as a task of `job`, it returns the bytes to
+        charge. Returns False if the job takes no more tasks."""
+        with self._lock:
+            if not job.active or self._closed:
+                return False
+            if job not in self.ring:
+                self.ring.append(job)
+            job.queue.append((func, args))
+            self._lock.notify()
+        return True
+
+    def cancel(self, job, state='cancelled'):
+        """Drops the queued tasks of `job`, the running ones are finished."""
+        with self._lock:
+            if not job.active:
+                return False
+            job.stats['dropped'] += len(job.queue)
+            job.queue.clear()
+            job.state = state
+            self._retire(job)
+        return True
+
+    def close(self, wait=True):
+        with self._lock:
+            self._closed = True
+            for job in list(self.ring):
+                job.stats['dropped'] += len(job.queue)
+                job.queue.clear()
+                job.state = 'cancelled'
+                self._retire(job)
+            self._lock.notify_all()
+        if wait:
+            for t in self._threads:
+                t.join()
+
+    def share(self, job):
+        """Tasks `job` may run at once, its weighted share of the workers."""
+        total = sum(j.weight for j in self.ring if j.queue or j.running)
+        return max(1, int(math.ceil(self.workers * job.weight / (total or job.weight))))
+
+    def _eligible(self, job):
+        return job.queue and job.running < self.share(job)
+
+    def _next(self):
+        """Returns the next `(job, task)` by deficit round robin or None,
+        with the lock held."""
+        ring = self.ring
+        if not any(self._eligible(j) for j in ring):
+            return None
+        while True:
+            job = ring[self._cursor]
+            if self._eligible(job):
+                if job.deficit > 0:
+                    job.running += 1
+                    return job, job.queue.popleft()
+                job.deficit += self.quantum * job.weight
+            elif not job.queue:
+                # an idle job does not save up credit
+                job.deficit = min(job.deficit, 0.0)
+            self._cursor = (self._cursor + 1) % len(ring)
+
+    def _retire(self, job):
+        if job.running or job.queue:
+            return
+        if job in self.ring:
+            index = self.ring.index(job)
+            del self.ring[index]
+            if index < self._cursor:
+                self._cursor -= 1
+            self._cursor %= len(self.ring) or 1
+        if job.active:
+            job.state = 'done'
+        job.finished = time.time()
+        job.done.set()
+        self._lock.notify_all()
+
+    def _work(self):
+        while True:
+            with self._lock:
+                item = self._next()
+                while item is None:
+                    if self._closed:
+                        return
+                    self._lock.wait()
+                    item = self._next()
+                job, (func, args) = item
+                self.busy += 1
+                if job.state == 'queued':
+                    job.state = 'running'
+                    job.started = time.time()
+            cost = 0
+            try:
+                cost = func(*args) or 0
+            except Exception as e:
+                job.stats['errors'] += 1
+                logger.error("Task of job %d failed: %r", job.id, e)
+            with self._lock:
+                self.busy -= 1
+                job.running -= 1
+                job.deficit -= cost + self.task_cost
+                if job.active and job.exhausted():
+                    job.stats['dropped'] += len(job.queue)
+                    job.queue.clear()
+                    job.state = 'exhausted'
+                self._retire(job)
+                self._lock.notify_all()
+
+
+class FairScheduler(Scheduler):
+    """Scheduler of one :class:`Job`, its resources are tasks of a shared
+    :class:`FairPool`."""
+    #: the resources are handed to the pool right away
+    max_parallel = 1
+
+    def __init__(self, pool, job, *args, **kwargs):
+        super(FairScheduler, self).__init__(*args, **kwargs)
+        self.speculative_paths = True
+        self.pool = pool
+        self.job = job
+        #: the first page of the job
+        self.root = None
+
+    def handle_resource(self, resource):
+        if not self.job.active:
+            self.job.stats['dropped'] += 1
+            return resource.filepath
+        return super(FairScheduler, self).handle_resource(resource)
+
+    def _handle_resource(self, resource):
+        if not self.pool.submit(self.job, self._run, resource):
+            self.job.stats['dropped'] += 1
+
+    def _run(self, resource):
+        """Fetches and writes one resource, returns the bytes written."""
+        job = self.job
+        if not job.active or job.exhausted():
+            return 0
+        self._fetch(resource)
+        try:
+            size = os.path.getsize(resource.filepath)
+        except (OSError, TypeError):
+            size = None
+        with self.pool._lock:
+            stats = job.stats
+            if resource is self.root:
+                job.filepath = resource.filepath
+            if size is None:
+                stats['errors'] += 1
+                return 0
+            stats['files'] += 1
+            stats['bytes'] += size
+            if os.path.splitext(resource.filepath)[1] in ('.html', '.htm'):
+                stats['pages'] += 1
+        return size
+
+
+class Daemon(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    """Unix socket server of the capture jobs, see the module docs.
+
+    :param socket_path: path of the unix socket, replaced if a daemon
+        which is gone left it there.
+    :param project_folder: folder in which every job gets its own folder.
+    :param workers: threads of the :class:`FairPool`.
+    :param quantum: see :class:`FairPool`.
+    """
+    daemon_threads = True
+    allow_reuse_address = True
+
+    def __init__(self, socket_path, project_folder=None, workers=8, bypass_robots=False,
+                 delay=None, dns_ttl=300.0, quantum=64 * 1024):
+        _remove_stale_socket(socket_path)
+        socketserver.UnixStreamServer.__init__(self, socket_path, _Handler)
+        self.socket_path = socket_path
+        self.project_folder = project_folder
+        self.bypass_robots = bypass_robots
+        self.delay = delay
+        self.dns = DNSCache(dns_ttl) if dns_ttl else None
+        self.session = shared_session(bypass_robots, delay=delay, pool_maxsize=workers, dns=self.dns)
+        self.pool = FairPool(workers, quantum)
+        self.jobs = {}
+        self._jobs_lock = threading.Lock()
+        self._ids = itertools.count(1)
+        logger.info("Capture daemon listening on [%s] with %d workers.", socket_path, workers)
+
+    def submit(self, url, kind='page', tenant=None, weight=1.0, project_name=None,
+               max_pages=None, max_bytes=None, max_seconds=None):
+        """Starts a capture job and returns it, `project_name` is reduced
+        to a plain file name so that the job stays in the project folder."""
+        job = Job(next(self._ids), url, kind, tenant, weight, (max_pages, max_bytes, max_seconds))
+        if project_name:
+            # names come from the socket, never let one leave the project folder
+            project_name = secure_filename(str(project_name))
+            if not project_name:
+                raise ValueError("Invalid project name.")
+        else:
+            project_name = '%s_%d' % ('_'.join(
+                secure_filename(str(x)) for x in get_host(url) if x), job.id)
+        config = get_config(url, self.project_folder, project_name,
+                            self.bypass_robots, delay=self.delay).freeze()
+        job.folder = config.project_folder
+        scheduler = FairScheduler(self.pool, job)
+        template = default_scheduler() if kind == 'page' else crawler_scheduler()
+        scheduler.default, scheduler.data = template.default, template.data
+        factory = WebPage if kind == 'page' else Crawler
+        page = factory(self.session, config, scheduler, Context.from_config(config))
+        job.filepath = page.filepath
+        scheduler.root = page
+        with self._jobs_lock:
+            self.jobs[job.id] = job
+        scheduler.handle_resource(page)
+        logger.info("Job %d of [%s]: %s %s", job.id, tenant, kind, url)
+        return job
+
+    def cancel(self, job_id):
+        return self.pool.cancel(self.jobs[job_id])
+
+    def all_jobs(self):
+        """Snapshot of the jobs, safe while handlers submit new ones."""
+        with self._jobs_lock:
+            return list(self.jobs.values())
+
+    def stats(self, job_id=None):
+        if job_id is not None:
+            return self.jobs[job_id].as_dict()
+        return {'workers': self.pool.workers, 'busy': self.pool.busy,
+                'jobs': [job.as_dict() for job in self.all_jobs()]}
+
+    def handle_request_line(self, line):
+        """Returns the answer to one json request line."""
+        try:
+            request = json.loads(line)
+            op = request.pop('op')
+            if op == 'submit':
+                return {'ok': True, 'job': self.submit(**request).id}
+            if op == 'stats':
+                return {'ok': True, 'job' if 'job' in request else 'daemon':
+                        self.stats(request.get('job'))}
+            if op == 'list':
+                return {'ok': True, 'jobs': [
+                    {'id': j.id, 'state': j.state, 'url': j.url} for j in self.all_jobs()]}
+            if op == 'cancel':
+                return {'ok': True, 'cancelled': self.cancel(request['job'])}
+            if op == 'shutdown':
+                threading.Thread(target=self.shutdown).start()
+                return {'ok': True}
+            return {'ok': False, 'error': 'unknown op %r' % op}
+        except KeyError as e:
+            return {'ok': False, 'error': 'missing or unknown %s' % e}
+        except (ValueError, TypeError) as e:
+            return {'ok': False, 'error': str(e)}
+        except Exception as e:
+            logger.exception("Request %r failed.", line)
+            return {'ok': False, 'error': '%s: %s' % (type(e).__name__, e)}
+
+    def server_bind(self):
+        # the socket accepts no connection before server_activate() calls
+        # listen(), so there is no window in which others could connect
+        socketserver.UnixStreamServer.server_bind(self)
+        os.chmod(self.server_address, 0o600)
+
+    def server_close(self):
+        socketserver.UnixStreamServer.server_close(self)
+        self.pool.close()
+        self.session.close()
+        if os.path.exists(self.socket_path):
+            os.unlink(self.socket_path)
+
+
+def _remove_stale_socket(path):
+    """Removes the socket left at `path` by a daemon which is gone; raises
+    OSError if something else is there or a daemon still listens on it."""
+    try:
+        mode = os.lstat(path).st_mode
+    except OSError as e:
+        if e.errno == errno.ENOENT:
+            return
+        raise
+    if not stat.S_ISSOCK(mode):
+        raise OSError(errno.EEXIST, "Not a socket, refusing to replace it", path)
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        sock.connect(path)
+    except OSError as e:
+        if e.errno != errno.ECONNREFUSED:
+            raise
+    else:
+        raise OSError(errno.EADDRINUSE, "A daemon is listening already", path)
+    finally:
+        sock.close()
+    os.unlink(path)
+
+
+class _Handler(socketserver.StreamRequestHandler):
+    def handle(self):
+        for line in self.rfile:
+            if not line.strip():
+                continue
+            answer = self.server.handle_request_line(line.decode('utf-8'))
+            self.wfile.write(json.dumps(answer).encode('utf-8') + b'\n')
+            self.wfile.flush()
+
+
+class DaemonClient(object):
+    """Client of a :class:`Daemon`, raises RuntimeError with the error of
+    a failed request."""
+
+    def __init__(self, socket_path, timeout=30.0):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.settimeout(timeout)
+        self.sock.connect(socket_path)
+        self.rfile = self.sock.makefile('rb')
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def request(self, op, **params):
+        params['op'] = op
+        self.sock.sendall(json.dumps(params).encode('utf-8') + b'\n')
+        answer = json.loads(self.rfile.readline().decode('utf-8'))
+        if not answer.pop('ok'):
+            raise RuntimeError(answer['error'])
+        return answer
+
+    def submit(self, url, **params):
+        return self.request('submit', url=url, **params)['job']
+
+    def stats(self, job=None):
+        if job is None:
+            return self.request('stats')['daemon']
+        return self.request('stats', job=job)['job']
+
+    def cancel(self, job):
+        return self.request('cancel', job=job)['cancelled']
+
+    def shutdown(self):
+        return self.request('shutdown')
+
+    def close(self):
+        self.rfile.close()
+        self.sock.close()
@@ -0,0 +1,320 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Page captures which end by a deadline.
+
+`page.save_complete(deadline=5)` returns after about five seconds however
+slow the servers of the assets are. While a :class:`Deadline` is the
+`deadline` plug-in of the scheduler:
+
+* every resource is queued instead of being fetched by the thread which
+  found it, and a pool of workers fetches them in priority order, the
+  :data:`CRITICAL_TYPES` (html, stylesheets, fonts) first;
+* a page or stylesheet links to its children once they are all fetched or
+  the deadline is reached, whichever comes first;
+* at the deadline the queued resources are dropped and the non-critical
+  ones being fetched are cancelled by closing their connection; the
+  critical ones being fetched are given `grace` more seconds to finish,
+  then they are cancelled too;
+* the links to a dropped or cancelled resource are left pointing at its
+  absolute url, as :class:`pywebcopy.elements.AbsoluteUrlResource` does.
+
+The capture then returns a :class:`DeadlineReport` of what was fetched
+and what was dropped; `page.save_complete(deadline=5)` only returns the
+path of the page, as without a deadline.
+
+Usage::
+
+    page = WebPage(session, config, default_scheduler(), context)
+    report = capture_before(page, 5)
+    if not report.complete:
+        print("left online:", report.dropped + report.cancelled)
+"""
+import heapq
+import itertools
+import logging
+import os
+import threading
+import time
+from collections import namedtuple
+
+from .elements import CSSResource
+from .elements import HTMLResource
+from .urls import guess_content_type
+
+__all__ = ['CRITICAL_TYPES', 'Deadline', 'DeadlineReport', 'GRACE', 'capture_before', 'is_critical']
+
+logger = logging.getLogger(__name__)
+
+#: content types without which a page does not render, their prefixes;
+#: fetched before the others and given :data:`GRACE` more seconds once
+#: started.
+CRITICAL_TYPES = (
+    'text/html',
+    'text/css',
+    'font/',
+    'application/font-',
+    'application/x-font-',
+    'application/vnd.ms-fontobject',
+)
+
+#: seconds past the deadline after which the critical fetches under way
+#: are cancelled too.
+GRACE = 2.0
+
+#: longest wait for a running fetch before its state is checked again.
+_POLL = 0.1
+
+DeadlineReport = namedtuple('DeadlineReport', 'filepath complete fetched dropped cancelled seconds')
+DeadlineReport.__doc__ = """Outcome of a capture with a deadline: the
+`filepath` of the page, the urls `fetched`, the urls `dropped` before
+they were requested and the ones `cancelled` while being fetched, the
+links to both are left absolute. It is `complete` if none was left out."""
+
+
+def is_critical(resource):
+    """Returns True if `resource` is of one of the :data:`CRITICAL_TYPES`,
+    judging by its url or else by its handler."""
+    ctype = resource.context.content_type or guess_content_type(resource.context.url)
+    if ctype is None:
+        if isinstance(resource, CSSResource):
+            ctype = 'text/css'
+        elif isinstance(resource, HTMLResource):
+            ctype = 'text/html'
+        else:
+            return False
+    return ctype.startswith(CRITICAL_TYPES)
+
+
+class _Task(object):
+    __slots__ = ('url', 'resource', 'fetch', 'critical', 'state', 'waiting')
+
+    def __init__(self, url, resource, fetch):
+        self.url = url
+        self.resource = resource
+        self.fetch = fetch
+        self.critical = is_critical(resource)
+        #: queued, running, cancelling, done, dropped or cancelled
+        self.state = 'queued'
+        #: read and waiting for its children, no longer cancelled
+        self.waiting = False
+
+    @property
+    def finished(self):
+        # a cancelled fetch is not waited for
+        return self.state not in ('queued', 'running')
+
+
+class Deadline(object):
+    """Fetches the resources of a capture by priority until `seconds` have
+    passed, see the module docs.
+
+    :param seconds: time left to the capture.
+    :param workers: resources fetched at once; the threads waiting for
+        their children fetch them too.
+    :param grace: seconds past the deadline given to the critical
+        resources being fetched.
+    """
+
+    def __init__(self, seconds, workers=8, grace=GRACE):
+        self.seconds = seconds
+        self.workers = workers
+        self.grace = grace
+        self.start = time.time()
+        self.expires = self.start + seconds
+        self.tasks = {}
+        self._dropped = set()
+        self._queue = []
+        self._seq = itertools.count()
+        self._threads = []
+        self._closed = False
+        self._cond = threading.Condition()
+        # task run by the thread, whose children it waits for
+        self._local = threading.local()
+        self._timers = [threading.Timer(max(0.0, seconds), self.expire),
+                        threading.Timer(max(0.0, seconds + grace), self.expire, (True,))]
+        for timer in self._timers:
+            timer.daemon = True
+            timer.start()
+
+    def __repr__(self):
+        return '<Deadline(seconds=%r, remaining=%.3f)>' % (self.seconds, self.remaining())
+
+    @property
+    def expired(self):
+        return time.time() >= self.expires
+
+    def remaining(self):
+        return max(0.0, self.expires - time.time())
+
+    def timeout(self, resource):
+        """Timeout of the request of `resource` started now, it ends by the
+        deadline, or by the end of the grace if the resource is critical."""
+        left = self.remaining()
+        if is_critical(resource):
+            left += self.grace
+        return max(0.001, left)
+
+    def order(self, resources):
+        """Returns the resources in the order they should be queued, the
+        critical ones first so that idle workers start on them."""
+        return sorted(resources, key=lambda r: not is_critical(r))
+
+    def dropped(self, url):
+        """True if the resource at `url` was dropped or cancelled."""
+        return url in self._dropped
+
+    def submit(self, resource, fetch):
+        """Queues `fetch(resource)`; a resource queued after the deadline
+        is dropped right away."""
+        url = resource.context.url
+        with self._cond:
+            if url in self.tasks:
+                return
+            self.tasks[url] = task = _Task(url, resource, fetch)
+            if self.expired:
+                task.state = 'dropped'
+                self._dropped.add(url)
+                return
+            heapq.heappush(self._queue, (not task.critical, next(self._seq), task))
+            if len(self._threads) < self.workers:
+                t = threading.Thread(target=self._work, name='pywebcopy-deadline-%d' % len(self._threads))
+                t.daemon = True
+                self._threads.append(t)
+                t.start()
+            self._cond.notify()
+
+    def wait(self, resources):
+        """Returns once the given resources are fetched, dropped or
+        cancelled; their queued ones are fetched by the calling thread
+        meanwhile, the most urgent first."""
+        urls = [r.context.url for r in resources]
+        parent = getattr(self._local, 'task', None)
+        if parent is not None:
+            parent.waiting = True
+        while True:
+            with self._cond:
+                own = [self.tasks[u] for u in urls if u in self.tasks]
+                pending = [t for t in own if not t.finished]
+                if not pending:
+                    return
+                task = self._pop(pending)
+                if task is None:
+                    # running ones notify once they finish
+                    self._cond.wait(self.remaining() or _POLL)
+                    continue
+            self._run(task)
+
+    def expire(self, critical=False):
+        """Drops the queued resources and cancels the non-critical ones
+        being fetched, called by a timer at the deadline; with `critical`
+        the critical ones too, called once the grace is over."""
+        with self._cond:
+            if self._closed:
+                return
+            for _, _, task in self._queue:
+                if task.state == 'queued':
+                    task.state = 'dropped'
+                    self._dropped.add(task.url)
+            del self._queue[:]
+            cancelled = [t for t in self.tasks.values() if t.state == 'running' and (
+                not t.critical or critical and not t.waiting)]
+            for task in cancelled:
+                task.state = 'cancelling'
+                self._dropped.update((task.url, task.resource.context.url))
+            self._cond.notify_all()
+        for task in cancelled:
+            logger.info("Deadline reached, cancelling [%s]", task.url)
+            response = getattr(task.resource, 'response', None)
+            if response is not None:
+                # the thread reading it fails and moves on
+                response.close()
+
+    def report(self, filepath=None):
+        with self._cond:
+            tasks = list(self.tasks.values())
+        fetched = [t.url for t in tasks if t.state == 'done']
+        dropped = [t.url for t in tasks if t.state == 'dropped']
+        cancelled = [t.url for t in tasks if t.state in ('cancelling', 'cancelled')]
+        return DeadlineReport(filepath, not (dropped or cancelled), fetched, dropped, cancelled,
+                              time.time() - self.start)
+
+    def close(self):
+        """Stops the workers, the ones fetching a resource finish it."""
+        for timer in self._timers:
+            timer.cancel()
+        with self._cond:
+            self._closed = True
+            self._cond.notify_all()
+
+    def _pop(self, among=None):
+        """Returns the most urgent queued task, of `among` if given, marked
+        as running; with the lock held."""
+        if self.expired:
+            # dropped by :meth:`expire`
+            return None
+        if among is not None:
+            queued = [t for t in among if t.state == 'queued']
+            task = min(queued, key=lambda t: not t.critical) if queued else None
+        else:
+            task = None
+            while self._queue and task is None:
+                task = heapq.heappop(self._queue)[2]
+                if task.state != 'queued':
+                    task = None
+        if task is not None:
+            task.state = 'running'
+        return task
+
+    def _run(self, task):
+        parent, self._local.task = getattr(self._local, 'task', None), task
+        try:
+            task.fetch(task.resource)
+        except Exception as e:
+            logger.error("Failed to retrieve [%s]: %r", task.url, e)
+        finally:
+            self._local.task = parent
+        with self._cond:
+            cancelled = task.state == 'cancelling'
+            task.state = 'cancelled' if cancelled else 'done'
+            self._cond.notify_all()
+        if cancelled:
+            # whatever was written of it is incomplete
+            filepath = task.resource.filepath
+            if filepath and os.path.isfile(filepath):
+                os.remove(filepath)
+
+    def _work(self):
+        while True:
+            with self._cond:
+                task = self._pop()
+                while task is None:
+                    if self._closed:
+                        return
+                    self._cond.wait()
+                    task = self._pop()
+            self._run(task)
+
+
+def capture_before(page, seconds, workers=8, grace=GRACE):
+    """Captures `page` and its files until `seconds` have passed and
+    returns a :class:`DeadlineReport`, see the module docs."""
+    scheduler = page.scheduler
+    deadline = Deadline(seconds, workers, grace)
+    scheduler.deadline = deadline
+    try:
+        scheduler.handle_many([page])
+    finally:
+        scheduler.deadline = None
+        deadline.close()
+    report = deadline.report(page.filepath)
+    # a later capture fetches them again
+    for url in report.dropped + report.cancelled:
+        try:
+            del scheduler.index[url]
+        except KeyError:
+            pass
+    logger.info("Captured [%s] in %.3f seconds, %d files fetched, %d dropped, %d cancelled",
+                page.url, report.seconds, len(report.fetched), len(report.dropped),
+                len(report.cancelled))
+    return report
@@ -6,7 +6,6 @@ import re
 import warnings
 from base64 import b64encode
 from datetime import datetime
-from functools import partial
 from io import BytesIO
 from textwrap import dedent
 
@@ -20,17 +19,71 @@ from six import binary_type
 from six import string_types
 from six.moves.urllib.request import pathname2url
 
+from . import events
+from . import memtrace
 from .__version__ import __version__
+from .graph import IMAGE
+from .graph import LINK
+from .graph import SCRIPT
+from .graph import STYLESHEET
+from .graph import edge_kind
 from .helpers import RewindableResponse
 from .helpers import cached_property
+from .parsers import HEAD_LIMIT
+from .parsers import Prefixed
 from .parsers import iterparse
+from .parsers import read_head
 from .parsers import unquote_match
 from .urls import get_content_type_from_headers
+from .urls import guess_content_type
 from .urls import relate
 from .urls import retrieve_resource
 
 logger = logging.getLogger(__name__)
 
+#: content type assumed for a link whose url has no known extension when
+#: paths are assigned speculatively (see :meth:`GenericResource.pin_path`).
+SPECULATIVE_TYPES = {
+    LINK: 'text/html',
+    STYLESHEET: 'text/css',
+    SCRIPT: 'application/javascript',
+}
+
+
+def speculative_type(url, kind, tag=None):
+    """Returns the content type a link of `kind` is expected to have, or
+    None if there is no telling before it is fetched."""
+    # other <link> relations are manifests, feeds, preloads...
+    default = None if tag == 'link' and kind == LINK else SPECULATIVE_TYPES.get(kind)
+    return guess_content_type(url, default)
+
+
+def write_redirect(path, target_path, url=None):
+    """Writes a tiny html page at `path` sending its readers to the file
+    at `target_path`."""
+    target = pathname2url(relate(target_path, path))
+    stub = ('<!DOCTYPE html><html><head>'
+            '<meta http-equiv="refresh" content="0; url=%s">'
+            '<link rel="canonical" href="%s"></head></html>') % (target, target)
+    retrieve_resource(
+        BytesIO(stub.encode('ascii', 'xmlcharrefreplace')),
+        path, url, overwrite=True)
+    return path
+
+
+class _ClassLogger(object):
+    """Child logger named after the class of the instance, created once per
+    class instead of once per resource."""
+
+    def __init__(self):
+        self._loggers = {}
+
+    def __get__(self, instance, owner):
+        lg = self._loggers.get(owner)
+        if lg is None:
+            lg = self._loggers[owner] = logger.getChild(owner.__name__)
+        return lg
+
 
 class ResponseWrapper(object):
     session = None
@@ -76,11 +129,12 @@ class ResponseWrapper(object):
     def encoding(self):
         """Returns an explicit encoding if defined in the config else
         the encoding reported by the server."""
+        #: Explicit encoding takes precedence
+        if self.settings.encoding:
+            return self.settings.encoding
         if self.response is not None:
-            #: Explicit encoding takes precedence
-            return self.config.get(
-                'encoding', self.response.encoding or 'ascii')
-        return self.config.get('encoding', 'ascii')
+            return self.response.encoding or 'ascii'
+        return 'ascii'
 
     html_content_types = tuple([
         'text/htm',
@@ -140,13 +194,15 @@ class ResponseWrapper(object):
 
     def request(self, method, url, **params):
         req = self.session.request  # local bind
-        resp = req(method, url, stream=True, **params) if params else req(method, url, stream=True)
-        self.set_response(resp)
+        with memtrace.stage('fetch', self):
+            resp = req(method, url, stream=True, **params) if params else req(method, url, stream=True)
+            self.set_response(resp)
 
     def get(self, url, **params):
         req = self.session.get  # local bind
-        resp = req(url, stream=True, **params) if params else req(url, stream=True)
-        self.set_response(resp)
+        with memtrace.stage('fetch', self):
+            resp = req(url, stream=True, **params) if params else req(url, stream=True)
+            self.set_response(resp)
 
 
 
@@ -200,11 +256,18 @@ class ResponseWrapper(object):
         self.response.raw.decode_content = True
         if buffered:
             return self.response.raw, self.encoding
-        return self.response.content, self.encoding
+        with memtrace.stage('buffer', self):
+            return self.response.content, self.encoding
 
 
 
 class GenericResource(ResponseWrapper):
+    logger = _ClassLogger()
+
+    #: path assigned from the url before the resource was fetched (see
+    #: :meth:`pin_path`), it is kept whatever type the server reports.
+    pinned = None
+
     def __init__(self, session, config, scheduler, context, response=None):
         """
         Generic internet resource which processes a server response based on responses
@@ -213,19 +276,21 @@ class GenericResource(ResponseWrapper):
         suitable html parser.
 
         :param session: http client used for networking.
-        :param config: project configuration handler.
+        :param config: project configuration handler, its read-only
+            snapshot is kept as :attr:`settings` (see
+            :meth:`ConfigHandler.freeze`).
         :param response: http response from the server.
         :param scheduler: response processor scheduler.
         :param context: context of this response; should contain base-location, base-url etc.
         """
         self.session = session
         self.config = config
+        self.settings = config.freeze() if config is not None else None
         self.scheduler = scheduler
         self.context = context
         self.response = None
         if response:
             self.set_response(response)
-        self.logger = logger.getChild(self.__class__.__name__)
 
     def __repr__(self):
         return '<%s(url=%s)>' % (self.__class__.__name__, self.context.url)
@@ -236,11 +301,52 @@ class GenericResource(ResponseWrapper):
          where this file should be written."""
         if self.context is None:
             raise AttributeError("Context attribute is not set.")
+        if self.pinned is not None:
+            return self.pinned
         if self.response is not None:
             ctypes = get_content_type_from_headers(self.response.headers)
             self.context = self.context.with_values(content_type=ctypes)
         return self.context.resolve()
 
+    def pin_path(self, content_type):
+        """Assigns the path of a resource of `content_type` to this one
+        before it is fetched, so the parent can link to it right away."""
+        self.context = self.context.with_values(content_type=content_type)
+        self.__dict__.pop('filepath', None)
+        self.pinned = self.context.resolve()
+        return self.pinned
+
+    def speculate(self, kind, tag=None):
+        """Pins the path guessed from the url and the `kind` of the link to
+        this resource (see :func:`speculative_type`), returns it or None."""
+        content_type = speculative_type(self.context.url, kind, tag)
+        if content_type is None:
+            return None
+        return self.pin_path(content_type)
+
+    def _check_pinned_path(self):
+        """Reconciles the pinned path with the type the server reported.
+
+        The resource is written at its pinned path even if the type
+        differs, except for a page guessed to be html which is not: it is
+        written at its own path and a redirect to it takes the pinned path.
+        """
+        pinned = self.pinned
+        ctypes = get_content_type_from_headers(self.response.headers)
+        actual = self.context.with_values(content_type=ctypes).resolve()
+        if actual == pinned:
+            return
+        if self.response.ok and not self.viewing_html() and \
+                os.path.splitext(pinned)[1].lower() in ('.html', '.htm'):
+            self.pinned = None
+            self.__dict__.pop('filepath', None)
+            write_redirect(pinned, self.filepath, self.context.url)
+            self.logger.info("Resource [%s] is not html, redirecting [%s] to [%s]",
+                             self.url, pinned, self.filepath)
+        else:
+            self.logger.debug("Resource [%s] of type [%s] kept at pinned path [%s]",
+                              self.url, ctypes, pinned)
+
     @cached_property
     def filename(self):
         """Returns a valid filename of this resource if available."""
@@ -254,15 +360,23 @@ class GenericResource(ResponseWrapper):
                 "You need to fetch the resource using get method!"
             )
         # XXX: Validate resource here?
-        return self._retrieve()
+        if self.pinned is not None:
+            self._check_pinned_path()
+        revisits = getattr(self.scheduler, 'revisits', None)
+        if revisits is None:
+            return self._retrieve()
+        # files kept from an earlier visit have no new digest
+        state = revisits.file_state(self.filepath)
+        ans = self._retrieve()
+        revisits.observe_resource(self, written=state is None or revisits.file_state(self.filepath) != state)
+        return ans
 
     def _retrieve(self):
         #: Not ok response received from the server
         if not 100 <= self.response.status_code <= 400:
             self.logger.error(
-                'Status Code [<%d>] received from the server [%s]'
-                % (self.response.status_code, self.response.url)
-            )
+                'Status Code [<%d>] received from the server [%s]',
+                self.response.status_code, self.response.url)
             if isinstance(self.response.reason, binary_type):
                 content = BytesIO(self.response.reason)
             else:
@@ -270,16 +384,16 @@ class GenericResource(ResponseWrapper):
         else:
             if not hasattr(self.response, 'raw'):
                 self.logger.error(
-                    "Response object for url <%s> has no attribute 'raw'!"
-                    % self.url)
+                    "Response object for url <%s> has no attribute 'raw'!", self.url)
                 content = BytesIO(self.response.content)
             elif self.viewing_svg() and self.content_encoding == 'gzip':
                 content = BytesIO(self.response.content)
             else:
                 content = self.response.raw
 
-        retrieve_resource(
-            content, self.filepath, self.context.url, self.config.get('overwrite'))
+        with memtrace.stage('write', self):
+            retrieve_resource(
+                content, self.filepath, self.context.url, self.settings.overwrite)
         del content
         return self.filepath
 
@@ -287,6 +401,10 @@ class GenericResource(ResponseWrapper):
         """Returns a relative url at which this resource should be accessed
         by the parent file.
         """
+        deadline = getattr(self.scheduler, 'deadline', None)
+        if deadline is not None and deadline.dropped(self.context.url):
+            # left online, as :class:`AbsoluteUrlResource` does
+            return self.context.url
         filepath = self.filepath
         if not isinstance(filepath, string_types):
             raise ValueError("Invalid filepath [%r]" % filepath)
@@ -295,9 +413,17 @@ class GenericResource(ResponseWrapper):
         return pathname2url(filepath)
 
 
+def _is_canonical_link(elem):
+    return elem.tag == 'link' and 'canonical' in (elem.get('rel') or '').lower().split()
+
+
 class HTMLResource(GenericResource):
     """Interpreter for resource written in or reported as html."""
 
+    #: links to other pages are made absolute instead of crawled when
+    #: False, set by the scheduler for pages demoted by the trap detector.
+    follow_links = True
+
     def parse(self, **kwargs):
         """Returns an `pywebcopy.parsers.iterparse` instance with
         the file-object returned from the `.get_source(buffered=True)`.
@@ -308,7 +434,7 @@ class HTMLResource(GenericResource):
         return iterparse(
             source, encoding, include_meta_charset_tag=True, **kwargs)
 
-    def extract_children(self, parsing_buffer):
+    def extract_children(self, parsing_buffer, follow_links=True):
         """
         Iterates over the `pywebcopy.parsers.iterparse` object and
         extract the elements which are handed over to the `scheduler`
@@ -316,47 +442,171 @@ class HTMLResource(GenericResource):
         in the `pywebcopy.parsers.iterparse` object.
 
         :param parsing_buffer: `iterparse` object.
+        :param follow_links: if False the links to other pages (anchors,
+            forms and frames) are made absolute instead of being crawled.
         """
         location = self.filepath
+        graph = getattr(self.scheduler, 'graph', None)
+        edges = [] if graph is not None else None
+
+        if getattr(self.scheduler, 'deadline', None) is not None:
+            # the children are fetched together, by priority
+            links = list(parsing_buffer)
+            table = [(elem.tag, url, edge_kind(elem, attr), _is_canonical_link(elem))
+                     for elem, attr, url, pos in links]
+            for (elem, attr, url, pos), resolved in zip(links, self.resolve_children(table, follow_links)):
+                if resolved is not None:
+                    elem.replace_url(url, resolved, attr, pos)
+            return parsing_buffer
 
         for elem, attr, url, pos in parsing_buffer:
-            if not self.scheduler.validate_url(url):
-                continue
+            resolved = self._child_url(
+                elem.tag, url, edge_kind(elem, attr), _is_canonical_link(elem),
+                follow_links, location, edges)
+            if resolved is not None:
+                elem.replace_url(url, resolved, attr, pos)
+
+        if edges:
+            graph.add_edges(self.context.url, edges)
+        return parsing_buffer
 
-            sub_context = self.context.create_new_from_url(url)
-            ans = self.scheduler.get_handler(
-                elem.tag,
-                self.session, self.config, self.scheduler, sub_context)
-            self.scheduler.handle_resource(ans)
-            resolved = ans.resolve(location)
-            elem.replace_url(url, resolved, attr, pos)
+    def resolve_children(self, table, follow_links=True):
+        """Schedules the links of a :func:`pywebcopy.offload.link_table`
+        and returns their new urls in the same order, None for the ones
+        left unchanged."""
+        location = self.filepath
+        graph = getattr(self.scheduler, 'graph', None)
+        edges = [] if graph is not None else None
+        # with a deadline the children are handled together
+        children = {} if getattr(self.scheduler, 'deadline', None) is not None else None
+        ans = [self._child_url(tag, url, kind, canonical, follow_links, location, edges, children)
+               for tag, url, kind, canonical in table]
+        if edges:
+            graph.add_edges(self.context.url, edges)
+        if children:
+            self.scheduler.handle_many(list(children.values()))
+            ans = [a.resolve(location) if isinstance(a, GenericResource) else a for a in ans]
+        return ans
+
+    def _child_url(self, tag, url, kind, canonical, follow_links, location, edges, children=None):
+        """Hands one link over to the scheduler and returns the url it
+        should be replaced with, or None.
+
+        With `children` the new resource is added to it by url and
+        returned instead, to be resolved once they were all handled.
+        """
+        scheduler = self.scheduler
+        if not scheduler.validate_url(url):
+            return None
 
-        return parsing_buffer
+        sub_context = self.context.create_new_from_url(url)
+        if edges is not None:
+            if kind is not None:
+                edges.append((sub_context.url, kind))
+        if not follow_links and tag in scheduler.external_tags or \
+                canonical and getattr(scheduler, 'canonicals', None) is not None:
+            # the canonical url is kept for the readers of the copy
+            # and is not fetched as a stylesheet
+            return sub_context.url
+
+        resolved = scheduler.resolve_stateless(tag, sub_context, location)
+        if resolved is None:
+            ans = scheduler.get_handler(
+                tag, self.session, self.config, scheduler, sub_context)
+            if scheduler.speculative_paths:
+                ans.speculate(kind, tag)
+            if children is not None:
+                return children.setdefault(sub_context.url, ans)
+            scheduler.handle_resource(ans)
+            resolved = ans.resolve(location)
+        return resolved
 
     def _retrieve(self):
         if not self.viewing_html():
-            self.logger.info(
-                "Resource of type [%s] is not HTML." % self.content_type)
+            events.log(self.logger, events.RESOURCE_WRONG_TYPE, self.content_type, 'HTML')
             return super(HTMLResource, self)._retrieve()
 
         if not self.response.ok:
-            self.logger.debug(
-                "Resource at [%s] is NOT ok and will be NOT processed." % self.url)
+            events.log(self.logger, events.RESOURCE_NOT_OK, self.url)
             return super(HTMLResource, self)._retrieve()
 
-        context = self.extract_children(self.parse())
+        follow_links = self.follow_links
+        dedup = getattr(self.scheduler, 'dedup', None)
+        canonicals = getattr(self.scheduler, 'canonicals', None)
+        offload = getattr(self.scheduler, 'offload', None)
+        if dedup is None and canonicals is None and offload is None:
+            parsing_buffer = self.parse()
+        else:
+            # the body is needed twice, for the fingerprint and the parser,
+            # or is handed over to a worker as a whole
+            buffered = dedup is None and offload is None
+            source, encoding = self.get_source(buffered=buffered)
+            if canonicals is not None:
+                # only the head is read here, a skipped duplicate is
+                # not downloaded any further
+                if buffered:
+                    head = read_head(source)
+                    source = Prefixed(head, source)
+                else:
+                    head = source[:HEAD_LIMIT]
+                original = canonicals.check(self, head, encoding)
+                if original is not None:
+                    if canonicals.policy == 'skip':
+                        return self._write_duplicate_stub(original[1])
+                    follow_links = False
+            if dedup is not None:
+                original = dedup.check(self, source, encoding)
+                if original is not None:
+                    if dedup.policy == 'skip':
+                        return self._write_duplicate_stub(original[1])
+                    follow_links = False
+            if offload is not None:
+                return self._retrieve_offloaded(offload, source, encoding, follow_links)
+            if not buffered:
+                source = BytesIO(source)
+            parsing_buffer = iterparse(
+                source, encoding, include_meta_charset_tag=True)
+
+        with memtrace.stage('parse', self):
+            context = self.extract_children(parsing_buffer, follow_links)
 
         # WaterMarking :)
         context.root.insert(0, HtmlComment(self._get_watermark()))
 
-        retrieve_resource(
-            BytesIO(tostring(context.root, include_meta_content_type=True)),
-            self.filepath, self.context.url, overwrite=True)
+        with memtrace.stage('rewrite', self):
+            content = BytesIO(tostring(context.root, include_meta_content_type=True))
+        with memtrace.stage('write', self):
+            retrieve_resource(
+                content, self.filepath, self.context.url, overwrite=True)
 
-        self.logger.debug('Retrieved content from the url: [%s]' % self.url)
+        events.log(self.logger, events.RESOURCE_DONE, self.url)
         del context
         return self.filepath
 
+    def _retrieve_offloaded(self, offload, source, encoding, follow_links):
+        """Parses and rewrites the page in a worker of `offload`, only the
+        scheduling of its children runs in this thread."""
+        body = offload.share(source)
+        del source
+        try:
+            with memtrace.stage('parse', self):
+                table = offload.links(body, encoding).result()
+                replacements = self.resolve_children(table, follow_links)
+            with memtrace.stage('rewrite', self):
+                # the worker writes the file, the page does not come back
+                offload.rewrite(body, encoding, replacements, self._get_watermark(),
+                                self.filepath, self.context.url).result()
+        finally:
+            offload.release(body)
+
+        events.log(self.logger, events.RESOURCE_DONE, self.url)
+        return self.filepath
+
+    def _write_duplicate_stub(self, original_path):
+        """Writes a redirect to the local copy of the page this one
+        duplicates instead of the page itself."""
+        return write_redirect(self.filepath, original_path, self.context.url)
+
     def _get_watermark(self):
         # comment text should be in Unicode
         return dedent("""
@@ -435,7 +685,8 @@ class WebElement(HTMLResource):
         raw.rewind()
         if buffered:
             return raw, self.encoding
-        return raw.read(), self.encoding
+        with memtrace.stage('buffer', self):
+            return raw.read(), self.encoding
 
     def refresh(self):
         """Re-fetches the resource from the internet using the session."""
@@ -529,144 +780,157 @@ class WebElement(HTMLResource):
         return filename
 
 
-class CSSResource(GenericResource):
+#: `url(...)` references of stylesheets and scripts, quoted or not.
+URL_FUNCTION = r'url\((["][^"]*["]|[\'][^\']*[\']|[^)]*)\)'
+
+
+class TextResource(GenericResource):
+    """Base of the resources whose links are found by regexes over the
+    text, i.e. stylesheets and scripts.
+
+    The text is handled in three phases: every reference is collected
+    first, the children are then handed to the scheduler together through
+    :meth:`SchedulerBase.handle_many`, which fetches them concurrently, and
+    the text is finally rewritten in a single pass. A stylesheet with
+    hundreds of background images thus waits for the slowest of them
+    instead of for all of them in a row.
+    """
+    #: `(regex, replacement format, edge kind)` of every kind of reference,
+    #: references of the kind None are not recorded in the link graph.
+    patterns = ()
+    #: name of the resource in the events.
+    label = None
+
     def parse(self):
         """Returns the `.get_source(buffered=False)`."""
         return self.get_source(buffered=False)
 
-    def repl(self, match, encoding=None, fmt=None):
-        """
-        Schedules the linked files for downloading then resolves their references.
-        """
-        fmt = fmt or '%s'
-
-        url, _ = unquote_match(match.group(1).decode(encoding), match.start(1))
-        self.logger.debug("Sub-Css resource found: [%s]" % url)
-
-        if not self.scheduler.validate_url(url):
-            return url.encode(encoding)
+    def viewing_text(self):
+        raise NotImplementedError()
+
+    def collect_children(self, source, encoding):
+        """Phase one, returns the `(start, end, url, fmt, kind)` of every
+        reference in the text in document order."""
+        found = []
+        for pattern, fmt, kind in self.patterns:
+            for match in re.finditer(pattern.encode(encoding), source, flags=re.IGNORECASE):
+                url, _ = unquote_match(match.group(1).decode(encoding), match.start(1))
+                found.append((match.start(), match.end(), url, fmt, kind))
+        found.sort(key=lambda m: m[0])
+        refs, end = [], 0
+        for ref in found:
+            # a match inside an earlier one, e.g. `@import "url(a)"`
+            if ref[0] >= end:
+                refs.append(ref)
+                end = ref[1]
+        return refs
+
+    def schedule_children(self, refs):
+        """Phase two, hands the children of the references to the scheduler
+        at once and returns the new url of every reference, None for the
+        ones left as they are."""
+        children = {}
+        edges = []
+        for start, end, url, fmt, kind in refs:
+            events.log(self.logger, events.CSS_CHILD, self.label, url)
+            if url in children or not self.scheduler.validate_url(url):
+                continue
+            sub_context = self.context.create_new_from_url(url)
+            if kind is not None:
+                edges.append((sub_context.url, kind))
+            events.log(self.logger, events.CSS_CONTEXT, url, sub_context)
+            children[url] = child = self.__class__(
+                self.session, self.config, self.scheduler, sub_context
+            )
+            if self.scheduler.speculative_paths:
+                child.speculate(kind)
+        graph = getattr(self.scheduler, 'graph', None)
+        if graph is not None and edges:
+            graph.add_edges(self.context.url, edges)
+        for url in children:
+            events.log(self.logger, events.CSS_SUBMIT, url)
+        self.scheduler.handle_many(list(children.values()))
+        # the paths of synchronous schedulers are final only now
+        resolved = {url: child.resolve(self.filepath) for url, child in children.items()}
+        return [resolved.get(ref[2]) for ref in refs]
+
+    def rewrite_children(self, source, encoding, refs, replacements):
+        """Phase three, returns the text with every reference replaced, the
+        ones without a new url are kept as they are."""
+        out, last = [], 0
+        for (start, end, url, fmt, kind), new in zip(refs, replacements):
+            if new is None:
+                continue
+            re_enc = (fmt % new).encode(encoding)
+            events.log(self.logger, events.CSS_REENCODED, url, re_enc)
+            out.append(source[last:start])
+            out.append(re_enc)
+            last = end
+        out.append(source[last:])
+        return b''.join(out)
 
-        sub_context = self.context.create_new_from_url(url)
-        self.logger.debug('Creating context for url: %s as %s' % (url, sub_context))
-        ans = self.__class__(
-            self.session, self.config, self.scheduler, sub_context
-        )
-        # self.children.add(ans)
-        self.logger.debug("Submitting resource: [%s] to the scheduler." % url)
-        self.scheduler.handle_resource(ans)
-        re_enc = (fmt % ans.resolve(self.filepath)).encode(encoding)
-        self.logger.debug("Re-encoded the resource: [%s] as [%r]" % (url, re_enc))
-        return re_enc
-
-    # noinspection PyTypeChecker
     def extract_children(self, parsing_buffer):
         """
-        Runs the regex over the source to find the urls that are linked
-        within the css file or style tag using the `url()` construct.
+        Runs the regexes over the source to find the linked urls, schedules
+        them and returns the rewritten source.
         """
         source, encoding = parsing_buffer
-        source = re.sub(
-            (r'url\((' + '["][^"]*["]|' + "['][^']*[']|" + r'[^)]*)\)').encode(encoding),
-            partial(self.repl, encoding=encoding, fmt="url('%s')"),
-            source, flags=re.IGNORECASE
-        )
-        source = re.sub(
-            r'@import "(.*?)"'.encode(encoding),
-            partial(self.repl, encoding=encoding, fmt='"%s"'),
-            source, flags=re.IGNORECASE
-        )
+        refs = self.collect_children(source, encoding)
+        if refs:
+            source = self.rewrite_children(
+                source, encoding, refs, self.schedule_children(refs))
         return BytesIO(source)
 
     def _retrieve(self):
         """Writes the modified buffer to the disk."""
-        if not self.viewing_css():
-            self.logger.info(
-                "Resource of type [%s] is not CSS." % self.content_type)
-            return super(CSSResource, self)._retrieve()
+        if not self.viewing_text():
+            events.log(self.logger, events.RESOURCE_WRONG_TYPE, self.content_type, self.label.upper())
+            return super(TextResource, self)._retrieve()
 
         if not self.response.ok:
-            self.logger.debug(
-                "Resource at [%s] is NOT ok and will be NOT processed." % self.url)
-            return super(CSSResource, self)._retrieve()
-
-        self.logger.debug(
-            "Resource at [%s] is ok and will be processed." % self.url)
-        retrieve_resource(
-            self.extract_children(self.parse()),
-            self.filepath, self.url, self.config.get('overwrite')
-        )
-        self.logger.debug("Finished processing resource [%s]" % self.url)
+            events.log(self.logger, events.RESOURCE_NOT_OK, self.url)
+            return super(TextResource, self)._retrieve()
+
+        events.log(self.logger, events.RESOURCE_OK, self.url)
+        source = self.parse()
+        with memtrace.stage('parse', self):
+            content = self.extract_children(source)
+        del source
+        with memtrace.stage('write', self):
+            retrieve_resource(
+                content, self.filepath, self.url, self.settings.overwrite)
+        events.log(self.logger, events.RESOURCE_DONE, self.url)
         return self.filepath
 
 
-class JSResource(GenericResource):
-    def parse(self):
-        """Returns the `.get_source(buffered=False)`."""
-        return self.get_source(buffered=False)
+class CSSResource(TextResource):
+    """Stylesheet, its `url()` and `@import` references are rewritten."""
+    patterns = (
+        (URL_FUNCTION, "url('%s')", IMAGE),
+        (r'@import "(.*?)"', '@import "%s"', STYLESHEET),
+    )
+    label = 'Css'
 
-    def repl(self, match, encoding=None, fmt=None):
-        """
-        Schedules the linked files for downloading then resolves their references.
-        """
-        fmt = fmt or '%s'
+    def viewing_text(self):
+        return self.viewing_css()
 
-        url, _ = unquote_match(match.group(1).decode(encoding), match.start(1))
-        self.logger.debug("Sub-JS resource found: [%s]" % url)
 
-        if not self.scheduler.validate_url(url):
-            return url.encode(encoding)
+class JSResource(TextResource):
+    """Script, its `url()` references are rewritten.
 
-        sub_context = self.context.create_new_from_url(url)
-        self.logger.debug('Creating context for url: %s as %s' % (url, sub_context))
-        ans = self.__class__(
-            self.session, self.config, self.scheduler, sub_context
-        )
-        # self.children.add(ans)
-        self.logger.debug("Submitting resource: [%s] to the scheduler." % url)
-        self.scheduler.handle_resource(ans)
-        re_enc = (fmt % ans.resolve(self.filepath)).encode(encoding)
-        self.logger.debug("Re-encoded the resource: [%s] as [%r]" % (url, re_enc))
-        return re_enc
-
-    # noinspection PyTypeChecker
-    def extract_children(self, parsing_buffer):
-        """
-        Runs the regex over the source to find the urls that are linked
-        within the js file or script tag using the `url()` construct.
-
-        ..todo::
-            It only recognises one type of url inside of the js.
-            i.e. `url('example.com')`. Make it universal.
-        """
-        source, encoding = parsing_buffer
-        # P.S. There is one interesting Regex on this github repo under MIT license
-        # https://github.com/GerbenJavado/LinkFinder/
-        source = re.sub(
-            (r'url\((' + '["][^"]*["]|' + "['][^']*[']|" + r'[^)]*)\)'
-             ).encode(encoding),
-            partial(
-                self.repl, encoding=encoding, fmt='url("%s")'
-            ), source, flags=re.IGNORECASE
-        )
-        return BytesIO(source)
-
-    def _retrieve(self):
-        """Writes the modified buffer to the disk."""
-        if not self.viewing_js():
-            self.logger.info("Resource of type [%s] is not JS." % self.content_type)
-            return super(JSResource, self)._retrieve()
-
-        if not self.response.ok:
-            self.logger.debug("Resource at [%s] is NOT ok and will be NOT processed." % self.url)
-            return super(JSResource, self)._retrieve()
+    ..todo::
+        It only recognises one type of url inside of the js.
+        i.e. `url('example.com')`. Make it universal.
+    """
+    # P.S. There is one interesting Regex on this github repo under MIT license
+    # https://github.com/GerbenJavado/LinkFinder/
+    patterns = (
+        (URL_FUNCTION, 'url("%s")', None),
+    )
+    label = 'JS'
 
-        self.logger.debug("Resource at [%s] is ok and will be processed." % self.url)
-        retrieve_resource(
-            self.extract_children(self.parse()),
-            self.filepath, self.url, self.config.get('overwrite')
-        )
-        self.logger.debug("Finished processing resource [%s]" % self.url)
-        return self.filepath
+    def viewing_text(self):
+        return self.viewing_js()
 
 
 class GenericOnlyResource(GenericResource):
@@ -674,7 +938,7 @@ class GenericOnlyResource(GenericResource):
 
     def _retrieve(self):
         if self.viewing_html():
-            self.logger.debug("Resource [%s] is of HTML type and must not be processed!" % self.url)
+            self.logger.debug("Resource [%s] is of HTML type and must not be processed!", self.url)
             return False
         return super(GenericOnlyResource, self)._retrieve()
 
@@ -685,6 +949,10 @@ class GenericOnlyResource(GenericResource):
 
 
 class VoidResource(GenericResource):
+    #: links of a stateless handler are rewritten by :meth:`resolve_link`
+    #: on the class itself, the scheduler creates no instance for them.
+    stateless = False
+
     def get(self, url, **params):
         return None
 
@@ -694,19 +962,72 @@ class VoidResource(GenericResource):
     def retrieve(self):
         return None
 
+    @classmethod
+    def resolve_link(cls, context, parent_path=None):
+        raise NotImplementedError()
+
 
 # :)
 NullResource = VoidResource
 
 
 class UrlRemover(VoidResource):
-    def resolve(self, parent_path=None):
+    stateless = True
+
+    @classmethod
+    def resolve_link(cls, context, parent_path=None):
         return '#'
 
+    def resolve(self, parent_path=None):
+        return self.resolve_link(self.context, parent_path)
+
 
 class AbsoluteUrlResource(VoidResource):
+    stateless = True
+
+    @classmethod
+    def resolve_link(cls, context, parent_path=None):
+        return context.url
+
     def resolve(self, parent_path=None):
-        return self.context.url
+        return self.resolve_link(self.context, parent_path)
+
+
+class ResourceRecord(object):
+    """Compact stand-in of a resource waiting in a scheduler queue.
+
+    A resource holds the session, config and scheduler and a `__dict__` of
+    cached properties; the record keeps only what differs between queued
+    resources, the shared objects are passed again by :meth:`create`.
+    """
+    __slots__ = ('factory', 'context', 'filepath', 'follow_links', 'pinned')
+
+    def __init__(self, factory, context, filepath=None, follow_links=True, pinned=None):
+        self.factory = factory
+        self.context = context
+        self.filepath = filepath
+        self.follow_links = follow_links
+        self.pinned = pinned
+
+    def __repr__(self):
+        return '<ResourceRecord(%s, url=%s)>' % (self.factory.__name__, self.context.url)
+
+    @classmethod
+    def from_resource(cls, resource):
+        return cls(type(resource), resource.context, resource.__dict__.get('filepath'),
+                   getattr(resource, 'follow_links', True), resource.pinned)
+
+    def create(self, session, config, scheduler):
+        """Returns the resource again, with its pinned or resolved path if
+        it had one."""
+        resource = self.factory(session, config, scheduler, self.context)
+        if self.pinned is not None:
+            resource.pinned = self.pinned
+        elif self.filepath is not None:
+            resource.__dict__['filepath'] = self.filepath
+        if not self.follow_links:
+            resource.follow_links = False
+        return resource
 
 
 class Base64Resource(GenericResource):
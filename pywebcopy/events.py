@@ -0,0 +1,270 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Structured trace events for the per-resource hot paths.
+
+The crawler emits an event for every resource it schedules, fetches, parses
+and writes. Instead of building a log string each time, an event is stored
+as ``(event id, timestamp, args)`` and only formatted when a sink consumes
+it or a logger takes it.
+
+The events of the library stand for log calls users rely on and are sent
+with :func:`log`, which logs them to the logger given when it is enabled
+for their level, whether or not anything consumes the events, and costs a
+level check otherwise::
+
+    events.log(self.logger, events.SCHEDULER_WRITTEN, url, filepath)
+
+:func:`emit` only feeds the consumers, its call sites guard on the module
+flag so a disabled layer costs a single global lookup and branch::
+
+    if events.enabled:
+        events.emit(events.SCHEDULER_GET, resource.url)
+
+Consumers:
+    record()         keeps the last `capacity` events of every thread in a
+                     ring buffer, read back with :func:`records`.
+    add_sink(sink)   calls `sink(event, record, logger)` for every event,
+                     e.g. the :class:`LoggingSink` which forwards to
+                     :mod:`logging`; `logger` is the one :func:`log`
+                     logged the event to, None for :func:`emit`.
+
+Nothing is consumed by default, :func:`enable_logging` (done in debug mode)
+routes the emitted events to the `pywebcopy` loggers as well.
+
+Noisy events can be sampled, only every n-th emission per thread is kept::
+
+    events.set_sample(events.CSS_CHILD, 100)
+"""
+import logging
+import threading
+import time
+from collections import deque
+
+__all__ = [
+    'Event', 'define', 'emit', 'log', 'enabled', 'ALWAYS_LOGGED', 'record', 'stop_recording',
+    'records', 'add_sink', 'remove_sink', 'LoggingSink', 'enable_logging',
+    'set_sample', 'clear',
+]
+
+logger = logging.getLogger(__name__)
+
+#: True when at least one consumer is attached; checked by every call site.
+enabled = False
+
+#: level of the events users watch by default, kept for the consumers
+#: filtering on it; :func:`log` logs the events of every level.
+ALWAYS_LOGGED = logging.INFO
+
+_lock = threading.Lock()
+_registry = []
+_by_name = {}
+_sinks = []
+_recording = False
+_capacity = 4096
+_generation = 0
+_local = threading.local()
+_buffers = []  # (thread name, ring buffer) of every thread that emitted
+_loggers = {}
+
+
+class Event(object):
+    """Static description of an event; only its integer id travels with
+    the recorded arguments."""
+    __slots__ = ('id', 'name', 'fmt', 'level', 'logger', 'sample')
+
+    def __init__(self, id, name, fmt, level, logger, sample):
+        self.id = id
+        self.name = name
+        self.fmt = fmt
+        self.level = level
+        self.logger = logger
+        self.sample = sample
+
+    def __repr__(self):
+        return '<Event(%d, %s)>' % (self.id, self.name)
+
+    def format(self, args):
+        return self.fmt % args if args else self.fmt
+
+
+def define(name, fmt, level=logging.DEBUG, logger='pywebcopy', sample=1):
+    """Registers a new event type and returns it."""
+    with _lock:
+        if name in _by_name:
+            raise ValueError("Event %r is already defined." % name)
+        ev = Event(len(_registry), name, fmt, level, logger, sample)
+        _registry.append(ev)
+        _by_name[name] = ev
+    return ev
+
+
+def _update():
+    global enabled
+    enabled = _recording or bool(_sinks)
+
+
+def _thread_state():
+    state = getattr(_local, 'state', None)
+    if state is None or state[2] != _generation:
+        state = _local.state = (deque(maxlen=_capacity), {}, _generation)
+        with _lock:
+            _buffers.append((threading.current_thread().name, state[0]))
+    return state
+
+
+def _logger(name):
+    lg = _loggers.get(name)
+    if lg is None:
+        lg = _loggers[name] = logging.getLogger(name)
+    return lg
+
+
+def emit(event, *args):
+    """Records an event occurrence; `args` are kept unformatted."""
+    _emit(event, args, None)
+
+
+def log(lg, event, *args):
+    """Emits `event` on behalf of the logger `lg` (None for the one named
+    by the event) and logs it to that logger if it is enabled for the
+    level of the event, consumers or not; the message is formatted by
+    logging only then."""
+    if lg is None:
+        lg = _logger(event.logger)
+    if lg.isEnabledFor(event.level):
+        lg.log(event.level, event.fmt, *args)
+    if enabled:
+        _emit(event, args, lg)
+
+
+def _emit(event, args, lg):
+    buf, counts, _ = _thread_state()
+    if event.sample > 1:
+        n = counts.get(event.id, 0) + 1
+        counts[event.id] = n
+        if n % event.sample != 1:
+            return
+    rec = (event.id, time.time(), args)
+    if _recording:
+        buf.append(rec)
+    for sink in _sinks:
+        sink(event, rec, lg)
+
+
+def set_sample(event, every):
+    """Keeps only every `every`-th occurrence of `event` (per thread)."""
+    if isinstance(event, str):
+        event = _by_name[event]
+    event.sample = max(1, int(every))
+
+
+def record(capacity=4096):
+    """Starts keeping the last `capacity` events of each thread."""
+    global _recording, _capacity, _generation
+    with _lock:
+        if capacity != _capacity:
+            # threads pick up new buffers on their next event
+            _capacity = capacity
+            _generation += 1
+            del _buffers[:]
+        _recording = True
+        _update()
+
+
+def stop_recording():
+    global _recording
+    _recording = False
+    _update()
+
+
+def clear():
+    """Drops the recorded events of all threads."""
+    with _lock:
+        for _, buf in _buffers:
+            buf.clear()
+
+
+def records(formatted=True):
+    """Returns the recorded events of all threads ordered by time as
+    ``(timestamp, thread name, event, message or args)`` tuples."""
+    with _lock:
+        snapshot = [(name, list(buf)) for name, buf in _buffers]
+    out = []
+    for name, recs in snapshot:
+        for event_id, ts, args in recs:
+            ev = _registry[event_id]
+            out.append((ts, name, ev, ev.format(args) if formatted else args))
+    out.sort(key=lambda r: r[0])
+    return out
+
+
+def add_sink(sink):
+    with _lock:
+        if sink not in _sinks:
+            _sinks.append(sink)
+    _update()
+    return sink
+
+
+def remove_sink(sink):
+    with _lock:
+        if sink in _sinks:
+            _sinks.remove(sink)
+    _update()
+
+
+class LoggingSink(object):
+    """Forwards the events sent by :func:`emit` to the logger named by the
+    event, formatting is left to logging which skips disabled levels; the
+    ones sent by :func:`log` are logged already."""
+
+    def __call__(self, event, rec, lg):
+        if lg is not None:
+            return
+        lg = _logger(event.logger)
+        if lg.isEnabledFor(event.level):
+            lg.log(event.level, event.fmt, *rec[2])
+
+    def __eq__(self, other):
+        return isinstance(other, LoggingSink)
+
+    __hash__ = object.__hash__
+
+
+def enable_logging():
+    """Routes the emitted events to :mod:`logging`, used in debug mode."""
+    return add_sink(LoggingSink())
+
+
+# ---------------------------------------------------------------------------
+# Events emitted by the library.
+
+_S = 'pywebcopy.schedulers'
+_E = 'pywebcopy.elements'
+_U = 'pywebcopy.urls'
+
+SCHEDULER_CACHED = define(
+    'scheduler.cached', "[Cache] Resource Key: [%s] is available in the cache with value: [%s]", logger=_S)
+SCHEDULER_PROCESS = define('scheduler.process', "Processing valid resource: %r", logger=_S)
+SCHEDULER_GET = define('scheduler.get', "Scheduler trying to get resource at: [%s]", logger=_S)
+SCHEDULER_RETRIEVE = define('scheduler.retrieve', "Scheduler running handler for: [%s]", logger=_S)
+SCHEDULER_WRITTEN = define(
+    'scheduler.written', "Written the file from <%s> to <%s>", logging.INFO, logger=_S)
+
+RESOURCE_NOT_OK = define('resource.not_ok', "Resource at [%s] is NOT ok and will be NOT processed.", logger=_E)
+RESOURCE_OK = define('resource.ok', "Resource at [%s] is ok and will be processed.", logger=_E)
+RESOURCE_DONE = define('resource.done', "Finished processing resource [%s]", logger=_E)
+RESOURCE_WRONG_TYPE = define(
+    'resource.wrong_type', "Resource of type [%s] is not %s.", logging.INFO, logger=_E)
+CSS_CHILD = define('css.child', "Sub-%s resource found: [%s]", logger=_E)
+CSS_CONTEXT = define('css.context', "Creating context for url: %s as %s", logger=_E)
+CSS_SUBMIT = define('css.submit', "Submitting resource: [%s] to the scheduler.", logger=_E)
+CSS_REENCODED = define('css.reencoded', "Re-encoded the resource: [%s] as [%r]", logger=_E)
+
+FILE_DIRS_EXIST = define('file.dirs_exist', "[FILE] Sub-directories exists for: <%r>", logger=_U)
+FILE_DIRS_CREATED = define('file.dirs_created', "[File] Sub-directories created for: <%r>", logger=_U)
+FILE_EXISTS = define('file.exists', "[FILE] <%s> already exists at: <%s>", logger=_U)
+FILE_PREPARE = define(
+    'file.prepare', "[File] Preparing to write file from <%r> to the disk at <%r>.", logger=_U)
+FILE_WRITTEN = define('file.written', "[File] Written the file from <%s> to <%s>", logging.INFO, logger=_U)
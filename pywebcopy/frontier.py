@@ -0,0 +1,275 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Importance ordered crawling under a budget.
+
+The default schedulers fetch a page as soon as it is discovered, which is
+a depth first walk in discovery order. When a crawl is limited to a number
+of pages, bytes or seconds it should rather spend the budget on the most
+linked pages first.
+
+:class:`OPIC` is an online page importance estimator (Abiteboul et al.,
+"Adaptive On-Line Page Importance Computation"). Every page holds some
+cash; when a page is crawled its cash is added to its history and split
+equally between the pages it links to. Pages which many crawled pages link
+to accumulate cash before they are fetched, so always crawling the page
+with the most cash visits the important pages early, with no graph kept
+and O(log n) work per link.
+
+:class:`FrontierScheduler` keeps the discovered html pages in such a
+priority frontier instead of fetching them right away, page assets are
+still fetched immediately::
+
+    scheduler = frontier_crawler_scheduler(max_pages=500)
+    crawler = Crawler(session, config, scheduler, context)
+    crawler.get(url)
+    crawler.save_complete()
+    print(scheduler.stats)
+"""
+import heapq
+import logging
+import os
+import threading
+import time
+
+from .elements import HTMLResource
+from .elements import ResourceRecord
+from .schedulers import Scheduler
+from .schedulers import crawler_scheduler
+
+__all__ = ['OPIC', 'Budget', 'FrontierScheduler', 'frontier_crawler_scheduler', 'ORDERS']
+
+logger = logging.getLogger(__name__)
+
+#: opic - most cash first; fifo - discovery order (breadth first)
+ORDERS = ('opic', 'fifo')
+
+
+class OPIC(object):
+    """Cash distribution importance estimator with a priority queue of the
+    pages which are not crawled yet.
+
+    The heap holds `(-cash, sequence, url)` entries; an entry is pushed
+    again whenever the cash of a pending page grows and stale entries are
+    skipped on pop.
+    """
+
+    def __init__(self, order='opic'):
+        if order not in ORDERS:
+            raise ValueError("Order must be one of %r, got %r" % (ORDERS, order))
+        self.order = order
+        self.cash = {}
+        self.history = {}
+        self.heap = []
+        self.seq = 0
+        self.pending = set()
+
+    def __len__(self):
+        return len(self.pending)
+
+    def __contains__(self, url):
+        return url in self.pending
+
+    def _push(self, url, first):
+        self.seq += 1
+        if self.order == 'opic':
+            heapq.heappush(self.heap, (-self.cash[url], self.seq, url))
+        elif first:
+            heapq.heappush(self.heap, (0, self.seq, url))
+
+    def add(self, url, cash=1.0):
+        """Adds a page to the frontier, seeds start with some cash."""
+        if url in self.history:
+            return False
+        new = url not in self.pending
+        self.cash[url] = self.cash.get(url, 0.0) + cash
+        self.pending.add(url)
+        self._push(url, new)
+        return new
+
+    def distribute(self, url, links):
+        """Marks `url` as crawled and splits its cash between `links`."""
+        cash = self.cash.pop(url, 0.0)
+        self.history[url] = self.history.get(url, 0.0) + cash
+        self.pending.discard(url)
+        # keep the discovery order, it breaks ties between equal cash
+        links = dict.fromkeys(links)
+        links.pop(url, None)
+        if not links:
+            return
+        share = cash / len(links)
+        for link in links:
+            if link in self.history:
+                # crawled pages keep collecting importance
+                self.history[link] += share
+            else:
+                self.add(link, share)
+
+    def pop(self):
+        """Returns the pending url with the most cash or None."""
+        while self.heap:
+            neg, _, url = heapq.heappop(self.heap)
+            if url not in self.pending:
+                continue
+            if self.order == 'opic' and -neg != self.cash[url]:
+                continue  # superseded by a later push
+            self.pending.discard(url)
+            return url
+        return None
+
+    def importance(self, url):
+        return self.history.get(url, 0.0) + self.cash.get(url, 0.0)
+
+
+class Budget(object):
+    """Limits of a crawl, None means unlimited."""
+
+    def __init__(self, pages=None, bytes=None, seconds=None):
+        self.pages = pages
+        self.bytes = bytes
+        self.seconds = seconds
+
+    def exhausted(self, pages, nbytes, seconds):
+        return ((self.pages is not None and pages >= self.pages) or
+                (self.bytes is not None and nbytes >= self.bytes) or
+                (self.seconds is not None and seconds >= self.seconds))
+
+
+class FrontierScheduler(Scheduler):
+    """Synchronous scheduler fetching html pages in importance order until
+    the budget is spent.
+
+    A deferred page is linked to before it is fetched, so its path is
+    pinned to the one of an html page when it is discovered (see
+    :meth:`GenericResource.pin_path`); a page which turns out not to be
+    html is written at its own path behind a redirect. Deferred pages are
+    kept as :class:`ResourceRecord` which reference the session and config
+    of the crawl once per scheduler instead of once per page.
+
+    :param order: one of :data:`ORDERS`.
+    :param max_pages: html pages to fetch.
+    :param max_bytes: bytes written to disk, pages and assets.
+    :param max_seconds: wall time of the crawl.
+    """
+
+    def __init__(self, order='opic', max_pages=None, max_bytes=None, max_seconds=None, *args, **kwargs):
+        super(FrontierScheduler, self).__init__(*args, **kwargs)
+        self.frontier = OPIC(order)
+        self.budget = Budget(max_pages, max_bytes, max_seconds)
+        self.deferred = {}
+        self.session = None
+        self.config = None
+        self.stats = {'pages': 0, 'assets': 0, 'bytes': 0, 'seconds': 0.0, 'skipped': 0}
+        #: assets of a stylesheet are processed on threads, see :meth:`handle_many`
+        self._stats_lock = threading.Lock()
+        self._links = None
+        self._started = None
+
+    def handle_resource(self, resource):
+        if self._links is None or not isinstance(resource, HTMLResource):
+            return super(FrontierScheduler, self).handle_resource(resource)
+        url = resource.context.url
+        if self.index.get_entry(url) is None:
+            resource.pin_path('text/html')
+        ret = super(FrontierScheduler, self).handle_resource(resource)
+        # cash also flows to pages which are already known, but not to
+        # the ones the scheduler refused
+        if url in self.deferred or url in self.frontier.history:
+            self._links.append(url)
+        return ret
+
+    def seed(self, resource, cash=1.0):
+        """Queues an html page found outside of the crawled pages, e.g. in
+        a sitemap, with some initial cash. Returns False for known or
+        invalid pages."""
+        url = resource.context.url
+        if self.index.get_entry(url) is not None:
+            return False
+        resource.pin_path('text/html')
+        # a refused page is not indexed, a link may still bring it in later
+        if not self.validate_resource(resource):
+            return False
+        if self.index.claim(url, resource.filepath) is not None:
+            return False
+        self._defer(resource)
+        self.frontier.add(url, cash)
+        return True
+
+    def _defer(self, resource):
+        if self.session is None:
+            self.session, self.config = resource.session, resource.config
+        self.deferred[resource.context.url] = ResourceRecord.from_resource(resource)
+
+    def _handle_resource(self, resource):
+        if not isinstance(resource, HTMLResource):
+            return self._process(resource)
+        url = resource.context.url
+        self._defer(resource)
+        self.frontier.add(url, 0.0 if self._started is not None else 1.0)
+        if self._started is None:
+            self._drain()
+
+    def _drain(self):
+        self._started = time.time()
+        stats = self.stats
+        try:
+            while True:
+                elapsed = time.time() - self._started
+                if self.budget.exhausted(stats['pages'], stats['bytes'], elapsed):
+                    break
+                url = self.frontier.pop()
+                if url is None:
+                    break
+                resource = self.deferred.pop(url).create(self.session, self.config, self)
+                self._links = []
+                try:
+                    # dead links and server errors spend no page of the budget
+                    if self._process(resource):
+                        stats['pages'] += 1
+                finally:
+                    links, self._links = self._links, None
+                    self.frontier.distribute(url, links)
+        finally:
+            stats['seconds'] = time.time() - self._started
+            stats['skipped'] = len(self.frontier)
+            self._started = None
+        if stats['skipped']:
+            logger.info("Crawl budget spent, %d pages left in the frontier.", stats['skipped'])
+
+    def _process(self, resource):
+        """Fetches and retrieves `resource`, returns True if the server
+        answered it with a success."""
+        ok = False
+        try:
+            resource.get(resource.context.url)
+            self.index.add_resource(resource)
+        except Exception as e:
+            self.logger.error(
+                "Scheduler failed to retrieve resource from [%s]: %r", resource.context.url, e)
+        else:
+            ok = resource.response is not None and resource.response.ok
+            resource.retrieve()
+            try:
+                size = os.path.getsize(resource.filepath)
+            except (OSError, TypeError):
+                size = 0
+            with self._stats_lock:
+                if not isinstance(resource, HTMLResource):
+                    self.stats['assets'] += 1
+                self.stats['bytes'] += size
+        self.index.add_resource(resource)
+        return ok
+
+    def skipped(self):
+        """Returns the urls left in the frontier when the budget ran out,
+        most important first."""
+        return sorted(self.frontier.pending, key=self.frontier.importance, reverse=True)
+
+
+def frontier_crawler_scheduler(order='opic', max_pages=None, max_bytes=None, max_seconds=None):
+    ans = FrontierScheduler(order, max_pages, max_bytes, max_seconds)
+    fac = crawler_scheduler()
+    ans.default = fac.default
+    ans.data = fac.data
+    del fac
+    return ans
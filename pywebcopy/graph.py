@@ -0,0 +1,331 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Compact capture of the page -> resource link graph of a crawl.
+
+Nodes are identified by a stable 64-bit fingerprint of their url, edges are
+kept in three flat arrays (source fingerprint, target fingerprint, kind),
+about 17 bytes per edge plus one url string per node::
+
+    graph = LinkGraph()
+    scheduler.graph = graph
+    ...
+    graph.export('site.graph')
+
+    g = CSRGraph.load('site.graph')          # mmap, no parsing
+    page = g.node('https://example.com/')
+    for target, kind in g.edges(page):
+        print(g.url(target), KIND_NAMES[kind])
+
+Binary format (little endian, every section 8 byte aligned)::
+
+    header     magic b'PWCGRAPH', u32 version, u32 reserved,
+               u64 nodes, u64 edges, u64 offset of each section below
+    indptr     u64[nodes + 1]  edges of node i are indptr[i]:indptr[i + 1]
+    indices    u32[edges]      target node of every edge
+    kinds      u8[edges]       edge kind (LINK, STYLESHEET, SCRIPT, ...)
+    fps        u64[nodes]      url fingerprints, sorted; node id == rank
+    stroff     u64[nodes + 1]  offsets of the urls in strdata
+    strdata    utf-8 urls in node id order
+
+Since node ids are the ranks of the sorted fingerprints, a url is looked up
+by hashing it and bisecting `fps`; loading maps the file and casts the
+sections, so it costs the same for a hundred or a hundred million edges.
+"""
+import hashlib
+import logging
+import mmap
+import struct
+import sys
+import threading
+from array import array
+from bisect import bisect_left
+
+try:
+    import numpy
+except ImportError:  # the export falls back to python loops
+    numpy = None
+
+__all__ = [
+    'LinkGraph', 'CSRGraph', 'url_fingerprint', 'edge_kind',
+    'LINK', 'STYLESHEET', 'SCRIPT', 'IMAGE', 'OTHER', 'KIND_NAMES',
+]
+
+logger = logging.getLogger(__name__)
+
+LINK = 0
+STYLESHEET = 1
+SCRIPT = 2
+IMAGE = 3
+OTHER = 4
+KIND_NAMES = ('link', 'stylesheet', 'script', 'image', 'other')
+
+MAGIC = b'PWCGRAPH'
+VERSION = 1
+_header = struct.Struct('<8sIIQQ6Q')
+
+_link_tags = frozenset(['a', 'area', 'form', 'frame', 'iframe'])
+_image_tags = frozenset(['img', 'image', 'picture', 'source', 'input', 'svg', 'use'])
+
+
+def url_fingerprint(url):
+    """Stable 64-bit fingerprint of the url without its fragment."""
+    url = url.partition('#')[0]
+    digest = hashlib.blake2b(url.encode('utf-8', 'surrogatepass'), digest_size=8).digest()
+    return int.from_bytes(digest, 'little')
+
+
+def edge_kind(elem, attr):
+    """Kind of the edge from a page to the url found in `attr` of `elem`."""
+    tag = elem.tag
+    if not isinstance(tag, str):
+        return OTHER
+    if attr == 'style' or tag == 'style':
+        return IMAGE
+    if tag in _link_tags:
+        return LINK
+    if tag == 'script':
+        return SCRIPT
+    if tag in _image_tags:
+        return IMAGE
+    if tag == 'link':
+        rel = (elem.get('rel') or '').lower()
+        if 'stylesheet' in rel:
+            return STYLESHEET
+        if 'icon' in rel:
+            return IMAGE
+        return LINK
+    return OTHER
+
+
+class LinkGraph(object):
+    """Thread safe, append only edge list recorded during a crawl
+    (see :attr:`SchedulerBase.graph`)."""
+
+    def __init__(self):
+        self.sources = array('Q')
+        self.targets = array('Q')
+        self.kinds = array('B')
+        #: fingerprint -> url of every node
+        self.urls = {}
+        self.lock = threading.Lock()
+
+    def __repr__(self):
+        return '<LinkGraph(%d nodes, %d edges)>' % (len(self.urls), len(self.kinds))
+
+    def __len__(self):
+        return len(self.kinds)
+
+    def add(self, source, target, kind):
+        self.add_edges(source, [(target, kind)])
+
+    def add_edges(self, source, edges):
+        """Records the `(target url, kind)` edges of the `source` url,
+        repeated edges of one call are stored once."""
+        urls = self.urls
+        src = url_fingerprint(source)
+        seen = set()
+        targets, kinds = array('Q'), array('B')
+        new = {src: source.partition('#')[0]}
+        for url, kind in edges:
+            dst = url_fingerprint(url)
+            if (dst, kind) in seen:
+                continue
+            seen.add((dst, kind))
+            targets.append(dst)
+            kinds.append(kind)
+            if dst not in urls:
+                new[dst] = url.partition('#')[0]
+        with self.lock:
+            for fp, url in new.items():
+                urls.setdefault(fp, url)
+            self.sources.extend(array('Q', [src]) * len(targets))
+            self.targets.extend(targets)
+            self.kinds.extend(kinds)
+
+    def export(self, path, chunk=1 << 20):
+        """Writes the graph in the CSR format described in the module docs
+        and returns `(nodes, edges)`.
+
+        The file is sized up front and filled through a memory map. With
+        numpy installed the edges are ranked and scattered into it `chunk`
+        at a time by vectorised calls, otherwise by python loops."""
+        with self.lock:
+            urls = dict(self.urls)
+            sources, targets, kinds = array('Q', self.sources), array('Q', self.targets), array('B', self.kinds)
+
+        fps = array('Q', sorted(urls))
+        n, m = len(fps), len(kinds)
+        strings = [urls[fp].encode('utf-8', 'surrogatepass') for fp in fps]
+        del urls
+        stroff = array('Q', [0])
+        for s in strings:
+            stroff.append(stroff[-1] + len(s))
+        strdata = b''.join(strings)
+        del strings
+
+        offsets = []
+        pos = _header.size
+        for size in (8 * (n + 1), 4 * m, m, 8 * n, 8 * (n + 1), len(strdata)):
+            offsets.append(pos)
+            pos += _padded(size)
+
+        with open(path, 'w+b') as fh:
+            fh.truncate(pos)
+            mm = mmap.mmap(fh.fileno(), pos)
+        try:
+            _header.pack_into(mm, 0, MAGIC, VERSION, 0, n, m, *offsets)
+            mm[offsets[5]:offsets[5] + len(strdata)] = strdata
+            if numpy is not None:
+                _fill_sections(mm, offsets, fps, stroff, sources, targets, kinds, chunk)
+            else:
+                sections = _csr(fps, sources, targets, kinds) + (fps, stroff)
+                for offset, section in zip(offsets, sections):
+                    if sys.byteorder != 'little':
+                        section.byteswap()
+                    mm[offset:offset + _nbytes(section)] = section.tobytes()
+            mm.flush()
+        finally:
+            mm.close()
+        return n, m
+
+
+def _csr(fps, sources, targets, kinds):
+    """Returns `(indptr, indices, kinds)` by a counting sort of the edges
+    by source node."""
+    rank = {fp: i for i, fp in enumerate(fps)}
+    n, m = len(fps), len(kinds)
+    indptr = array('Q', bytes(8 * (n + 1)))
+    for fp in sources:
+        indptr[rank[fp] + 1] += 1
+    for i in range(n):
+        indptr[i + 1] += indptr[i]
+    fill = array('Q', indptr)
+    indices = array('I', bytes(4 * m))
+    out_kinds = array('B', bytes(m))
+    for e, fp in enumerate(sources):
+        r = rank[fp]
+        p = fill[r]
+        fill[r] = p + 1
+        indices[p] = rank[targets[e]]
+        out_kinds[p] = kinds[e]
+    return indptr, indices, out_kinds
+
+
+def _fill_sections(mm, offsets, fps, stroff, sources, targets, kinds, chunk):
+    """Writes the sections but strdata into `mm` with numpy; node ids are
+    found by bisecting the sorted fingerprints and every chunk of edges is
+    stably sorted by source and scattered behind the edges placed so far,
+    which keeps the edges of a node in the order they were recorded."""
+    np = numpy
+    a, b, c, d, e, _ = offsets
+    n, m = len(fps), len(kinds)
+    keys = np.frombuffer(fps, dtype=np.uint64, count=n)
+    src = np.frombuffer(sources, dtype=np.uint64, count=m)
+    dst = np.frombuffer(targets, dtype=np.uint64, count=m)
+    knd = np.frombuffer(kinds, dtype=np.uint8, count=m)
+    np.frombuffer(mm, '<u8', n, d)[:] = keys
+    np.frombuffer(mm, '<u8', n + 1, e)[:] = np.frombuffer(stroff, dtype=np.uint64, count=n + 1)
+    indptr = np.frombuffer(mm, '<u8', n + 1, a)
+    indices = np.frombuffer(mm, '<u4', m, b)
+    out_kinds = np.frombuffer(mm, np.uint8, m, c)
+
+    counts = np.zeros(n, dtype=np.int64)
+    for lo in range(0, m, chunk):
+        counts += np.bincount(np.searchsorted(keys, src[lo:lo + chunk]), minlength=n)
+    indptr[0] = 0
+    indptr[1:] = np.cumsum(counts)
+    fill = indptr[:-1].astype(np.int64)
+    for lo in range(0, m, chunk):
+        rows = np.searchsorted(keys, src[lo:lo + chunk])
+        order = np.argsort(rows, kind='stable')
+        rows = rows[order]
+        starts = np.flatnonzero(np.concatenate(([True], rows[1:] != rows[:-1])))
+        sizes = np.diff(np.append(starts, len(rows)))
+        pos = fill[rows] + np.arange(len(rows)) - np.repeat(starts, sizes)
+        indices[pos] = np.searchsorted(keys, dst[lo:lo + chunk][order])
+        out_kinds[pos] = knd[lo:lo + chunk][order]
+        fill[rows[starts]] += sizes
+
+
+def _nbytes(section):
+    return len(section) if isinstance(section, bytes) else len(section) * section.itemsize
+
+
+def _padded(size):
+    return (size + 7) & ~7
+
+
+class CSRGraph(object):
+    """Read only view of an exported graph, the sections are memoryviews
+    over a memory map of the file."""
+
+    def __init__(self, buf, close=None):
+        if sys.byteorder != 'little':
+            raise ValueError("CSRGraph can only map graphs on little endian hosts.")
+        view = memoryview(buf)
+        if len(view) < _header.size:
+            raise ValueError("Not a link graph file, too short.")
+        magic, version, _, n, m, *offsets = _header.unpack_from(view)
+        if magic != MAGIC:
+            raise ValueError("Not a link graph file, bad magic %r." % magic)
+        if version != VERSION:
+            raise ValueError("Unsupported link graph version %d." % version)
+        a, b, c, d, e, f = offsets
+        self.nodes = n
+        self.num_edges = m
+        self.indptr = view[a:a + 8 * (n + 1)].cast('Q')
+        self.indices = view[b:b + 4 * m].cast('I')
+        self.kinds = view[c:c + m]
+        self.fps = view[d:d + 8 * n].cast('Q')
+        self.stroff = view[e:e + 8 * (n + 1)].cast('Q')
+        self.strdata = view[f:f + self.stroff[n]] if n else view[f:f]
+        self._view = view
+        self._close = close
+
+    @classmethod
+    def load(cls, path):
+        with open(path, 'rb') as fh:
+            mm = mmap.mmap(fh.fileno(), 0, access=mmap.ACCESS_READ)
+        return cls(mm, mm.close)
+
+    def close(self):
+        for name in ('indptr', 'indices', 'kinds', 'fps', 'stroff', 'strdata', '_view'):
+            getattr(self, name).release()
+        if self._close is not None:
+            self._close()
+            self._close = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __len__(self):
+        return self.nodes
+
+    def __repr__(self):
+        return '<CSRGraph(%d nodes, %d edges)>' % (self.nodes, self.num_edges)
+
+    def url(self, node):
+        return bytes(self.strdata[self.stroff[node]:self.stroff[node + 1]]).decode('utf-8', 'surrogatepass')
+
+    def node(self, url):
+        """Returns the node id of the url or None."""
+        fp = url_fingerprint(url)
+        i = bisect_left(self.fps, fp)
+        if i < self.nodes and self.fps[i] == fp:
+            return i
+        return None
+
+    def out_degree(self, node):
+        return self.indptr[node + 1] - self.indptr[node]
+
+    def successors(self, node):
+        return self.indices[self.indptr[node]:self.indptr[node + 1]]
+
+    def edges(self, node):
+        """Returns `(target node, kind)` pairs of the node."""
+        lo, hi = self.indptr[node], self.indptr[node + 1]
+        return list(zip(self.indices[lo:hi], self.kinds[lo:hi]))
@@ -0,0 +1,310 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Hedged requests against the tail latency of asset fetches.
+
+One stuck connection to a cdn edge holds a page capture for seconds while
+the same file comes back in milliseconds on any other connection. With a
+:class:`Hedger` as the `hedge` plug-in of the
+:class:`pywebcopy.session.Session`:
+
+* the time to the headers of every streamed request is recorded per host
+  and the 95th percentile of the recent ones is kept;
+* a GET or HEAD which has no headers by then is sent a second time; it
+  goes out on another connection of the pool as the first one still holds
+  its own;
+* the first response wins and the connection of the other request is
+  shut down at once, or its response closed as soon as it arrives; only
+  the time of the winner is recorded;
+* every request adds `ratio` of a token to a bucket and every hedge takes
+  a whole one, so the extra requests stay within `ratio` of the traffic
+  (plus a `burst` of at most that many tokens).
+
+The requests are sent from a thread pool so that the calling thread can
+stop waiting for the first one; a request the hedger does not consider
+(other methods, bodies read at once, hosts with too few samples) is sent
+from the calling thread as usual, and so are the redirects followed by a
+request of the pool, which is only ever hedged as a whole.
+
+The connections are known to the hedger only for the adapters of the
+session when hedging was enabled (see :meth:`Hedger.attach`), the losers
+of other adapters are closed once their response arrives.
+
+Usage::
+
+    session = Session()
+    session.enable_hedging(ratio=0.05)
+    ...
+    print(session.hedge.stats)
+"""
+import bisect
+import logging
+import socket
+import threading
+import time
+from collections import deque
+from concurrent.futures import FIRST_COMPLETED
+from concurrent.futures import ThreadPoolExecutor
+from concurrent.futures import wait
+
+from six.moves.urllib.parse import urlsplit
+
+__all__ = ['Hedger', 'HostLatency', 'TokenBucket', 'IDEMPOTENT_METHODS']
+
+logger = logging.getLogger(__name__)
+
+#: methods which may be sent twice without changing anything on the server.
+IDEMPOTENT_METHODS = frozenset(['GET', 'HEAD'])
+
+# `attempt`: the :class:`_Attempt` a thread of the pool is sending
+_local = threading.local()
+
+
+class HostLatency(object):
+    """Times to the headers of the last `window` requests to one host.
+
+    :param window: samples kept.
+    :param percentile: the percentile returned by :meth:`threshold`.
+    """
+
+    def __init__(self, window=200, percentile=95):
+        self.percentile = percentile
+        self.samples = deque(maxlen=window)
+        self._sorted = []
+        self._lock = threading.Lock()
+
+    def __len__(self):
+        return len(self.samples)
+
+    def add(self, seconds):
+        with self._lock:
+            if len(self.samples) == self.samples.maxlen:
+                oldest = self.samples[0]
+                del self._sorted[bisect.bisect_left(self._sorted, oldest)]
+            self.samples.append(seconds)
+            bisect.insort(self._sorted, seconds)
+
+    def threshold(self):
+        """Returns the percentile of the samples, None without samples."""
+        with self._lock:
+            if not self._sorted:
+                return None
+            index = int(len(self._sorted) * self.percentile / 100.0)
+            return self._sorted[min(index, len(self._sorted) - 1)]
+
+
+class TokenBucket(object):
+    """Budget of the extra requests: :meth:`earn` adds `ratio` of a token,
+    up to `burst`, and :meth:`take` spends a whole one if there is one."""
+
+    def __init__(self, ratio=0.05, burst=10.0):
+        self.ratio = ratio
+        self.burst = burst
+        self.tokens = 0.0
+        self._lock = threading.Lock()
+
+    def earn(self):
+        with self._lock:
+            self.tokens = min(self.burst, self.tokens + self.ratio)
+
+    def take(self):
+        with self._lock:
+            if self.tokens < 1.0:
+                return False
+            self.tokens -= 1.0
+            return True
+
+
+class Hedger(object):
+    """Sends a second copy of the slow idempotent requests of a session,
+    see the module docs.
+
+    :param ratio: hedges allowed per request sent.
+    :param burst: hedges which may be saved up.
+    :param percentile: percentile of the time to the headers of a host
+        after which a request to it is hedged.
+    :param min_samples: requests to a host timed before any is hedged.
+    :param min_delay: no request is hedged sooner than this.
+    :param window: requests to a host the percentile is taken over.
+    :param workers: threads sending the requests.
+    """
+
+    def __init__(self, ratio=0.05, burst=10.0, percentile=95, min_samples=20, min_delay=0.0,
+                 window=200, workers=32):
+        if not 0 < percentile < 100:
+            raise ValueError("Percentile must be between 0 and 100, got %r" % percentile)
+        self.percentile = percentile
+        self.min_samples = min_samples
+        self.min_delay = min_delay
+        self.window = window
+        self.budget = TokenBucket(ratio, burst)
+        self.hosts = {}
+        self.stats = {'requests': 0, 'hedged': 0, 'won': 0, 'denied': 0, 'cancelled': 0}
+        self.executor = ThreadPoolExecutor(max_workers=workers, thread_name_prefix='pywebcopy-hedge')
+        self._lock = threading.Lock()
+
+    def __repr__(self):
+        return '<Hedger(ratio=%r, percentile=%r)>' % (self.budget.ratio, self.percentile)
+
+    def latency(self, host):
+        ans = self.hosts.get(host)
+        if ans is None:
+            with self._lock:
+                ans = self.hosts.setdefault(host, HostLatency(self.window, self.percentile))
+        return ans
+
+    def delay(self, host):
+        """Seconds after which a request to `host` is hedged, or None."""
+        latency = self.latency(host)
+        if len(latency) < self.min_samples:
+            return None
+        return max(self.min_delay, latency.threshold())
+
+    def attach(self, adapter):
+        """Makes the pools of a requests `adapter` tell the hedger which
+        connection each request is sent on, so that the one of a losing
+        request is shut down at once; returns the adapter."""
+        manager = getattr(adapter, 'poolmanager', None)
+        if manager is not None:
+            manager.pool_classes_by_scheme = dict(
+                (scheme, _tracked_pool_class(cls)) for scheme, cls in manager.pool_classes_by_scheme.items())
+            manager.clear()
+        return adapter
+
+    def _count(self, key):
+        with self._lock:
+            self.stats[key] += 1
+
+    @staticmethod
+    def _timed(send, attempt, request, kwargs):
+        """Returns the response and the time to it, from the pool."""
+        _local.attempt = attempt
+        try:
+            start = time.time()
+            response = send(request, **kwargs)
+            return response, time.time() - start
+        finally:
+            _local.attempt = None
+            attempt.use(None)
+
+    def send(self, send, request, **kwargs):
+        """Returns `send(request, **kwargs)`, hedged if it is slow."""
+        if getattr(_local, 'attempt', None) is not None:
+            # a redirect of a request of the pool, which never waits on
+            # the pool itself
+            return send(request, **kwargs)
+        host = urlsplit(request.url).netloc
+        latency = self.latency(host)
+        if request.method not in IDEMPOTENT_METHODS or not kwargs.get('stream'):
+            # the time of a body read at once is no time to the headers
+            return send(request, **kwargs)
+        self._count('requests')
+        self.budget.earn()
+        delay = self.delay(host)
+        if delay is None:
+            start = time.time()
+            response = send(request, **kwargs)
+            latency.add(time.time() - start)
+            return response
+
+        attempts = {}
+        first = self._submit(attempts, send, request, kwargs)
+        done, _ = wait([first], timeout=delay)
+        if not done and not self.budget.take():
+            self._count('denied')
+            done = [first]
+        if done:
+            response, seconds = first.result()
+            latency.add(seconds)
+            return response
+
+        self._count('hedged')
+        logger.debug("Hedging [%s] after %.3f seconds", request.url, delay)
+        second = self._submit(attempts, send, request.copy(), kwargs)
+        pending = {first, second}
+        while pending:
+            done, pending = wait(pending, return_when=FIRST_COMPLETED)
+            winner = next((f for f in done if f.exception() is None), None)
+            if winner is None:
+                continue
+            for loser in (first, second):
+                if loser is not winner:
+                    if attempts[loser].cancel():
+                        self._count('cancelled')
+                    loser.add_done_callback(_close)
+            if winner is second:
+                self._count('won')
+            response, seconds = winner.result()
+            latency.add(seconds)
+            return response
+        # both failed, the error of the original request
+        return first.result()
+
+    def _submit(self, attempts, send, request, kwargs):
+        attempt = _Attempt()
+        future = self.executor.submit(self._timed, send, attempt, request, kwargs)
+        attempts[future] = attempt
+        return future
+
+    def close(self, wait=True):
+        self.executor.shutdown(wait=wait)
+
+
+def _close(future):
+    """Closes the response of the losing request once it arrives."""
+    if future.exception() is None:
+        future.result()[0].close()
+
+
+class _Attempt(object):
+    """Connection which a request of the pool is being sent on."""
+    __slots__ = ('conn', '_lock')
+
+    def __init__(self):
+        self.conn = None
+        self._lock = threading.Lock()
+
+    def use(self, conn, only=None):
+        """Records `conn`, or with `only` forgets it if it is that one."""
+        with self._lock:
+            if only is None or self.conn is only:
+                self.conn = conn
+
+    def cancel(self):
+        """Shuts the connection down, the thread reading from it fails at
+        once; returns True if there was one."""
+        with self._lock:
+            sock = getattr(self.conn, 'sock', None)
+            self.conn = None
+            if sock is None:
+                return False
+            try:
+                sock.shutdown(socket.SHUT_RDWR)
+            except (OSError, IOError):
+                return False
+            return True
+
+
+class _TrackedPool(object):
+    """Mixin of the urllib3 pools recording the connection of the
+    :class:`_Attempt` of the thread."""
+
+    def _get_conn(self, timeout=None):
+        conn = super(_TrackedPool, self)._get_conn(timeout)
+        attempt = getattr(_local, 'attempt', None)
+        if attempt is not None:
+            attempt.use(conn)
+        return conn
+
+    def _put_conn(self, conn):
+        attempt = getattr(_local, 'attempt', None)
+        if attempt is not None:
+            # back in the pool, the next request may be someone else's
+            attempt.use(None, only=conn)
+        super(_TrackedPool, self)._put_conn(conn)
+
+
+def _tracked_pool_class(pool_cls):
+    if issubclass(pool_cls, _TrackedPool):
+        return pool_cls
+    return type('Tracked' + pool_cls.__name__, (_TrackedPool, pool_cls), {})
@@ -12,39 +12,48 @@ class RecentOrderedDict(MutableMapping):
     A custom variant of the OrderedDict that ensures that the object most
     recently inserted or retrieved from the dictionary is at the top of the
     dictionary enumeration.
+
+    Reads reorder the dictionary and are writes as well, so every access
+    holds a lock; iteration works on a snapshot of the keys. It is safe to
+    share between threads without relying on the GIL.
     """
 
     def __init__(self, *args, **kwargs):
         self._data = OrderedDict(*args, **kwargs)
+        self._lock = threading.Lock()
 
     def __setitem__(self, key, value):
-        if key in self._data:
-            del self._data[key]
-        self._data[key] = value
+        with self._lock:
+            self._data[key] = value
+            self._data.move_to_end(key)
 
     def __getitem__(self, key):
-        value = self._data[key]
-        del self._data[key]
-        self._data[key] = value
-        return value
+        with self._lock:
+            value = self._data[key]
+            self._data.move_to_end(key)
+            return value
 
     def __delitem__(self, key):
-        del self._data[key]
+        with self._lock:
+            del self._data[key]
 
     def __iter__(self):
-        return iter(self._data)
+        return iter(self.keys())
 
     def __len__(self):
         return len(self._data)
 
     def __contains__(self, value):
-        return self._data.__contains__(value)
+        with self._lock:
+            return self._data.__contains__(value)
 
     def items(self):
-        return self._data.items()
+        with self._lock:
+            return list(self._data.items())
 
     def keys(self):
-        return self._data.keys()
+        with self._lock:
+            return list(self._data.keys())
 
 
 class ConcurrentDelay(object):
@@ -126,12 +135,15 @@ def lru_cache(maxsize=255, timeout=None):
             #   In case of an instance method - the caller is the instance, in case called
             #   from a regular function - the caller is None.
             self._caches_dict = {}
+            # Guards the caches, the function itself is called without it so
+            # that threads can compute different keys in parallel.
+            self._lock = threading.Lock()
 
         def cache_clear(self, caller=None):
             # Remove the cache for the caller, only if exists:
-            if caller in self._caches_dict:
-                del self._caches_dict[caller]
-                self._caches_dict[caller] = [OrderedDict(), time.time()]
+            with self._lock:
+                if caller in self._caches_dict:
+                    self._caches_dict[caller] = [OrderedDict(), time.time()]
 
         def __get__(self, obj, obj_type):
             """ Called for instance methods """
@@ -154,31 +166,31 @@ def lru_cache(maxsize=255, timeout=None):
             key = "".join(map(lambda x: str(type(x)) + str(x), args)) + kwargs_key
 
             # Check if caller exists, if not create one:
-            if caller not in self._caches_dict:
-                self._caches_dict[caller] = [OrderedDict(), time.time()]
-            else:
+            with self._lock:
+                entry = self._caches_dict.get(caller)
                 # Validate in case the refresh time has passed:
-                if self._timeout is not None:
-                    if time.time() - self._caches_dict[caller][1] > self._timeout:
-                        self.cache_clear(caller)
-
-            # Check if the key exists, if so - return it:
-            cur_caller_cache_dict = self._caches_dict[caller][0]
-            if key in cur_caller_cache_dict:
-                return cur_caller_cache_dict[key]
+                if entry is None or (self._timeout is not None and
+                                     time.time() - entry[1] > self._timeout):
+                    entry = self._caches_dict[caller] = [OrderedDict(), time.time()]
 
-            # Validate we didn't exceed the max_size:
-            if len(cur_caller_cache_dict) >= self._max_size:
-                # Delete the first item in the dict:
-                cur_caller_cache_dict.popitem(False)
+                # Check if the key exists, if so - return it:
+                cur_caller_cache_dict = entry[0]
+                if key in cur_caller_cache_dict:
+                    return cur_caller_cache_dict[key]
 
             # Call the function and store the data in the cache (call it with
             # the caller in case it's an instance function - Ternary condition):
-            cur_caller_cache_dict[key] = self._input_func(
+            value = self._input_func(
                 caller, *args, **kwargs) if caller is not None else self._input_func(
                 *args, **kwargs
             )
-            return cur_caller_cache_dict[key]
+            with self._lock:
+                # Validate we didn't exceed the max_size:
+                if key not in cur_caller_cache_dict and len(cur_caller_cache_dict) >= self._max_size:
+                    # Delete the first item in the dict:
+                    cur_caller_cache_dict.popitem(False)
+                cur_caller_cache_dict[key] = value
+            return value
 
     # Return the decorator wrapping the class (also wraps the instance to
     # maintain the docstring and the name of the original function):
@@ -203,6 +215,10 @@ class cached_property(property):
 
     The class has to have a `__dict__` in order for this property to
     work.
+
+    No lock is taken: threads racing on the first access may both call
+    the function and the last result is kept, the functions must not have
+    side effects which break when run twice.
     """
 
     # implementation detail: A subclass of python's builtin property
@@ -0,0 +1,364 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Memory instrumentation for crawls.
+
+When enabled, every resource passes through a handful of named stages and
+each stage records how many bytes it allocated (tracemalloc peak above the
+stage entry) and how many it left behind (traced memory at exit minus
+entry). A background thread samples the process RSS so that the numbers
+can be compared against what the operating system actually sees.
+
+    from pywebcopy import memtrace
+    tracer = memtrace.enable()
+    crawler.save_complete()
+    memtrace.disable()
+    print(tracer.report())
+
+Stages:
+    fetch   - request sent until response headers are available.
+    buffer  - response body read into memory.
+    parse   - html/css/js parsing together with child link extraction.
+    rewrite - serialisation of the rewritten document.
+    write   - copying the final bytes onto the disk.
+
+Stages nest (an html page's `parse` stage contains the complete processing
+of every child with the synchronous scheduler). Seconds and retained bytes
+are reported exclusive of the nested stages while peaks are inclusive, i.e.
+the highest traced memory seen while the stage was running. With the threaded schedulers the tracemalloc peak is shared by all threads
+and per-stage figures overlap; the RSS samples are still exact.
+
+While disabled `stage()` returns a shared no-op context manager, thus the
+hooks cost a function call and an attribute check per stage.
+"""
+import logging
+import os
+import sys
+import threading
+import time
+import tracemalloc
+
+__all__ = ['STAGES', 'MemoryTracer', 'enable', 'disable', 'stage', 'current', 'read_rss']
+
+logger = logging.getLogger(__name__)
+
+# tracemalloc.reset_peak() is only available since python 3.9, before that
+# peaks are measured from the start of tracing.
+_reset_peak = getattr(tracemalloc, 'reset_peak', lambda: None)
+
+STAGES = ('fetch', 'buffer', 'parse', 'rewrite', 'write')
+
+
+def read_rss():
+    """Returns the resident set size of this process in bytes or 0
+    if it can't be determined on this platform."""
+    try:
+        import psutil
+    except ImportError:
+        psutil = None
+    if psutil is not None:
+        return psutil.Process().memory_info().rss
+    try:
+        with open('/proc/self/statm', 'rb') as fh:
+            return int(fh.read().split()[1]) * os.sysconf('SC_PAGE_SIZE')
+    except (IOError, OSError, ValueError, IndexError):
+        pass
+    try:
+        import resource
+    except ImportError:  # pragma: no cover
+        return 0
+    # ru_maxrss is a high-water mark; KiB on linux and bytes on mac.
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    return rss if sys.platform == 'darwin' else rss * 1024
+
+
+class StageStats(object):
+    """Aggregated numbers for a single (stage, kind) pair."""
+    __slots__ = ('calls', 'seconds', 'peak', 'max_peak', 'retained')
+
+    def __init__(self):
+        self.calls = 0
+        self.seconds = 0.0
+        self.peak = 0          # sum of peaks, used for the mean
+        self.max_peak = 0
+        self.retained = 0
+
+    def add(self, seconds, peak, retained):
+        self.calls += 1
+        self.seconds += seconds
+        self.peak += peak
+        if peak > self.max_peak:
+            self.max_peak = peak
+        self.retained += retained
+
+    def merge(self, other):
+        self.calls += other.calls
+        self.seconds += other.seconds
+        self.peak += other.peak
+        self.max_peak = max(self.max_peak, other.max_peak)
+        self.retained += other.retained
+
+    def as_dict(self):
+        return {
+            'calls': self.calls,
+            'seconds': self.seconds,
+            'mean_peak': self.peak // self.calls if self.calls else 0,
+            'max_peak': self.max_peak,
+            'retained': self.retained,
+        }
+
+
+class _Frame(object):
+    __slots__ = ('name', 'resource', 'start', 'peak', 'clock',
+                 'child_seconds', 'child_retained')
+
+    def __init__(self, name, resource, current):
+        self.name = name
+        self.resource = resource
+        self.start = current
+        self.peak = current
+        self.clock = time.perf_counter()
+        self.child_seconds = 0.0
+        self.child_retained = 0
+
+
+class _Stage(object):
+    """Context manager recording one stage on the tracer."""
+    __slots__ = ('tracer', 'name', 'resource')
+
+    def __init__(self, tracer, name, resource):
+        self.tracer = tracer
+        self.name = name
+        self.resource = resource
+
+    def __enter__(self):
+        self.tracer._enter(self.name, self.resource)
+        return self
+
+    def __exit__(self, *exc):
+        self.tracer._exit()
+        return False
+
+
+class _NullStage(object):
+    __slots__ = ()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        return False
+
+
+_null_stage = _NullStage()
+
+
+def resource_kind(resource):
+    """Content type of the resource if known else its class name."""
+    if resource is None:
+        return '-'
+    response = getattr(resource, 'response', None)
+    if response is not None:
+        ctype = getattr(resource, 'content_type', None)
+        if ctype:
+            return ctype
+    return resource.__class__.__name__
+
+
+class MemoryTracer(object):
+    """Collects per stage and per resource kind allocation numbers
+    and samples the RSS of the process.
+
+    :param interval: seconds between two RSS samples.
+    :param frames: traceback depth stored by tracemalloc.
+    """
+
+    def __init__(self, interval=0.05, frames=1):
+        self.interval = interval
+        self.frames = frames
+        self.stats = {}
+        self.samples = []
+        self.rss_start = 0
+        self.rss_peak = 0
+        self.started = None
+        self.stopped = None
+        self._local = threading.local()
+        self._lock = threading.Lock()
+        self._stop = threading.Event()
+        self._sampler = None
+        self._owns_tracemalloc = False
+
+    # -- lifecycle --
+
+    def start(self):
+        if not tracemalloc.is_tracing():
+            tracemalloc.start(self.frames)
+            self._owns_tracemalloc = True
+        self.rss_start = self.rss_peak = read_rss()
+        self.started = time.perf_counter()
+        self._stop.clear()
+        self._sampler = threading.Thread(
+            target=self._sample_loop, name='memtrace-rss', daemon=True)
+        self._sampler.start()
+        return self
+
+    def stop(self):
+        self._stop.set()
+        if self._sampler is not None:
+            self._sampler.join()
+            self._sampler = None
+        self._sample()
+        self.stopped = time.perf_counter()
+        if self._owns_tracemalloc:
+            tracemalloc.stop()
+            self._owns_tracemalloc = False
+        return self
+
+    def _sample(self):
+        rss = read_rss()
+        if rss > self.rss_peak:
+            self.rss_peak = rss
+        self.samples.append((time.perf_counter() - self.started, rss))
+
+    def _sample_loop(self):
+        while not self._stop.wait(self.interval):
+            self._sample()
+
+    # -- stages --
+
+    def stage(self, name, resource=None):
+        return _Stage(self, name, resource)
+
+    def _stack(self):
+        stack = getattr(self._local, 'stack', None)
+        if stack is None:
+            stack = self._local.stack = []
+        return stack
+
+    def _enter(self, name, resource):
+        stack = self._stack()
+        current, peak = tracemalloc.get_traced_memory()
+        if stack:
+            # close the running segment of the parent before resetting
+            parent = stack[-1]
+            if peak > parent.peak:
+                parent.peak = peak
+        _reset_peak()
+        stack.append(_Frame(name, resource, current))
+
+    def _exit(self):
+        stack = self._stack()
+        frame = stack.pop()
+        current, peak = tracemalloc.get_traced_memory()
+        peak = max(peak, frame.peak)
+        elapsed = time.perf_counter() - frame.clock
+        retained = current - frame.start
+        key = (frame.name, resource_kind(frame.resource))
+        with self._lock:
+            stats = self.stats.get(key)
+            if stats is None:
+                stats = self.stats[key] = StageStats()
+            stats.add(elapsed - frame.child_seconds, peak - frame.start,
+                      retained - frame.child_retained)
+        if stack:
+            parent = stack[-1]
+            if peak > parent.peak:
+                parent.peak = peak
+            parent.child_seconds += elapsed
+            parent.child_retained += retained
+        _reset_peak()
+
+    # -- reporting --
+
+    def by_stage(self):
+        ans = {}
+        for (name, kind), stats in self.stats.items():
+            ans.setdefault(name, StageStats()).merge(stats)
+        return ans
+
+    def by_kind(self):
+        ans = {}
+        for (name, kind), stats in self.stats.items():
+            ans.setdefault(kind, StageStats()).merge(stats)
+        return ans
+
+    def summary(self):
+        """Returns a json serialisable dict of all the collected numbers."""
+        traced, traced_peak = (tracemalloc.get_traced_memory()
+                               if tracemalloc.is_tracing() else (0, 0))
+        return {
+            'rss_start': self.rss_start,
+            'rss_peak': self.rss_peak,
+            'rss_samples': len(self.samples),
+            'traced': traced,
+            'stages': dict((k, v.as_dict()) for k, v in self.by_stage().items()),
+            'kinds': dict((k, v.as_dict()) for k, v in self.by_kind().items()),
+            'detail': [
+                dict(stage=name, kind=kind, **stats.as_dict())
+                for (name, kind), stats in sorted(self.stats.items())
+            ],
+        }
+
+    def report(self):
+        """Human readable table of the collected numbers."""
+        lines = ['RSS start=%s peak=%s (%d samples)' % (
+            format_bytes(self.rss_start), format_bytes(self.rss_peak), len(self.samples))]
+        fmt = '%-28s %7s %9s %11s %11s %11s'
+        for title, table in (('stage', self.by_stage()), ('kind', self.by_kind())):
+            lines.append('')
+            lines.append(fmt % (title, 'calls', 'seconds', 'mean peak', 'max peak', 'retained'))
+            order = STAGES if title == 'stage' else sorted(table)
+            for key in order:
+                s = table.get(key)
+                if s is None:
+                    continue
+                d = s.as_dict()
+                lines.append(fmt % (
+                    key[:28], d['calls'], '%.3f' % d['seconds'], format_bytes(d['mean_peak']),
+                    format_bytes(d['max_peak']), format_bytes(d['retained'])))
+        return '\n'.join(lines)
+
+
+def format_bytes(n):
+    n = float(n)
+    for unit in ('B', 'KiB', 'MiB'):
+        if abs(n) < 1024:
+            return '%.0f%s' % (n, unit) if unit == 'B' else '%.1f%s' % (n, unit)
+        n /= 1024
+    return '%.1fGiB' % n
+
+
+#: Tracer used by the library hooks, None while disabled.
+_tracer = None
+
+
+def enable(tracer=None, **kwargs):
+    """Starts tracing the library stages and returns the active tracer."""
+    global _tracer
+    if _tracer is not None:
+        return _tracer
+    _tracer = (tracer or MemoryTracer(**kwargs)).start()
+    logger.debug('Memory tracing enabled.')
+    return _tracer
+
+
+def disable():
+    """Stops tracing and returns the tracer which was active."""
+    global _tracer
+    tracer, _tracer = _tracer, None
+    if tracer is not None:
+        tracer.stop()
+        logger.debug('Memory tracing disabled.')
+    return tracer
+
+
+def current():
+    return _tracer
+
+
+def stage(name, resource=None):
+    """Context manager marking a stage for the resource."""
+    tracer = _tracer
+    if tracer is None:
+        return _null_stage
+    return tracer.stage(name, resource)
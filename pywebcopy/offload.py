@@ -0,0 +1,247 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Parsing and rewriting of html pages in worker interpreters.
+
+Parsing a page and serialising the rewritten tree is most of the cpu time
+of a crawl and holds the GIL. An :class:`Offloader` runs both in a process
+pool, or in a pool of subinterpreters, each with its own GIL, on Python
+3.14+ where lxml can be loaded in them. Only the scheduling of the
+children, which needs the shared index and session, stays in the crawling
+thread.
+
+A page is handled in two phases with plain data in between, so nothing but
+bytes, strings and tuples crosses the interpreter boundary:
+
+1. :func:`link_table` parses the body and returns its links as
+   `(tag, url, kind, canonical)` rows in document order.
+2. The crawling thread schedules the children and gets the new url of
+   every row (see :meth:`HTMLResource.resolve_children`).
+3. :func:`rewrite` parses the body again, replaces the urls row by row and
+   serialises the page.
+
+The body is parsed twice, in exchange both phases run in parallel with
+other pages and the trees never leave the worker.
+
+In the process mode a body is never pickled: :meth:`Offloader.share`
+copies it once into a `multiprocessing.shared_memory` segment and the
+workers read it from there in parser sized chunks. The rewritten page is
+written to its file by the worker, only the link table and the new urls
+cross the process boundary.
+
+Usage::
+
+    scheduler = thread_pool_crawler_scheduler(maxsize=8)
+    scheduler.offload = Offloader(workers=4)
+    ...
+    scheduler.offload.close()
+"""
+import logging
+import multiprocessing
+import os
+from collections import namedtuple
+from concurrent.futures import ProcessPoolExecutor
+from concurrent.futures import ThreadPoolExecutor
+from io import BytesIO
+
+from lxml.html import HtmlComment
+from lxml.html import tostring
+
+from .elements import _is_canonical_link
+from .graph import edge_kind
+from .parsers import iterparse
+from .urls import retrieve_resource
+
+try:
+    from concurrent.futures import InterpreterPoolExecutor
+except ImportError:  # python < 3.14
+    InterpreterPoolExecutor = None
+
+try:
+    from multiprocessing.shared_memory import SharedMemory
+except ImportError:  # python < 3.8
+    SharedMemory = None
+
+__all__ = ['Offloader', 'SharedBody', 'link_table', 'rewrite', 'MODES', 'available_cpus']
+
+logger = logging.getLogger(__name__)
+
+#: auto         - processes.
+#: interpreters - subinterpreters with a GIL each (Python 3.14+); lxml is
+#:                an extension of single-phase init, which such an
+#:                interpreter may refuse to load, processes are used then.
+#: processes    - a process pool, the bodies go through shared memory.
+#: threads      - a thread pool, for free-threaded builds and debugging.
+MODES = ('auto', 'interpreters', 'processes', 'threads')
+
+
+def available_cpus():
+    """Cpus this process may run on."""
+    try:
+        return len(os.sched_getaffinity(0))
+    except (AttributeError, OSError):
+        return os.cpu_count() or 1
+
+
+SharedBody = namedtuple('SharedBody', 'name size')
+SharedBody.__doc__ = """A body staged in the shared memory segment `name` by
+:meth:`Offloader.share`, this is all a worker receives of it."""
+
+
+class _BufferReader(object):
+    """Reads a memoryview like a file without copying it as a whole."""
+
+    def __init__(self, buf):
+        self.buf = buf
+        self.pos = 0
+
+    def read(self, n=-1):
+        end = len(self.buf) if n is None or n < 0 else min(len(self.buf), self.pos + n)
+        data = bytes(self.buf[self.pos:end])
+        self.pos = end
+        return data
+
+
+def _attach(name):
+    try:
+        return SharedMemory(name=name, track=False)
+    except TypeError:  # python < 3.13, the creator unlinks it anyway
+        return SharedMemory(name=name)
+
+
+def _parse(body, encoding):
+    """Returns the `iterparse` of a body and the segment to close after."""
+    if isinstance(body, SharedBody):
+        shm = _attach(body.name)
+        source = _BufferReader(shm.buf[:body.size])
+    else:
+        shm, source = None, BytesIO(body)
+    return iterparse(source, encoding, include_meta_charset_tag=True), shm, source
+
+
+def _detach(shm, source):
+    if shm is not None:
+        source.buf.release()
+        shm.close()
+
+
+def link_table(body, encoding):
+    """Phase one, returns the links of the html `body` (bytes or a
+    :class:`SharedBody`) as `(tag, url, kind, canonical)` rows in document
+    order."""
+    parser, shm, source = _parse(body, encoding)
+    try:
+        return [(elem.tag, url, edge_kind(elem, attr), _is_canonical_link(elem))
+                for elem, attr, url, pos in parser]
+    finally:
+        _detach(shm, source)
+
+
+def rewrite(body, encoding, replacements, watermark=None, filepath=None, url=None):
+    """Phase two, returns the html `body` with the url of the n-th link of
+    its :func:`link_table` replaced by `replacements[n]` (None keeps it).
+
+    With `filepath` the page is written to that file instead and the
+    number of bytes written is returned.
+    """
+    parser, shm, source = _parse(body, encoding)
+    try:
+        count = len(replacements)
+        for n, (elem, attr, link, pos) in enumerate(parser):
+            # the whole document is consumed even if the table came up short
+            new = replacements[n] if n < count else None
+            if new is not None:
+                elem.replace_url(link, new, attr, pos)
+    finally:
+        _detach(shm, source)
+    if watermark:
+        parser.root.insert(0, HtmlComment(watermark))
+    content = tostring(parser.root, include_meta_content_type=True)
+    if filepath is None:
+        return content
+    retrieve_resource(BytesIO(content), filepath, url or filepath, overwrite=True)
+    return len(content)
+
+
+def _probe():
+    """Imports what the workers need, run once by a new subinterpreter pool."""
+    import lxml.etree  # noqa: F401
+    import pywebcopy.offload  # noqa: F401
+    return True
+
+
+class Offloader(object):
+    """Pool of workers running :func:`link_table` and :func:`rewrite`,
+    used as the `offload` plug-in of the schedulers.
+
+    :param workers: size of the pool, default is the number of cpus this
+        process may run on.
+    :param mode: one of :data:`MODES`.
+    :param mp_context: multiprocessing context of the process pool,
+        `spawn` by default as the crawler runs threads when it forks.
+    """
+
+    def __init__(self, workers=None, mode='auto', mp_context=None):
+        if mode not in MODES:
+            raise ValueError("Mode must be one of %r, got %r" % (MODES, mode))
+        if mode == 'auto':
+            mode = 'processes'
+        workers = workers or available_cpus()
+        if mode == 'interpreters':
+            if InterpreterPoolExecutor is None:
+                raise RuntimeError("Subinterpreter pools need Python 3.14 or newer.")
+            self.executor = InterpreterPoolExecutor(max_workers=workers)
+            try:
+                self.executor.submit(_probe).result()
+            except Exception as e:
+                # the pool re-raises the ImportError of the worker wrapped
+                logger.warning("Can't load lxml in a subinterpreter, using processes: %r", e)
+                self.executor.shutdown(wait=True)
+                mode = 'processes'
+        if mode == 'processes':
+            self.executor = ProcessPoolExecutor(
+                max_workers=workers, mp_context=mp_context or multiprocessing.get_context('spawn'))
+        elif mode == 'threads':
+            self.executor = ThreadPoolExecutor(max_workers=workers)
+        self.mode = mode
+        self.workers = workers
+        logger.debug("Offloading html pages to %d %s.", workers, mode)
+
+    def __repr__(self):
+        return '<Offloader(mode=%r, workers=%d)>' % (self.mode, self.workers)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def share(self, body):
+        """Stages `body` for the workers, a :class:`SharedBody` in the
+        process mode and the bytes themselves otherwise. Pass the result
+        to :meth:`release` once done with it."""
+        if self.mode != 'processes' or SharedMemory is None or not body:
+            return body
+        shm = SharedMemory(create=True, size=len(body))
+        shm.buf[:len(body)] = body
+        shm.close()
+        return SharedBody(shm.name, len(body))
+
+    @staticmethod
+    def release(body):
+        """Frees the shared memory of a body staged by :meth:`share`."""
+        if isinstance(body, SharedBody):
+            shm = SharedMemory(name=body.name)
+            shm.close()
+            shm.unlink()
+
+    def links(self, body, encoding):
+        """Returns a future of the :func:`link_table` of `body`."""
+        return self.executor.submit(link_table, body, encoding)
+
+    def rewrite(self, body, encoding, replacements, watermark=None, filepath=None, url=None):
+        """Returns a future of the :func:`rewrite` of `body`."""
+        return self.executor.submit(rewrite, body, encoding, replacements, watermark, filepath, url)
+
+    def close(self, wait=True):
+        self.executor.shutdown(wait=wait)
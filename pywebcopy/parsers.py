@@ -19,7 +19,8 @@ from six import string_types
 from six.moves.urllib.parse import urljoin
 from six.moves.collections_abc import Iterator
 
-__all__ = ['iterparse', 'MultiParser', 'Element', 'unquote_match', 'links']
+__all__ = ['iterparse', 'MultiParser', 'Element', 'unquote_match', 'links',
+           'read_head', 'head_urls', 'Prefixed']
 
 logger = logging.getLogger(__name__)
 
@@ -160,6 +161,65 @@ def iterparse(source, encoding=None, events=None,
     return it
 
 
+#: bytes read from the start of a document looking for the end of its head,
+#: four of the chunks :func:`iterparse` reads
+HEAD_LIMIT = 6144
+_body_start = re.compile(br'<body[\s>]|</head\s*>', re.I)
+
+
+def read_head(source, limit=HEAD_LIMIT):
+    """Reads `source` in the chunks of :func:`iterparse` until the head of
+    the document is complete or `limit` bytes were read."""
+    data = b''
+    while len(data) < limit:
+        chunk = source.read(0o3000)
+        if not chunk:
+            break
+        data += chunk
+        if _body_start.search(data):
+            break
+    return data
+
+
+class Prefixed(object):
+    """Readable object returning `head` followed by the rest of `source`,
+    puts back what :func:`read_head` consumed."""
+
+    def __init__(self, head, source):
+        self.head = head
+        self.source = source
+
+    def read(self, n=-1):
+        if not self.head:
+            return self.source.read(n)
+        if n is None or n < 0:
+            data, self.head = self.head + self.source.read(), b''
+            return data
+        data, self.head = self.head[:n], self.head[n:]
+        return data
+
+
+def head_urls(head, encoding=None):
+    """Returns the `<link rel=canonical>` and `<meta property=og:url>` urls
+    declared in the head of a document as a `(canonical, og_url)` tuple,
+    missing ones are None. Only the start tags up to the body are looked at.
+    """
+    parser = etree.HTMLPullParser(events=('start',), encoding=encoding or 'iso-8859-1')
+    parser.feed(head)
+    canonical = og_url = None
+    for _, el in parser.read_events():
+        tag = _nons(el.tag) if isinstance(el.tag, string_types) else None
+        if tag == 'body':
+            break
+        if tag == 'link' and canonical is None:
+            if 'canonical' in (el.get('rel') or '').lower().split():
+                canonical = (el.get('href') or '').strip() or None
+        elif tag == 'meta' and og_url is None:
+            if (el.get('property') or '').lower() == 'og:url':
+                og_url = (el.get('content') or '').strip() or None
+    return canonical, og_url
+
+
 def links(el):
     tag = _nons(el.tag)
     attribs = el.attrib
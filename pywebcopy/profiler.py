@@ -0,0 +1,249 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Low overhead sampling profiler covering all the threads of the process.
+
+Unlike cProfile nothing is traced on function calls; every `interval`
+seconds the stacks of all threads are captured from `sys._current_frames()`
+and counted. The result is written in the collapsed stack format understood
+by flamegraph.pl, speedscope and inferno::
+
+    MainThread;save_website (pywebcopy/__init__.py:97);get (...) 42
+
+Modes:
+    thread - a daemon thread takes the samples (default, works everywhere).
+    signal - a SIGPROF interval timer takes the samples on the main thread,
+             the timer runs on cpu time so idle periods are not sampled.
+    py-spy - the native py-spy sampler is attached to this process if it is
+             installed, it writes its own raw collapsed output.
+
+Usage::
+
+    prof = SamplingProfiler(interval=0.005).start()
+    ...
+    prof.stop()
+    prof.write_collapsed('profile.txt')
+    print(prof.summary(top=20))
+"""
+import logging
+import os
+import signal
+import subprocess
+import sys
+import threading
+import time
+from collections import Counter
+
+__all__ = ['SamplingProfiler', 'profile_to_file']
+
+logger = logging.getLogger(__name__)
+
+MODES = ('thread', 'signal', 'py-spy')
+
+
+def _frame_label(code, lineno):
+    filename = code.co_filename
+    # keep the last two path components, enough to be unambiguous
+    parts = filename.replace('\\', '/').rsplit('/', 2)
+    short = '/'.join(parts[-2:])
+    return '%s (%s:%d)' % (code.co_name, short, lineno or 0)
+
+
+class SamplingProfiler(object):
+    """Statistical stack sampler.
+
+    :param interval: seconds between two samples.
+    :param mode: one of `thread`, `signal` or `py-spy`.
+    :param max_depth: deepest frames kept per stack.
+    """
+
+    def __init__(self, interval=0.005, mode='thread', max_depth=128):
+        if mode not in MODES:
+            raise ValueError("Profiler mode must be one of %r, got %r" % (MODES, mode))
+        self.interval = float(interval)
+        self.mode = mode
+        self.max_depth = max_depth
+        self.stacks = Counter()
+        self.samples = 0
+        self.started = None
+        self.elapsed = 0.0
+        self._labels = {}
+        self._thread = None
+        self._stop = threading.Event()
+        self._old_handler = None
+        self._pyspy = None
+        self._pyspy_output = None
+
+    # -- sampling --
+
+    def _label(self, code, lineno):
+        key = (code, lineno)
+        label = self._labels.get(key)
+        if label is None:
+            label = self._labels[key] = _frame_label(code, lineno)
+        return label
+
+    def sample(self, skip=None, interrupted=None):
+        """Records the current stack of every thread except `skip`.
+
+        :param interrupted: frame to use for the calling thread instead of
+            its own stack, i.e. the frame a signal handler interrupted.
+        """
+        names = dict((t.ident, t.name) for t in threading.enumerate())
+        label = self._label
+        max_depth = self.max_depth
+        stacks = self.stacks
+        frames = sys._current_frames()
+        if interrupted is not None:
+            frames[threading.get_ident()] = interrupted
+        for ident, frame in frames.items():
+            if ident == skip:
+                continue
+            parts = []
+            while frame is not None and len(parts) < max_depth:
+                parts.append(label(frame.f_code, frame.f_lineno))
+                frame = frame.f_back
+            parts.append(names.get(ident, 'thread-%d' % ident))
+            parts.reverse()
+            stacks[';'.join(parts)] += 1
+        self.samples += 1
+
+    def _run(self):
+        me = threading.get_ident()
+        wait = self._stop.wait
+        while not wait(self.interval):
+            self.sample(skip=me)
+
+    def _on_signal(self, signum, frame):
+        # never let the profiler break the program it is observing
+        try:
+            self.sample(interrupted=frame)
+        except Exception:  # pragma: no cover
+            pass
+
+    # -- lifecycle --
+
+    def start(self):
+        self.started = time.perf_counter()
+        if self.mode == 'thread':
+            self._stop.clear()
+            self._thread = threading.Thread(
+                target=self._run, name='pywebcopy-profiler', daemon=True)
+            self._thread.start()
+        elif self.mode == 'signal':
+            if not hasattr(signal, 'setitimer'):
+                raise RuntimeError("Signal based sampling is not available on this platform.")
+            self._old_handler = signal.signal(signal.SIGPROF, self._on_signal)
+            signal.setitimer(signal.ITIMER_PROF, self.interval, self.interval)
+        else:
+            self._start_pyspy()
+        logger.debug('Started %s sampling profiler every %.4fs', self.mode, self.interval)
+        return self
+
+    def _start_pyspy(self):
+        import tempfile
+        fd, self._pyspy_output = tempfile.mkstemp(prefix='pywebcopy-pyspy-', suffix='.txt')
+        os.close(fd)
+        rate = max(1, int(round(1.0 / self.interval)))
+        try:
+            self._pyspy = subprocess.Popen(
+                ['py-spy', 'record', '--pid', str(os.getpid()), '--format', 'raw',
+                 '--rate', str(rate), '--threads', '--nonblocking',
+                 '--output', self._pyspy_output],
+                stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        except OSError:
+            raise RuntimeError(
+                "py-spy is not installed. Install it using pip: $ pip install py-spy")
+
+    def stop(self):
+        if self.started is None:
+            return self
+        if self.mode == 'thread' and self._thread is not None:
+            self._stop.set()
+            self._thread.join()
+            self._thread = None
+        elif self.mode == 'signal' and self._old_handler is not None:
+            signal.setitimer(signal.ITIMER_PROF, 0, 0)
+            signal.signal(signal.SIGPROF, self._old_handler)
+            self._old_handler = None
+        elif self._pyspy is not None:
+            self._pyspy.send_signal(signal.SIGINT)
+            try:
+                self._pyspy.wait(10)
+            except subprocess.TimeoutExpired:  # pragma: no cover
+                self._pyspy.kill()
+            self._pyspy = None
+            self._load_collapsed(self._pyspy_output)
+            os.remove(self._pyspy_output)
+        self.elapsed = time.perf_counter() - self.started
+        self.started = None
+        return self
+
+    def _load_collapsed(self, path):
+        try:
+            with open(path, 'r') as fh:
+                for line in fh:
+                    stack, _, count = line.rstrip('\n').rpartition(' ')
+                    if stack and count.isdigit():
+                        self.stacks[stack] += int(count)
+                        self.samples += int(count)
+        except (IOError, OSError):
+            logger.error("py-spy did not produce any output at %s", path)
+
+    # -- output --
+
+    def write_collapsed(self, path):
+        """Writes `stack count` lines for flamegraph tools."""
+        with open(path, 'w') as fh:
+            for stack, count in self.stacks.most_common():
+                fh.write('%s %d\n' % (stack, count))
+        return path
+
+    def top(self, n=20):
+        """Returns two lists of `(frame, samples)`: the frames the samples
+        were taken in (self time) and the frames present anywhere on the
+        stack (total time)."""
+        own = Counter()
+        total = Counter()
+        for stack, count in self.stacks.items():
+            frames = stack.split(';')[1:]  # drop the thread name
+            if not frames:
+                continue
+            own[frames[-1]] += count
+            for frame in set(frames):
+                total[frame] += count
+        return own.most_common(n), total.most_common(n)
+
+    def summary(self, top=20):
+        stacks = sum(self.stacks.values()) or 1
+        own, total = self.top(top)
+        lines = ['Sampling profile: %d samples (%d stacks) over %.2fs, mode=%s interval=%.4fs' % (
+            self.samples, stacks, self.elapsed, self.mode, self.interval)]
+        for title, rows in (('self', own), ('total', total)):
+            lines.append('')
+            lines.append('%7s %6s  top %d by %s samples' % ('samples', '%', top, title))
+            for frame, count in rows:
+                lines.append('%7d %5.1f%%  %s' % (count, 100.0 * count / stacks, frame))
+        return '\n'.join(lines)
+
+
+def profile_to_file(path, interval=0.005, mode='thread', top=20, stream=None):
+    """Starts a profiler which writes its collapsed stacks to `path` and a
+    summary to `stream` (stderr by default) when the interpreter exits.
+
+    The report is registered with `atexit` which runs after the non-daemon
+    threads have been joined, so work finished by threaded schedulers after
+    the main thread returns is covered too.
+    """
+    import atexit
+    prof = SamplingProfiler(interval=interval, mode=mode).start()
+
+    def report():
+        prof.stop()
+        prof.write_collapsed(path)
+        out = stream or sys.stderr
+        out.write(prof.summary(top=top) + '\n')
+        out.write('Collapsed stacks written to %s\n' % path)
+
+    atexit.register(report)
+    return prof
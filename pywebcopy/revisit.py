@@ -0,0 +1,324 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Change rate estimation and revisit planning for continuous mirroring.
+
+Every time a url is fetched its validators (ETag, Last-Modified) and a
+digest of the saved file are compared with the previous visit and the
+outcome is stored in a sqlite database. A file which is not rewritten on
+a revisit (assets without `overwrite`) has no new digest, only the
+validators of such a visit are compared. Assuming the page changes as a
+Poisson process of rate λ, the bias reduced estimator of Cho and
+Garcia-Molina ("Estimating Frequency of Change") gives, after `n` revisits
+`I` seconds apart on average of which `X` found a change::
+
+    λ = -ln((n - X + 0.5) / (n + 0.5)) / I
+
+A page revisited `f` times per second is fresh for a fraction
+`F(λ, f) = (f / λ)(1 - exp(-λ / f))` of the time. :meth:`RevisitStore.plan`
+splits a global fetch budget between the urls maximising the (weighted)
+sum of freshness. With a Lagrange multiplier `μ` the optimum satisfies
+`w/λ · h(λ/f) = μ` with `h(r) = 1 - (1 + r) exp(-r)`, pages with `w/λ <= μ`
+are left at the floor rate; `μ` is found by bisection on the budget.
+Pages changing much faster than they could be revisited get nothing, which
+is the counter-intuitive but optimal answer.
+
+Usage::
+
+    store = RevisitStore('mirror.db')
+    scheduler.revisits = store            # records every retrieved resource
+    ...
+    store.plan(fetches_per_hour=600)
+    for url in store.due():
+        ...
+"""
+import hashlib
+import logging
+import math
+import os
+import re
+import sqlite3
+import threading
+import time
+from bisect import bisect_left
+
+__all__ = ['RevisitStore', 'estimate_rate', 'freshness']
+
+logger = logging.getLogger(__name__)
+
+#: watermark comment written into every saved html page, changes each visit
+_watermark = re.compile(br'<!--\s*\* PyWebCopy Engine.*?-->', re.S)
+
+_schema = """
+CREATE TABLE IF NOT EXISTS observations (
+    url           TEXT PRIMARY KEY,
+    first_seen    REAL NOT NULL,
+    last_visit    REAL NOT NULL,
+    revisits      INTEGER NOT NULL DEFAULT 0,
+    changes       INTEGER NOT NULL DEFAULT 0,
+    elapsed       REAL NOT NULL DEFAULT 0,
+    etag          TEXT,
+    last_modified TEXT,
+    digest        TEXT,
+    interval      REAL,
+    next_visit    REAL
+)
+"""
+
+
+def estimate_rate(revisits, changes, elapsed):
+    """Change rate per second from `revisits` comparisons spanning
+    `elapsed` seconds of which `changes` detected a change, or None
+    without any comparison."""
+    if revisits <= 0 or elapsed <= 0:
+        return None
+    interval = elapsed / revisits
+    return -math.log((revisits - changes + 0.5) / (revisits + 0.5)) / interval
+
+
+def freshness(rate, frequency):
+    """Expected fraction of time a copy revisited `frequency` times per
+    second is identical to a page changing at `rate` per second."""
+    if rate <= 0:
+        return 1.0
+    if frequency <= 0:
+        return 0.0
+    r = rate / frequency
+    return (1.0 - math.exp(-r)) / r
+
+
+# h(r) = 1 - (1 + r) e^-r is increasing from 0 to 1, it is inverted by
+# interpolating a table instead of a root search per url and iteration.
+_r_table = [10.0 ** (k / 200.0) for k in range(-1200, 601)]   # 1e-6 .. 1e3
+_h_table = [1.0 - (1.0 + r) * math.exp(-r) for r in _r_table]
+
+
+def _h_inverse(c):
+    i = bisect_left(_h_table, c)
+    if i <= 0:
+        return _r_table[0]
+    if i >= len(_h_table):
+        return _r_table[-1]
+    h0, h1 = _h_table[i - 1], _h_table[i]
+    r0, r1 = _r_table[i - 1], _r_table[i]
+    return r0 + (r1 - r0) * (c - h0) / (h1 - h0) if h1 > h0 else r1
+
+
+def _frequencies(rates, weights, budget):
+    """Optimal revisit frequencies for `rates` (all > 0) summing up to
+    `budget`, see the module docs."""
+
+    def allocate(mu):
+        out = []
+        for rate, w in zip(rates, weights):
+            c = mu * rate / w
+            out.append(0.0 if c >= 1.0 else rate / _h_inverse(c))
+        return out
+
+    # the first page gets a share at mu just below max(w / rate)
+    hi = max(w / rate for rate, w in zip(rates, weights))
+    lo = hi * 1e-12
+    if sum(allocate(lo)) <= budget:
+        return allocate(lo)
+    for _ in range(100):
+        mid = math.sqrt(lo * hi)
+        if sum(allocate(mid)) > budget:
+            lo = mid
+        else:
+            hi = mid
+        if hi / lo < 1 + 1e-9:
+            break
+    return allocate(hi)
+
+
+class RevisitStore(object):
+    """Per-url change observations on sqlite and the revisit plan.
+
+    :param path: database file, ':memory:' keeps it in memory.
+    :param default_rate: change rate assumed for urls visited only once,
+        per second (default: once a day).
+    :param min_interval: shortest revisit interval in seconds.
+    :param max_interval: longest revisit interval in seconds; every url is
+        checked at least this often so that its estimate stays current.
+    """
+
+    def __init__(self, path=':memory:', default_rate=1.0 / 86400,
+                 min_interval=60.0, max_interval=30 * 86400.0):
+        self.path = path
+        self.default_rate = default_rate
+        self.min_interval = min_interval
+        self.max_interval = max_interval
+        self.lock = threading.Lock()
+        self.db = sqlite3.connect(path, check_same_thread=False)
+        with self.db:
+            self.db.execute(_schema)
+
+    def __repr__(self):
+        return '<RevisitStore(%r)>' % self.path
+
+    def __len__(self):
+        with self.lock:
+            return self.db.execute('SELECT COUNT(*) FROM observations').fetchone()[0]
+
+    def close(self):
+        with self.lock:
+            self.db.close()
+
+    # -- observations --
+
+    def observe(self, url, etag=None, last_modified=None, digest=None, when=None):
+        """Records a visit and returns True if the url changed since the
+        previous one, None on the first visit.
+
+        A change is detected if any of the values known on both visits
+        differs; the digest is the most reliable, validators are used when
+        the body could not be hashed. A visit sharing no value with the
+        previous one tells nothing and is not counted, it returns None.
+        """
+        when = time.time() if when is None else when
+        with self.lock, self.db:
+            row = self.db.execute(
+                'SELECT last_visit, etag, last_modified, digest FROM observations WHERE url = ?',
+                (url,)).fetchone()
+            if row is None:
+                self.db.execute(
+                    'INSERT INTO observations (url, first_seen, last_visit, etag, last_modified, digest) '
+                    'VALUES (?, ?, ?, ?, ?, ?)', (url, when, when, etag, last_modified, digest))
+                return None
+            last, old = row[0], row[1:]
+            pairs = [(a, b) for a, b in zip(old, (etag, last_modified, digest)) if a and b]
+            if digest and old[2]:
+                pairs = pairs[-1:]
+            if not pairs:
+                return None
+            changed = any(a != b for a, b in pairs)
+            self.db.execute(
+                'UPDATE observations SET last_visit = ?, revisits = revisits + 1, '
+                'changes = changes + ?, elapsed = elapsed + ?, etag = ?, last_modified = ?, '
+                'digest = ?, next_visit = CASE WHEN interval IS NULL THEN NULL ELSE ? + interval END '
+                'WHERE url = ?',
+                (when, int(changed), max(0.0, when - last), etag or old[0],
+                 last_modified or old[1], digest or old[2], when, url))
+            return changed
+
+    def observe_resource(self, resource, written=True):
+        """Records a retrieved resource, used as the `revisits` hook of
+        the schedulers; `written` is False if its file was left as it was,
+        see :meth:`file_state`."""
+        response = resource.response
+        if response is None or response.status_code != 200:
+            return None
+        headers = response.headers
+        return self.observe(
+            resource.context.url, headers.get('ETag'), headers.get('Last-Modified'),
+            self.file_digest(resource.filepath) if written else None)
+
+    @staticmethod
+    def file_state(path):
+        """Returns what tells whether the file at `path` was rewritten, or
+        None if there is no such file."""
+        try:
+            st = os.stat(path)
+        except (OSError, IOError, TypeError, ValueError):
+            return None
+        return st.st_ino, st.st_size, st.st_mtime_ns
+
+    @staticmethod
+    def file_digest(path, chunk=1 << 16):
+        """Digest of a saved file ignoring the watermark of html pages, the
+        file is read `chunk` bytes at a time."""
+        h = hashlib.blake2b(digest_size=16)
+        try:
+            with open(path, 'rb') as fh:
+                head = fh.read(chunk)
+                if head.startswith(b'<') and b'PyWebCopy Engine' in head[:512]:
+                    # the watermark comment is a few hundred bytes long
+                    head += fh.read(chunk)
+                    head = _watermark.sub(b'', head, 1)
+                while head:
+                    h.update(head)
+                    head = fh.read(chunk)
+        except (OSError, IOError, TypeError):
+            return None
+        return h.hexdigest()
+
+    def rate(self, url):
+        """Estimated change rate per second of the url or None."""
+        with self.lock:
+            row = self.db.execute(
+                'SELECT revisits, changes, elapsed FROM observations WHERE url = ?', (url,)).fetchone()
+        if row is None:
+            return None
+        rate = estimate_rate(*row)
+        return self.default_rate if rate is None else rate
+
+    # -- planning --
+
+    def plan(self, fetches_per_hour, weights=None, now=None):
+        """Splits `fetches_per_hour` between all known urls so that the
+        expected freshness is maximal and stores the resulting intervals.
+
+        :param weights: optional mapping url -> importance (default 1).
+        :returns: dict url -> revisit interval in seconds.
+        """
+        now = time.time() if now is None else now
+        weights = weights or {}
+        with self.lock:
+            rows = self.db.execute(
+                'SELECT url, revisits, changes, elapsed, last_visit FROM observations').fetchall()
+        if not rows:
+            return {}
+        budget = fetches_per_hour / 3600.0
+        floor = 1.0 / self.max_interval
+        ceiling = 1.0 / self.min_interval
+
+        urls, rates, ws, lasts = [], [], [], []
+        for url, revisits, changes, elapsed, last in rows:
+            rate = estimate_rate(revisits, changes, elapsed)
+            urls.append(url)
+            rates.append(self.default_rate if rate is None else rate)
+            ws.append(float(weights.get(url, 1.0)))
+            lasts.append(last)
+
+        # every url gets the floor, the rest goes to the pages it helps most
+        spare = budget - floor * len(urls)
+        freqs = [0.0] * len(urls)
+        active = [i for i, rate in enumerate(rates) if rate > 0 and ws[i] > 0]
+        if spare > 0 and active:
+            for i, f in zip(active, _frequencies([rates[i] for i in active], [ws[i] for i in active], spare)):
+                freqs[i] = f
+        elif spare < 0:
+            logger.warning("Revisit budget of %s fetches per hour is below the floor of %d urls.",
+                           fetches_per_hour, len(urls))
+
+        plan = {}
+        updates = []
+        for url, f, last in zip(urls, freqs, lasts):
+            interval = 1.0 / min(ceiling, max(floor, f + floor))
+            plan[url] = interval
+            updates.append((interval, last + interval, url))
+        with self.lock, self.db:
+            self.db.executemany('UPDATE observations SET interval = ?, next_visit = ? WHERE url = ?', updates)
+        return plan
+
+    def expected_freshness(self, plan, weights=None):
+        """Weighted mean freshness of the urls under a plan."""
+        weights = weights or {}
+        total = score = 0.0
+        for url, interval in plan.items():
+            w = float(weights.get(url, 1.0))
+            total += w
+            score += w * freshness(self.rate(url), 1.0 / interval)
+        return score / total if total else 1.0
+
+    def due(self, now=None, limit=None):
+        """Urls whose planned revisit time has passed, most overdue first."""
+        now = time.time() if now is None else now
+        query = ('SELECT url FROM observations WHERE next_visit IS NOT NULL AND next_visit <= ? '
+                 'ORDER BY next_visit')
+        args = (now,)
+        if limit is not None:
+            query += ' LIMIT ?'
+            args += (int(limit),)
+        with self.lock:
+            return [row[0] for row in self.db.execute(query, args)]
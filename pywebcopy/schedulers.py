@@ -2,6 +2,7 @@
 # See license for more details
 import logging
 import threading
+import time
 import weakref
 
 from requests import ConnectionError
@@ -9,6 +10,7 @@ from six import PY3
 from six import string_types
 from six.moves.urllib.parse import urlparse
 
+from . import events
 from .elements import VoidResource
 from .elements import CSSResource
 from .elements import JSResource
@@ -17,26 +19,35 @@ from .elements import GenericResource
 from .elements import HTMLResource
 from .elements import UrlRemover
 from .helpers import RecentOrderedDict
+from .traps import DEMOTE
+from .traps import REFUSE
 
 logger = logging.getLogger(__name__)
 
 
 class Index(RecentOrderedDict):
-    """Files index dict.
+    """Files index dict, safe to share between threads.
 
     ..todo:: make it database synced
     """
-    def __init__(self, *args, **kwargs):
-        super(Index, self).__init__(*args, **kwargs)
-        self.lock = threading.Lock()
 
     def add_entry(self, k, v):
-        with self.lock:
-            self.__setitem__(k, v)
+        self.__setitem__(k, v)
 
     def get_entry(self, k, default=None):
         return self.get(k, default=default)
 
+    def claim(self, k, v):
+        """Adds the entry unless the url is indexed already and returns the
+        existing location or None; of threads claiming the same url only
+        one gets None and processes it."""
+        with self._lock:
+            if k in self._data:
+                self._data.move_to_end(k)
+                return self._data[k]
+            self._data[k] = v
+        return None
+
     def add_resource(self, resource):
         location = resource.filepath
         self.add_entry(resource.context.url, location)
@@ -69,22 +80,50 @@ class SchedulerBase(object):
         self.default = default
         self.index = Index()
         self.block_external_domains = True
+        #: assign the paths of new resources from their url and the link to
+        #: them (see :meth:`GenericResource.speculate`), so the parent does
+        #: not wait for the response to know where the file goes.
+        self.speculative_paths = False
+        #: optional :class:`pywebcopy.scope.Scope` deciding which html pages
+        #: belong to the crawl, replaces the base url prefix test when set.
+        self.scope = None
+        #: optional :class:`pywebcopy.simhash.NearDuplicates` flagging html
+        #: pages which repeat the content of an earlier page.
+        self.dedup = None
+        #: optional :class:`pywebcopy.traps.TrapDetector` refusing or
+        #: demoting html pages of url patterns which look like traps.
+        self.traps = None
+        #: optional :class:`pywebcopy.graph.LinkGraph` recording the edges
+        #: from every parsed page and stylesheet to the urls it references.
+        self.graph = None
+        #: optional :class:`pywebcopy.revisit.RevisitStore` recording the
+        #: validators and digest of every retrieved resource.
+        self.revisits = None
+        #: optional :class:`pywebcopy.canonical.Canonicals` aliasing html
+        #: pages to the first page declaring the same canonical url.
+        self.canonicals = None
+        #: optional :class:`pywebcopy.offload.Offloader` parsing and
+        #: rewriting html pages in worker interpreters or processes.
+        self.offload = None
+        #: optional :class:`pywebcopy.deadline.Deadline` fetching the
+        #: resources by priority until the capture runs out of time.
+        self.deadline = None
         self.logger = logger.getChild(self.__class__.__name__)
 
     def set_default(self, default):
         self.default = default
-        self.logger.info("Set the scheduler default as: [%r]" % default)
+        self.logger.info("Set the scheduler default as: [%r]", default)
 
     def register_handler(self, key, value):
         self.data.__setitem__(key, value)
         self.logger.info(
-            "Set the scheduler handler for %s as: [%r]" % (key, value))
+            "Set the scheduler handler for %s as: [%r]", key, value)
 
     add_handler = register_handler
 
     def deregister_handler(self, key):
         self.data.__delitem__(key)
-        self.logger.info("Removed the scheduler handler for: %s" % key)
+        self.logger.info("Removed the scheduler handler for: %s", key)
 
     remove_handler = deregister_handler
 
@@ -96,6 +135,15 @@ class SchedulerBase(object):
         else:
             return self.data[key](*args, **params)
 
+    def resolve_stateless(self, key, context, parent_path=None):
+        """Returns the rewritten url of a link whose handler is stateless
+        (see :attr:`VoidResource.stateless`) without creating a resource,
+        or None if the link needs a resource."""
+        factory = self.data.get(key, self.default)
+        if getattr(factory, 'stateless', False):
+            return factory.resolve_link(context, parent_path)
+        return None
+
     invalid_schemas = tuple([
         'data', 'javascript', 'mailto', 'tel',
     ])
@@ -107,66 +155,85 @@ class SchedulerBase(object):
 
     def validate_url(self, url):
         if not isinstance(url, string_types):
-            self.logger.error(
-                "Expected string type, got %r" % url)
+            self.logger.error("Expected string type, got %r", url)
             return False
         scheme, host, port, path, query, frag = urlparse(url)
         if scheme in self.invalid_schemas:
             self.logger.error(
-                "Invalid url schema: [%s] for url: [%s]"
-                % (scheme, url))
+                "Invalid url schema: [%s] for url: [%s]", scheme, url)
             return False
         if scheme not in self.valid_schemas:
             self.logger.error(
-                "Invalid url schema: [%s] for url: [%s]"
-                % (scheme, url))
+                "Invalid url schema: [%s] for url: [%s]", scheme, url)
             return False
         #: TODO: Add a user validation of the url before blocking
         return True
 
     def validate_resource(self, resource):
         if not isinstance(resource, GenericResource):
-            self.logger.error(
-                "Expected GenericResource, got %r" % resource)
+            self.logger.error("Expected GenericResource, got %r", resource)
             return False
         if isinstance(resource, VoidResource):
-            self.logger.error(
-                "Skipping VoidResource: %r" % resource)
+            self.logger.error("Skipping VoidResource: %r", resource)
             return False
         if not isinstance(resource.url, string_types):
-            self.logger.error(
-                "Expected url of string type, got %r" % resource.url)
+            self.logger.error("Expected url of string type, got %r", resource.url)
             return False
-        if isinstance(resource, HTMLResource) and self.block_external_domains:
+        if isinstance(resource, HTMLResource) and self.scope is not None:
+            allowed, rule = self.scope.classify(resource.url)
+            if not allowed:
+                self.logger.error(
+                    "Blocked resource out of scope: %s by rule: %r", resource.url, rule)
+                return False
+        elif isinstance(resource, HTMLResource) and self.block_external_domains:
             # FIXME: Change the algorithm to evaluate redirects.
             # print(resource.url, resource.context)
             if not resource.url.startswith(resource.context.base_url):
                 self.logger.error(
-                    "Blocked resource on external domain: %s" % resource.url)
+                    "Blocked resource on external domain: %s", resource.url)
+                return False
+        if not self.validate_url(resource.url):
+            return False
+        if isinstance(resource, HTMLResource) and self.traps is not None:
+            decision, reason = self.traps.check(resource.url)
+            if decision == REFUSE:
+                self.logger.error(
+                    "Blocked resource in crawler trap: %s by %s", resource.url, reason)
                 return False
-        return self.validate_url(resource.url)
+            if decision == DEMOTE:
+                resource.follow_links = False
+        return True
 
     def handle_resource(self, resource):
         indexed = self.index.get_entry(resource.url)
+        if not indexed:
+            # Update the index before doing any processing so that later calls
+            # to index find this entry without going in infinite recursion
+            # Response could have been already present on disk
+            indexed = self.index.claim(resource.context.url, resource.filepath)
         if indexed:
-            self.logger.debug(
-                "[Cache] Resource Key: [%s] is available in the cache with value: [%s]"
-                % (resource.url, indexed)
-            )
+            events.log(self.logger, events.SCHEDULER_CACHED, resource.url, indexed)
             # modify the resources path resolution mechanism.
             return resource.__dict__.__setitem__('filepath', indexed)
 
-        # Update the index before doing any processing so that later calls
-        # to index find this entry without going in infinite recursion
-        # Response could have been already present on disk
-        self.index.add_entry(resource.context.url, resource.filepath)
-
         if self.validate_resource(resource):
-            self.logger.debug("Processing valid resource: %r" % resource)
+            events.log(self.logger, events.SCHEDULER_PROCESS, resource)
+            if self.deadline is not None:
+                return self.deadline.submit(resource, self._fetch)
             return self._handle_resource(resource)
-        self.logger.error("Discarding invalid resource: %r" % resource)
+        self.logger.error("Discarding invalid resource: %r", resource)
         return resource.filepath
 
+    def handle_many(self, resources):
+        """Handles resources found together, e.g. the urls of one stylesheet,
+        and returns once their paths may be resolved."""
+        if self.deadline is None:
+            return [self.handle_resource(r) for r in resources]
+        for r in self.deadline.order(resources):
+            self.handle_resource(r)
+        self.deadline.wait(resources)
+        return [r.filepath for r in resources]
+
     def _handle_resource(self, resource):
         raise NotImplementedError()
 
@@ -183,51 +250,135 @@ class Collector(SchedulerBase):
 
 
 class Scheduler(SchedulerBase):
+    """Synchronous scheduler, a resource is processed before its parent.
+
+    With :attr:`speculative_paths` the resources with a pinned path are
+    postponed instead: the parent is written first and its children are
+    then fetched in batches of :attr:`max_parallel`.
+    """
+    #: resources of one :meth:`handle_many` call or one batch of postponed
+    #: resources fetched at once.
+    max_parallel = 8
+
+    def __init__(self, *args, **kwargs):
+        super(Scheduler, self).__init__(*args, **kwargs)
+        #: resources postponed by the resource the thread is processing
+        self._local = threading.local()
+
+    def _map(self, func, items):
+        """Returns `func` of every item, run on up to :attr:`max_parallel`
+        threads which postpone resources like the calling thread."""
+        if not PY3 or self.max_parallel < 2 or len(items) < 2:
+            return [func(item) for item in items]
+        import concurrent.futures
+        pending = getattr(self._local, 'pending', None)
+
+        def run(item):
+            self._local.pending = pending
+            return func(item)
+
+        # a pool per call, the items may call this again while it runs
+        with concurrent.futures.ThreadPoolExecutor(min(self.max_parallel, len(items))) as pool:
+            return list(pool.map(run, items))
+
+    def handle_many(self, resources):
+        if self.deadline is not None:
+            # fetched by the workers of the deadline
+            return super(Scheduler, self).handle_many(resources)
+        return self._map(self.handle_resource, resources)
+
     def _handle_resource(self, resource):
+        pending = getattr(self._local, 'pending', None)
+        if pending is not None and resource.pinned is not None:
+            # the parent links to the pinned path already
+            pending.append(resource)
+            return
+        if pending is not None or not self.speculative_paths:
+            return self._fetch(resource)
+        self._local.pending = pending = []
+        try:
+            self._fetch(resource)
+            while pending:
+                batch = pending[:]
+                del pending[:len(batch)]
+                self._map(self._fetch, batch)
+        finally:
+            self._local.pending = None
+
+    def _fetch(self, resource):
         try:
-            self.logger.debug('Scheduler trying to get resource at: [%s]' % resource.url)
-            resource.get(resource.context.url)
+            events.log(self.logger, events.SCHEDULER_GET, resource.url)
+            if self.deadline is not None:
+                resource.get(resource.context.url, timeout=self.deadline.timeout(resource))
+            else:
+                resource.get(resource.context.url)
             # NOTE :meth:`get` can change the :attr:`filepath` of the resource
             self.index.add_resource(resource)
         except ConnectionError:
             self.logger.error(
-                "Scheduler ConnectionError Failed to retrieve resource from [%s]"
-                % resource.url)
+                "Scheduler ConnectionError Failed to retrieve resource from [%s]", resource.url)
             # self.index.add_entry(resource.url, resource.filepath)
         except Exception as e:
             self.logger.exception(e)
             # self.index.add_entry(resource.url, resource.filepath)
         else:
-            self.logger.debug('Scheduler running handler for: [%s]' % resource.url)
+            events.log(self.logger, events.SCHEDULER_RETRIEVE, resource.url)
             resource.retrieve()
         self.index.add_resource(resource)
 
 
 class ThreadingScheduler(Scheduler):
+    #: the resources are handed to workers right away
+    max_parallel = 1
+
     def __init__(self, *args, **kwargs):
         super(ThreadingScheduler, self).__init__(*args, **kwargs)
+        # the parents are rewritten before the children are fetched
+        self.speculative_paths = True
         self.threads = weakref.WeakSet()
+        #: worker threads start threads too, the set is not thread-safe
+        self._threads_lock = threading.Lock()
         self.timeout = None
 
     def __del__(self):
         self.close()
 
+    def join(self, timeout=None):
+        """Waits for the running threads and for every thread they start
+        in turn. Returns False if the timeout expired before that."""
+        deadline = None if timeout is None else time.time() + timeout
+        current = threading.current_thread()
+        while self.threads is not None:
+            with self._threads_lock:
+                threads = list(self.threads)
+            alive = [t for t in threads if t.is_alive() and t is not current]
+            if not alive:
+                return True
+            for thread in alive:
+                if deadline is None:
+                    thread.join()
+                else:
+                    remaining = deadline - time.time()
+                    if remaining <= 0:
+                        return False
+                    thread.join(remaining)
+        return True
+
     def close(self, timeout=None):
+        if self.threads is None:
+            return
         if not timeout:
             timeout = self.timeout
-        threads = self.threads
+        self.join(timeout)
         self.threads = None
-        for thread in threads:
-            if thread.is_alive() and thread is not threading.current_thread():
-                thread.join(timeout)
 
     def _handle_resource(self, resource):
         def run(r):
             try:
-                self.logger.debug('Scheduler trying to get resource at: [%s]' % r.url)
+                events.log(self.logger, events.SCHEDULER_GET, r.url)
                 # r.response = r.session.get(r.context.url)
                 r.get(r.context.url)
-                self.logger.debug('Scheduler running handler for: [%s]' % r.url)
+                events.log(self.logger, events.SCHEDULER_RETRIEVE, r.url)
                 r.retrieve()
             except Exception as e:
                 self.logger.debug('Exception encountered in retrieval: [%s]',  e)
@@ -235,12 +386,20 @@ class ThreadingScheduler(Scheduler):
                 return r.context.url, r.filepath
         thread = threading.Thread(target=run, args=(resource,))
         thread.start()
-        self.threads.add(thread)
+        with self._threads_lock:
+            threads = self.threads
+            if threads is not None:
+                threads.add(thread)
 
 
 class GEventScheduler(Scheduler):
+    #: the resources are handed to workers right away
+    max_parallel = 1
+
     def __init__(self, maxsize=None, *args, **kwargs):
         super(GEventScheduler, self).__init__(*args, **kwargs)
+        # the parents are rewritten before the children are fetched
+        self.speculative_paths = True
         try:
             from gevent.pool import Pool
         except ImportError:
@@ -258,35 +417,53 @@ class GEventScheduler(Scheduler):
 
     def _handle_resource(self, resource):
         def run(r):
-            self.logger.debug('Scheduler trying to get resource at: [%s]' % resource.url)
-            r.response = r.session.get(r.context.url)
-            self.logger.debug('Scheduler running retrieving process: [%s]' % resource.url)
+            events.log(self.logger, events.SCHEDULER_GET, resource.url)
+            r.get(r.context.url)
+            events.log(self.logger, events.SCHEDULER_RETRIEVE, resource.url)
             r.retrieve()
             return r.context.url, r.filepath
 
         g = self.pool.spawn(run, resource)
-        g.link_value(lambda gl: logger.info("Written the file from <%s> to <%s>" % gl.value))
+        g.link_value(lambda gl: events.log(logger, events.SCHEDULER_WRITTEN, *gl.value))
         g.link_exception(lambda gl: logger.error(str(gl.exception)))
 
 
 if PY3:
     class ThreadPoolScheduler(Scheduler):
+        #: the resources are handed to workers right away
+        max_parallel = 1
+
         def __init__(self, maxsize=None, *args, **kwargs):
             super(ThreadPoolScheduler, self).__init__(*args, **kwargs)
+            # the parents are rewritten before the children are fetched
+            self.speculative_paths = True
             import concurrent.futures
             self.pool = concurrent.futures.ThreadPoolExecutor(maxsize)
+            self.pending = 0
+            self._idle = threading.Condition()
 
         def __del__(self):
             self.close()
 
+        def join(self, timeout=None):
+            """Waits until every submitted resource, including the ones
+            submitted while processing others, has been processed.
+            Returns False if the timeout expired before that."""
+            with self._idle:
+                return self._idle.wait_for(lambda: not self.pending, timeout)
+
         def close(self, wait=None):
+            if wait:
+                self.join()
             self.pool.shutdown(wait)
 
         def _handle_resource(self, resource):
             def run(r):
-                self.logger.debug('Scheduler trying to get resource at: [%s]' % resource.url)
-                r.response = r.session.get(r.context.url)
-                self.logger.debug('Scheduler running retrieving process: [%s]' % resource.url)
+                events.log(self.logger, events.SCHEDULER_GET, resource.url)
+                # NOTE: `get` streams the body and resets the cached
+                # content-type and paths, a plain `session.get` did not.
+                r.get(r.context.url)
+                events.log(self.logger, events.SCHEDULER_RETRIEVE, resource.url)
                 r.retrieve()
                 return r.context.url, r.filepath
 
@@ -294,11 +471,25 @@ if PY3:
                 if ret.exception():
                     self.logger.error(str(ret.exception()))
                 else:
-                    self.logger.info("Written the file from <%s> to <%s>" % ret.result())
+                    events.log(self.logger, events.SCHEDULER_WRITTEN, *ret.result())
+                self._finished()
 
-            g = self.pool.submit(run, resource)
+            with self._idle:
+                self.pending += 1
+            try:
+                g = self.pool.submit(run, resource)
+            except BaseException:
+                # e.g. after close(), no callback would count it down
+                self._finished()
+                raise
             g.add_done_callback(callback)
 
+        def _finished(self):
+            with self._idle:
+                self.pending -= 1
+                if not self.pending:
+                    self._idle.notify_all()
+
     def thread_pool_default_scheduler(maxsize=4):
         ans = ThreadPoolScheduler(maxsize=maxsize)
         fac = default_scheduler()
@@ -0,0 +1,398 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Compiled allow/deny rules deciding which urls belong to a crawl.
+
+Rules are plain strings, the prefix selects the kind of rule::
+
+    example.com          the host and all of its subdomains
+    *.example.com        only the subdomains of the host
+    =www.example.com     exactly this host
+    site:www.bbc.co.uk   every host of the registrable domain (bbc.co.uk)
+    path:/blog/*         url path glob, `*` does not cross into the query
+    url:https://x.org/*  glob over the complete url
+    re:\\.(zip|exe)$      regular expression searched in the complete url
+
+Host rules are stored in a trie of reversed labels, so a lookup costs one
+step per label of the host no matter how many rules there are. The path
+and url globs of each decision are merged into one anchored regex whose
+literal prefixes form a character trie, so shared prefixes are scanned
+once; the regex rules are merged into one searched alternation. A url is
+thus tested against at most two regexes per decision however many rules
+there are. Regex rules with inline global flags such as `(?i)` or with
+backreferences cannot be merged without changing their meaning and are
+searched one by one after the merged ones.
+
+Decision order for a url:
+    1. a matching deny pattern denies;
+    2. the most specific host rule decides (deny wins on equal depth);
+    3. a matching allow pattern allows;
+    4. otherwise the default, which is to deny if any allow rule exists.
+
+Usage::
+
+    scope = Scope()
+    scope.allow('site:example.com')
+    scope.deny('ads.example.com')
+    scope.deny('path:/private/*')
+    scope.allows('https://blog.example.com/post')   # True
+"""
+import logging
+import re
+import threading
+
+from six import string_types
+from six.moves.urllib.parse import urlsplit
+
+__all__ = ['Scope', 'ScopeError', 'registrable_domain', 'public_suffix', 'load_public_suffix_list']
+
+logger = logging.getLogger(__name__)
+
+ALLOW = True
+DENY = False
+
+#: Small embedded subset of the public suffix list (https://publicsuffix.org)
+#: covering the common multi-label suffixes and shared hosting platforms.
+#: Unknown top level domains use the implicit `*` rule of the list, i.e. the
+#: last label is the public suffix. The full list can be loaded with
+#: :func:`load_public_suffix_list`.
+_embedded_suffixes = """
+ac.uk co.uk gov.uk ltd.uk me.uk net.uk nhs.uk org.uk plc.uk sch.uk
+com.au edu.au gov.au net.au org.au asn.au id.au
+co.jp ne.jp or.jp ac.jp go.jp ad.jp ed.jp gr.jp lg.jp
+co.nz net.nz org.nz govt.nz ac.nz school.nz
+com.br net.br org.br gov.br edu.br
+com.cn net.cn org.cn gov.cn edu.cn ac.cn
+co.in net.in org.in gov.in ac.in edu.in firm.in gen.in ind.in
+co.za org.za gov.za ac.za web.za
+com.mx org.mx gob.mx edu.mx net.mx
+com.ar com.co com.tr com.tw com.hk com.sg com.my com.ph com.pk com.ua com.eg
+co.kr or.kr go.kr ac.kr ne.kr co.il org.il ac.il co.id or.id ac.id go.id
+com.es org.es gob.es com.pl net.pl org.pl co.th ac.th go.th com.vn co.at or.at
+github.io gitlab.io herokuapp.com appspot.com blogspot.com netlify.app
+vercel.app pages.dev workers.dev web.app firebaseapp.com azurewebsites.net
+cloudfront.net s3.amazonaws.com elasticbeanstalk.com readthedocs.io
+"""
+
+_suffixes = frozenset(_embedded_suffixes.split())
+_suffix_lock = threading.Lock()
+
+
+class ScopeError(ValueError):
+    """Malformed scope rule."""
+
+
+def load_public_suffix_list(path):
+    """Replaces the embedded suffixes with a downloaded public_suffix_list.dat.
+
+    Wildcard (`*.`) and exception (`!`) entries are reduced to their plain
+    suffix which is precise enough for scoping crawls.
+    """
+    global _suffixes
+    out = set()
+    with open(path, 'rb') as fh:
+        for line in fh:
+            line = line.decode('utf-8', 'ignore').strip()
+            if not line or line.startswith('//'):
+                continue
+            line = line.split()[0].lstrip('!')
+            if line.startswith('*.'):
+                line = line[2:]
+            out.add(line.lower())
+    with _suffix_lock:
+        _suffixes = frozenset(out)
+    return len(out)
+
+
+def public_suffix(host):
+    """Returns the longest known public suffix of `host`."""
+    labels = host.lower().rstrip('.').split('.')
+    for i in range(len(labels)):
+        candidate = '.'.join(labels[i:])
+        if candidate in _suffixes:
+            return candidate
+    return labels[-1]
+
+
+def registrable_domain(host):
+    """Returns the public suffix plus one label, e.g. `news.bbc.co.uk`
+    gives `bbc.co.uk`. The host itself is returned if it is a suffix."""
+    host = host.lower().rstrip('.')
+    suffix = public_suffix(host)
+    if host == suffix:
+        return host
+    head = host[:-len(suffix) - 1]
+    return head.rsplit('.', 1)[-1] + '.' + suffix
+
+
+_host_re = re.compile(r'^[a-z0-9_.-]+$')
+
+
+def _split_glob(pattern, star):
+    """Returns the literal text up to the first `*` and the regex of the rest."""
+    head, sep, rest = pattern.partition('*')
+    if not sep:
+        return head, ''
+    return head, star + star.join(re.escape(part) for part in rest.split('*'))
+
+
+def _trie_regex(items):
+    """Builds one regex out of `(literal prefix, regex tail)` items by
+    merging the common literal prefixes into a character trie.
+
+    The regex engine then walks a shared prefix once instead of retrying it
+    for every rule, which keeps hundreds of rules close to the cost of one.
+    """
+    trie = {}
+    for literal, tail in items:
+        node = trie
+        for ch in literal:
+            node = node.setdefault(ch, {})
+        node.setdefault(None, []).append(tail)
+
+    def emit(node):
+        alts = list(node.get(None, ()))
+        for ch, child in sorted((k, v) for k, v in node.items() if k is not None):
+            text = re.escape(ch)
+            # collapse chains of single children into one literal
+            while None not in child and len(child) == 1:
+                ch, child = next(iter(child.items()))
+                text += re.escape(ch)
+            alts.append(text + emit(child))
+        if len(alts) == 1:
+            return alts[0]
+        return '(?:' + '|'.join(alts) + ')'
+
+    return emit(trie)
+
+
+#: scheme and host part skipped by the path globs
+_url_head = r'[^:/?#]+://[^/?#]*'
+
+#: group references whose numbers shift once the regex is merged
+_group_ref = re.compile(r'\\[1-9]|\(\?P=|\(\?\(')
+_default_flags = re.compile('').flags
+
+
+def _mergeable(regex):
+    """True if `regex` means the same inside the merged alternation, i.e.
+    it sets no global flags and refers to no group."""
+    return re.compile(regex).flags == _default_flags and not _group_ref.search(regex)
+
+
+class _Patterns(object):
+    """Path, url and regex rules of one decision compiled into one anchored
+    glob regex and one searched regex.
+
+    Neither regex contains capturing groups; named groups disable the
+    literal prefix scan of the regex engine which made 100 regex rules 50x
+    slower. Which rule matched is only worked out after a hit.
+    """
+    __slots__ = ('globs', 'search', 'separate', 'rules')
+
+    def __init__(self, entries):
+        paths, urls, searches = [], [], []
+        #: regex rules which cannot be merged, searched one by one
+        self.separate = []
+        self.rules = []
+        for kind, value, rule in entries:
+            if kind == 'path':
+                literal, tail = _split_glob(value, '[^?#]*')
+                tail += r'(?:[?#].*)?\Z'
+                paths.append((literal, tail))
+                one = re.compile(_url_head + re.escape(literal) + tail, re.S).match
+            elif kind == 'url':
+                literal, tail = _split_glob(value, '.*')
+                tail += r'\Z'
+                urls.append((literal, tail))
+                one = re.compile(re.escape(literal) + tail, re.S).match
+            else:
+                one = re.compile(value).search
+                if _mergeable(value):
+                    searches.append('(?:%s)' % value)
+                else:
+                    self.separate.append(one)
+            self.rules.append((one, rule))
+        globs = []
+        if paths:
+            globs.append(_url_head + _trie_regex(paths))
+        if urls:
+            globs.append(_trie_regex(urls))
+        self.globs = re.compile('|'.join(globs), re.S).match if globs else None
+        self.search = re.compile('|'.join(searches)).search if searches else None
+
+    def __bool__(self):
+        return bool(self.rules)
+
+    __nonzero__ = __bool__
+
+    def matches(self, url):
+        return ((self.globs is not None and self.globs(url) is not None) or
+                (self.search is not None and self.search(url) is not None) or
+                any(search(url) is not None for search in self.separate))
+
+    def rule(self, url):
+        for match, rule in self.rules:
+            if match(url) is not None:
+                return rule
+
+
+class _HostNode(object):
+    __slots__ = ('children', 'suffix', 'subdomains', 'exact')
+
+    def __init__(self):
+        self.children = {}
+        #: each slot holds (decision, rule) or None
+        self.suffix = None
+        self.subdomains = None
+        self.exact = None
+
+
+class Scope(object):
+    """Set of allow and deny rules compiled into a host trie and a single
+    pattern regex.
+
+    :param rules: optional iterable of `(decision, rule)` pairs where the
+        decision is True for allow and False for deny.
+    """
+
+    def __init__(self, rules=None):
+        self.rules = []
+        self._lock = threading.Lock()
+        self._compiled = None
+        for decision, rule in rules or ():
+            self.add(rule, decision)
+
+    def __repr__(self):
+        return '<Scope(%d rules)>' % len(self.rules)
+
+    def __len__(self):
+        return len(self.rules)
+
+    def add(self, rule, decision):
+        if not isinstance(rule, string_types) or not rule.strip():
+            raise ScopeError("Scope rule must be a non empty string, got %r" % rule)
+        rule = rule.strip()
+        self._parse(rule)  # fail early on bad rules
+        with self._lock:
+            self.rules.append((bool(decision), rule))
+            self._compiled = None
+        return self
+
+    def allow(self, *rules):
+        for rule in rules:
+            self.add(rule, ALLOW)
+        return self
+
+    def deny(self, *rules):
+        for rule in rules:
+            self.add(rule, DENY)
+        return self
+
+    @classmethod
+    def from_base_url(cls, base_url):
+        """Scope equivalent to the `startswith(base_url)` test of the schedulers."""
+        return cls().allow('url:' + base_url + '*')
+
+    # -- compilation --
+
+    @staticmethod
+    def _parse(rule):
+        """Returns `(kind, value)` for a rule string."""
+        kind, sep, value = rule.partition(':')
+        if sep and kind in ('path', 'url', 're', 'site'):
+            if not value:
+                raise ScopeError("Empty %s rule." % kind)
+            if kind == 're':
+                try:
+                    re.compile(value)
+                except re.error as e:
+                    raise ScopeError("Bad regex in scope rule %r: %s" % (rule, e))
+            elif kind == 'site':
+                value = registrable_domain(urlsplit(value).hostname if '://' in value else value)
+            return kind, value
+        host = rule.lower().rstrip('.')
+        if host.startswith('='):
+            kind, host = 'exact', host[1:]
+        elif host.startswith('*.'):
+            kind, host = 'subdomains', host[2:]
+        else:
+            kind = 'suffix'
+        if not _host_re.match(host):
+            raise ScopeError("Invalid host in scope rule %r" % rule)
+        return kind, host
+
+    def compile(self):
+        with self._lock:
+            if self._compiled is not None:
+                return self._compiled
+            root = _HostNode()
+            patterns = {ALLOW: [], DENY: []}
+            has_allow = False
+            for decision, rule in self.rules:
+                has_allow = has_allow or decision
+                kind, value = self._parse(rule)
+                if kind in ('path', 'url', 're'):
+                    patterns[decision].append((kind, value, rule))
+                    continue
+                node = root
+                for label in reversed(value.split('.')):
+                    node = node.children.setdefault(label, _HostNode())
+                slot = 'suffix' if kind == 'site' else kind
+                current = getattr(node, slot)
+                # deny wins over allow for the very same host rule
+                if current is None or current[0] and not decision:
+                    setattr(node, slot, (decision, rule))
+            self._compiled = (root, _Patterns(patterns[DENY]), _Patterns(patterns[ALLOW]), has_allow)
+            return self._compiled
+
+    # -- matching --
+
+    @staticmethod
+    def _match_host(root, host):
+        """Walks the trie from the top level label down and returns the
+        most specific `(decision, rule)` or None."""
+        labels = host.split('.')
+        best = None
+        node = root
+        last = len(labels) - 1
+        for depth, label in enumerate(reversed(labels)):
+            node = node.children.get(label)
+            if node is None:
+                break
+            # the host itself sits on the last label, anything above it
+            # is one of its parent domains
+            first, second = (node.exact, node.suffix) if depth == last else (node.subdomains, node.suffix)
+            if first is None:
+                hit = second
+            elif second is None or not first[0]:
+                hit = first
+            else:
+                hit = second
+            if hit is not None:
+                best = hit
+        return best
+
+    def classify(self, url):
+        """Returns `(allowed, rule)` for the url, `rule` is the rule which
+        decided or None if the default applied."""
+        root, deny, allow, has_allow = self._compiled or self.compile()
+        if deny and deny.matches(url):
+            return DENY, deny.rule(url)
+        if root.children:
+            try:
+                host = urlsplit(url).hostname
+            except ValueError:
+                host = None
+            if host:
+                hit = self._match_host(root, host)
+                if hit is not None:
+                    return hit
+        if allow and allow.matches(url):
+            return ALLOW, allow.rule(url)
+        return (not has_allow), None
+
+    def allows(self, url):
+        return self.classify(url)[0]
+
+    __contains__ = allows
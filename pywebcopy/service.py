@@ -0,0 +1,304 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Long lived capture service sharing its network state between captures.
+
+`save_page` and `save_website` build a config, a session, a connection
+pool and a scheduler for every call, so a worker capturing thousands of
+urls repeats the TLS handshakes, the robots.txt fetches and the dns
+lookups of every host and starts every http cache cold.
+
+A :class:`CaptureService` owns one :class:`pywebcopy.session.Session` with
+large connection pools, the robots.txt rules and the optional http cache
+of that session, a :class:`DNSCache` and a pool of job threads. Capture
+jobs are accepted from any thread and return futures of
+:class:`CaptureResult`.
+
+Every job still gets its own config, scheduler and index: each capture is
+a copy of its own in its own folder, a page captured twice is fetched
+twice. The assets of a job are fetched in parallel by its scheduler (see
+:attr:`Scheduler.max_parallel`), so the connection pools are sized for
+`workers` jobs fetching that many files each.
+
+Usage::
+
+    with CaptureService('/captures', workers=8) as service:
+        futures = [service.submit_page(url) for url in urls]
+        for future in futures:
+            result = future.result()
+            print(result.filepath, result.stats['bytes'])
+"""
+import itertools
+import logging
+import os
+import socket
+import threading
+import time
+from collections import namedtuple
+from concurrent.futures import ThreadPoolExecutor
+
+from requests.adapters import HTTPAdapter
+from urllib3.connectionpool import HTTPConnectionPool
+from urllib3.connectionpool import HTTPSConnectionPool
+from urllib3.exceptions import ConnectTimeoutError
+from urllib3.exceptions import NewConnectionError
+from urllib3.util import connection as urllib3_connection
+
+from .configs import get_config
+from .core import Crawler
+from .core import WebPage
+from .frontier import frontier_crawler_scheduler
+from .schedulers import Scheduler
+from .schedulers import crawler_scheduler
+from .schedulers import default_scheduler
+from .session import Session
+from .urls import Context
+from .urls import get_host
+from .urls import secure_filename
+
+__all__ = ['CaptureService', 'CaptureResult', 'DNSCache', 'KINDS', 'shared_session']
+
+logger = logging.getLogger(__name__)
+
+#: timeout of urllib3 meaning the default of the socket module
+_DEFAULT_TIMEOUT = getattr(urllib3_connection, '_DEFAULT_TIMEOUT', socket._GLOBAL_DEFAULT_TIMEOUT)
+
+#: page - the page and the files it needs.
+#: site - the page and every page of the site it leads to.
+KINDS = ('page', 'site')
+
+CaptureResult = namedtuple('CaptureResult', 'job url kind folder filepath stats')
+CaptureResult.__doc__ = """Outcome of a capture job: the `folder` of the
+copy, the `filepath` of its first page and `stats` with the number of
+`resources` indexed, `files` and `bytes` written and the `seconds` taken."""
+
+
+class DNSCache(object):
+    """Keeps the answers of `getaddrinfo` for `ttl` seconds for the new
+    connections of the adapters it is attached to (see :meth:`attach`);
+    the resolver of the rest of the process is left alone. Failed lookups
+    are not cached.
+
+    :param ttl: seconds an answer is kept.
+    :param resolver: lookup of the names not in the cache, by default
+        `socket.getaddrinfo`.
+    """
+
+    def __init__(self, ttl=300.0, resolver=None):
+        self.ttl = ttl
+        self.resolver = resolver
+        self.hits = self.misses = 0
+        self._answers = {}
+        self._lock = threading.Lock()
+        #: urllib3 connection pools whose connections resolve through this
+        self.pool_classes = {
+            'http': _pool_class(HTTPConnectionPool, self),
+            'https': _pool_class(HTTPSConnectionPool, self),
+        }
+
+    def __len__(self):
+        return len(self._answers)
+
+    def attach(self, adapter):
+        """Makes the connections a requests `adapter` opens from now on
+        resolve their host through this cache, returns the adapter."""
+        adapter.poolmanager.pool_classes_by_scheme = self.pool_classes
+        adapter.poolmanager.clear()
+        return adapter
+
+    def clear(self):
+        with self._lock:
+            self._answers.clear()
+
+    def getaddrinfo(self, host, port, family=0, type=0, proto=0, flags=0):
+        key = (host, port, family, type, proto, flags)
+        now = time.time()
+        with self._lock:
+            entry = self._answers.get(key)
+            if entry is not None and entry[0] > now:
+                self.hits += 1
+                return list(entry[1])
+            self.misses += 1
+        answer = (self.resolver or socket.getaddrinfo)(host, port, family, type, proto, flags)
+        with self._lock:
+            self._answers[key] = (now + self.ttl, tuple(answer))
+        return answer
+
+    def create_connection(self, address, timeout=_DEFAULT_TIMEOUT, source_address=None,
+                          socket_options=None):
+        """`urllib3.util.connection.create_connection` with the lookup of
+        this cache, tries the addresses of the host in turn."""
+        host, port = address
+        if host.startswith('['):
+            host = host.strip('[]')
+        err = None
+        for af, socktype, proto, _, sa in self.getaddrinfo(
+                host, port, urllib3_connection.allowed_gai_family(), socket.SOCK_STREAM):
+            sock = None
+            try:
+                sock = socket.socket(af, socktype, proto)
+                for option in socket_options or ():
+                    sock.setsockopt(*option)
+                if timeout is not _DEFAULT_TIMEOUT:
+                    sock.settimeout(timeout)
+                if source_address:
+                    sock.bind(source_address)
+                sock.connect(sa)
+                return sock
+            except (OSError, IOError) as e:
+                err = e
+                if sock is not None:
+                    sock.close()
+        if err is not None:
+            raise err
+        raise socket.error("getaddrinfo returns an empty list")
+
+
+class _CachedConnection(object):
+    """Mixin of the urllib3 connections resolving their host through the
+    :class:`DNSCache` set as `dns`."""
+    dns = None
+
+    def _new_conn(self):
+        try:
+            return self.dns.create_connection(
+                (self._dns_host, self.port), self.timeout, self.source_address, self.socket_options)
+        except socket.gaierror as e:
+            raise NewConnectionError(self, "Failed to resolve %r: %s" % (self.host, e))
+        except socket.timeout:
+            raise ConnectTimeoutError(
+                self, "Connection to %s timed out. (connect timeout=%s)" % (self.host, self.timeout))
+        except (OSError, IOError) as e:
+            raise NewConnectionError(self, "Failed to establish a new connection: %s" % e)
+
+
+def _pool_class(pool_cls, dns):
+    conn_cls = pool_cls.ConnectionCls
+    conn_cls = type('Cached' + conn_cls.__name__, (_CachedConnection, conn_cls), {'dns': dns})
+    return type('Cached' + pool_cls.__name__, (pool_cls,), {'ConnectionCls': conn_cls})
+
+
+def shared_session(bypass_robots=False, http_cache=False, delay=None, pool_maxsize=10,
+                   pool_connections=100, dns=None):
+    """Returns a :class:`Session` meant to be used by many captures at
+    once, keeping `pool_maxsize` connections to each of `pool_connections`
+    hosts and resolving the hosts through the :class:`DNSCache` `dns`."""
+    session = Session()
+    session.set_follow_robots_txt(not bypass_robots)
+    session.delay = delay
+    if http_cache:
+        session.enable_http_cache()
+    else:
+        adapter = HTTPAdapter(pool_connections=pool_connections, pool_maxsize=pool_maxsize)
+        session.mount('http://', adapter)
+        session.mount('https://', adapter)
+    if dns is not None:
+        for prefix in ('http://', 'https://'):
+            dns.attach(session.get_adapter(prefix))
+    return session
+
+
+class CaptureService(object):
+    """Captures pages and sites concurrently with one session, connection
+    pool, robots.txt registry, dns cache and http cache for all of them.
+
+    :param project_folder: folder in which every job gets its own folder.
+    :param workers: jobs running at once.
+    :param bypass_robots: ignore the robots.txt rules.
+    :param http_cache: cache the responses, needs `cachecontrol`.
+    :param dns_ttl: seconds a dns answer is kept, None disables the cache.
+    :param delay: delay between two requests to the same server.
+    :param pool_maxsize: connections kept per host, by default enough for
+        every job to fetch :attr:`Scheduler.max_parallel` files at once.
+    :param pool_connections: hosts connections are kept to.
+    """
+
+    def __init__(self, project_folder=None, workers=4, bypass_robots=False,
+                 http_cache=False, dns_ttl=300.0, delay=None, pool_maxsize=None,
+                 pool_connections=100):
+        self.project_folder = project_folder
+        self.workers = workers
+        self.bypass_robots = bypass_robots
+        self.delay = delay
+        self.dns = DNSCache(dns_ttl) if dns_ttl else None
+        self.session = shared_session(
+            bypass_robots, http_cache, delay, pool_maxsize or workers * Scheduler.max_parallel,
+            pool_connections, self.dns)
+        self.executor = ThreadPoolExecutor(max_workers=workers)
+        self._ids = itertools.count(1)
+        self._closed = False
+        logger.debug("Capture service started with %d workers.", workers)
+
+    def __repr__(self):
+        return '<CaptureService(workers=%d)>' % self.workers
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def submit_page(self, url, project_name=None):
+        """Queues the capture of the page at `url` and the files it needs,
+        returns a future of its :class:`CaptureResult`."""
+        return self.submit(url, 'page', project_name)
+
+    def submit_site(self, url, project_name=None, max_pages=None, max_bytes=None, max_seconds=None):
+        """Queues the capture of every page of the site at `url`, within
+        the budget if any (see :class:`pywebcopy.frontier.Budget`), returns
+        a future of its :class:`CaptureResult`."""
+        budget = (max_pages, max_bytes, max_seconds)
+        return self.submit(url, 'site', project_name, budget)
+
+    def submit(self, url, kind='page', project_name=None, budget=None):
+        if kind not in KINDS:
+            raise ValueError("Kind must be one of %r, got %r" % (KINDS, kind))
+        if self._closed:
+            raise RuntimeError("Capture service is closed.")
+        job = next(self._ids)
+        if not project_name:
+            project_name = '%s_%d' % ('_'.join(
+                secure_filename(str(x)) for x in get_host(url) if x), job)
+        return self.executor.submit(self._capture, job, url, kind, project_name, budget)
+
+    def _scheduler(self, kind, budget):
+        if kind == 'page':
+            ans = default_scheduler()
+        elif budget and any(v is not None for v in budget):
+            ans = frontier_crawler_scheduler('opic', *budget)
+        else:
+            ans = crawler_scheduler()
+        # the files of a page are fetched in batches once it is written
+        ans.speculative_paths = True
+        return ans
+
+    def _capture(self, job, url, kind, project_name, budget):
+        start = time.time()
+        config = get_config(url, self.project_folder, project_name,
+                            self.bypass_robots, delay=self.delay).freeze()
+        scheduler = self._scheduler(kind, budget)
+        factory = WebPage if kind == 'page' else Crawler
+        page = factory(self.session, config, scheduler, Context.from_config(config))
+        # the scheduler fetches the page itself, no `get` beforehand
+        filepath = page.save_complete()
+        files = nbytes = 0
+        # redirects index one file under several urls
+        for path in set(path for _, path in scheduler.index.items()):
+            try:
+                nbytes += os.path.getsize(path)
+            except (OSError, TypeError):
+                continue
+            files += 1
+        stats = {'resources': len(scheduler.index), 'files': files,
+                 'bytes': nbytes, 'seconds': time.time() - start}
+        logger.info("Captured [%s] into [%s]: %r", url, config.project_folder, stats)
+        return CaptureResult(job, url, kind, config.project_folder, filepath, stats)
+
+    def close(self, wait=True):
+        """Stops accepting jobs, waits for the running ones if `wait` and
+        releases the connections."""
+        if self._closed:
+            return
+        self._closed = True
+        self.executor.shutdown(wait=wait)
+        self.session.close()
@@ -2,9 +2,9 @@
 ..todo::
 
 1. Add domain-specific / global delays.
-2. Add domain blocking, * pattern blocking.
 """
 
+import threading
 import time
 import contextlib
 import logging
@@ -79,11 +79,20 @@ class Session(requests.Session):
         self.follow_robots_txt = False
         self.robots_registry = {}
         self.domain_blacklist = set()
+        #: optional :class:`pywebcopy.scope.Scope` every request must pass
+        self.scope = None
+        #: optional :class:`pywebcopy.hedge.Hedger` sending a second copy
+        #: of the requests which are slow to get their headers.
+        self.hedge = None
         self.logger = logger.getChild(self.__class__.__name__)
         # Micro-caches for the hot path
         self._ua_cached = self.headers.get('User-Agent', '*')
-        self._last_host = None
-        self._last_rules = None
+        #: (host, rules) of the last request, one tuple so that threads
+        #: never read the host of one request with the rules of another
+        self._last = (None, None)
+        #: one lock per robots.txt url, each file is fetched once even
+        #: when many threads ask for it at the same time
+        self._robots_locks = {}
 
     def enable_http_cache(self):
         try:
@@ -96,6 +105,28 @@ class Session(requests.Session):
         self.mount('https://', cachecontrol.CacheControlAdapter())
         self.mount('http://', cachecontrol.CacheControlAdapter())
 
+    def enable_hedging(self, ratio=0.05, **params):
+        """Hedges the slow requests with at most `ratio` extra requests,
+        see :class:`pywebcopy.hedge.Hedger` for the `params`."""
+        from .hedge import Hedger
+        self.hedge = Hedger(ratio, **params)
+        for prefix in ('http://', 'https://'):
+            self.hedge.attach(self.get_adapter(prefix))
+        return self.hedge
+
+    def close(self):
+        if self.hedge is not None:
+            self.hedge.close(wait=False)
+        super(Session, self).close()
+
+    def block_domain(self, pattern):
+        """Blocks requests to hosts matching a scope host rule, e.g.
+        `ads.example.com` (with subdomains), `*.example.com` or `=example.com`."""
+        if self.scope is None:
+            from .scope import Scope
+            self.scope = Scope()
+        self.scope.deny(pattern)
+
     def set_follow_robots_txt(self, b):
         """Set whether to follow the robots.txt rules or not.
         """
@@ -178,20 +209,27 @@ class Session(requests.Session):
             self.logger.error("Blocking request to a blacklisted domain: %r", n)
             return False
 
+        if self.scope is not None:
+            allowed, rule = self.scope.classify(request.url)
+            if not allowed:
+                self.logger.error("Blocking request to [%s] out of scope by rule: %r", request.url, rule)
+                return False
+
         #: if set to not follow the robots.txt
         if not self.follow_robots_txt:
             return True
 
         # Per-host rules fast path
-        if n == self._last_host and self._last_rules is not None:
-            access_rules = self._last_rules
-        else:
+        last_host, access_rules = self._last
+        if n != last_host or access_rules is None:
             robots_url = s + '://' + n + '/robots.txt'
             access_rules = self.robots_registry.get(robots_url)
             if access_rules is None:
-                access_rules = self.load_rules_from_url(robots_url, timeout)
-            self._last_host = n
-            self._last_rules = access_rules
+                with self._robots_locks.setdefault(robots_url, threading.Lock()):
+                    access_rules = self.robots_registry.get(robots_url)
+                    if access_rules is None:
+                        access_rules = self.load_rules_from_url(robots_url, timeout)
+            self._last = (n, access_rules)
 
         if access_rules is None:  # error - everybody welcome
             return True
@@ -225,16 +263,19 @@ class Session(requests.Session):
 
         # Lazy formatting
         self.logger.info('[%s] [%s]', request.method, request.url)
+        if self.hedge is not None:
+            return self.hedge.send(super(Session, self).send, request, **kwargs)
         return super(Session, self).send(request, **kwargs)
 
     @classmethod
     def from_config(cls, config):
         """Creates a new instance of a Session object using the config object."""
+        config = config.freeze()
         ans = cls()
-        ans.headers = config.get('http_headers', default_headers())
-        ans.follow_robots_txt = not config.get('bypass_robots')
-        ans.delay = config.get_delay()
-        if config.get('http_cache'):
+        ans.headers = CaseInsensitiveDict(config.http_headers or default_headers())
+        ans.follow_robots_txt = not config.bypass_robots
+        ans.delay = config.delay
+        if config.http_cache:
             ans.enable_http_cache()
         # XXX I don't know if it will work?
         # ans.headers.update(
@@ -0,0 +1,195 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Near-duplicate page detection with 64-bit SimHash fingerprints.
+
+Large sites serve the same content under many urls (sort orders, session
+ids, print views). A SimHash of the visible text changes in only a few bits
+for such variants, so pages whose fingerprints are within `distance` bits
+of an already crawled page are flagged as near-duplicates.
+
+The index splits a fingerprint into `bands` blocks and keeps one table per
+block. Two fingerprints within `distance < bands` bits must agree exactly on
+at least one block (pigeonhole), so a lookup only compares the few
+candidates sharing a block instead of every page seen.
+
+Usage::
+
+    dedup = NearDuplicates(policy='skip_children')
+    scheduler.dedup = dedup
+"""
+import hashlib
+import logging
+import re
+import threading
+from array import array
+
+__all__ = ['simhash', 'simhash_digests', 'fingerprint', 'hamming', 'SimHashIndex', 'NearDuplicates', 'POLICIES',
+           'MIN_SHINGLES']
+
+logger = logging.getLogger(__name__)
+
+#: skip_children - the page is saved but its links are left absolute, so
+#:                 nothing linked from it is crawled (leaf mode).
+#: skip          - the page is not stored; a small redirect to the local copy
+#:                 of the original page is written in its place.
+POLICIES = ('skip_children', 'skip')
+
+_dropped = re.compile(br'(?is)<(script|style|noscript|template)\b.*?</\1\s*>|<!--.*?-->')
+_tags = re.compile(br'(?s)<[^>]*>')
+_words = re.compile(r'\w+', re.U)
+
+#: pages with fewer shingles than this (framesets, image only pages, script
+#: shells) get no fingerprint, all of them would be near-duplicates.
+MIN_SHINGLES = 8
+
+
+try:
+    _popcount = int.bit_count
+except AttributeError:  # python < 3.10
+    def _popcount(x):
+        return bin(x).count('1')
+
+
+def simhash_digests(digests):
+    """Returns the 64-bit SimHash of concatenated 8-byte feature hashes.
+
+    The votes are not counted bit by bit in python: every byte column is
+    sliced out and read as one big integer, and the votes of bit `k` are the
+    popcount of that integer masked with bit `k` set in every byte. That is
+    64 linear passes done in C, about 0.2ms for 1700 features.
+    """
+    total = len(digests) >> 3
+    if not total:
+        return 0
+    masks = [int.from_bytes(bytes((1 << k,)) * total, 'little') for k in range(8)]
+    ans = 0
+    for pos in range(8):
+        column = int.from_bytes(digests[pos::8], 'little')
+        for k in range(8):
+            if _popcount(column & masks[k]) * 2 > total:
+                ans |= 1 << (pos * 8 + k)
+    return ans
+
+
+def simhash(features):
+    """Returns the 64-bit SimHash of an iterable of `bytes` features using
+    a stable hash (blake2b), comparable across processes."""
+    blake2b = hashlib.blake2b
+    return simhash_digests(b''.join(blake2b(f, digest_size=8).digest() for f in features))
+
+
+def fingerprint(html, encoding='utf-8', size=3, min_shingles=MIN_SHINGLES):
+    """SimHash of the `size`-word shingles of the visible text of an html
+    document (`bytes`), None if it has fewer than `min_shingles` of them.
+
+    The shingles are hashed with the builtin `hash` of word tuples, all of
+    it runs in C through `map` and `zip`. String hashes are randomised per
+    interpreter so these fingerprints are only comparable within one
+    process; use :func:`simhash` for persisted fingerprints.
+    """
+    html = _dropped.sub(b' ', html)
+    text = _tags.sub(b' ', html).decode(encoding or 'utf-8', 'replace')
+    words = _words.findall(text.lower())
+    if max(1, len(words) - size + 1) < min_shingles or not words:
+        return None
+    if len(words) < size:
+        words = [' '.join(words)] if words else []
+        size = 1
+    grams = zip(*(words[i:] for i in range(size)))
+    return simhash_digests(array('q', map(hash, grams)).tobytes())
+
+
+def hamming(a, b):
+    return _popcount(a ^ b)
+
+
+class SimHashIndex(object):
+    """Banded index of 64-bit fingerprints.
+
+    :param distance: max hamming distance of near-duplicates, must be
+        smaller than `bands`.
+    :param bands: number of equal blocks the fingerprint is split into.
+    """
+
+    def __init__(self, distance=3, bands=4):
+        if not 0 <= distance < bands or 64 % bands:
+            raise ValueError("Need 0 <= distance < bands and bands dividing 64, "
+                             "got distance=%r bands=%r" % (distance, bands))
+        self.distance = distance
+        self.bands = bands
+        self.width = 64 // bands
+        self.tables = [dict() for _ in range(bands)]
+        self.lock = threading.Lock()
+        self.size = 0
+
+    def __len__(self):
+        return self.size
+
+    def _keys(self, fp):
+        mask = (1 << self.width) - 1
+        return [(fp >> (i * self.width)) & mask for i in range(self.bands)]
+
+    def _find(self, fp, keys):
+        for table, key in zip(self.tables, keys):
+            for other, value in table.get(key, ()):
+                if hamming(fp, other) <= self.distance:
+                    return value
+        return None
+
+    def query(self, fp):
+        """Returns the value stored with a near-duplicate of `fp` or None."""
+        with self.lock:
+            return self._find(fp, self._keys(fp))
+
+    def add(self, fp, value):
+        keys = self._keys(fp)
+        with self.lock:
+            for table, key in zip(self.tables, keys):
+                table.setdefault(key, []).append((fp, value))
+            self.size += 1
+
+    def query_or_add(self, fp, value):
+        """Atomically returns the value of a near-duplicate, or stores
+        `(fp, value)` and returns None if there is none."""
+        keys = self._keys(fp)
+        with self.lock:
+            found = self._find(fp, keys)
+            if found is not None:
+                return found
+            for table, key in zip(self.tables, keys):
+                table.setdefault(key, []).append((fp, value))
+            self.size += 1
+            return None
+
+
+class NearDuplicates(object):
+    """Scheduler plug-in which flags html pages that are near-duplicates of
+    an earlier page of the crawl (see :attr:`SchedulerBase.dedup`).
+
+    :param policy: one of :data:`POLICIES`.
+    :param distance: max differing bits out of 64.
+    :param bands: blocks of the LSH index.
+    :param min_shingles: pages with less text are never deduplicated.
+    """
+
+    def __init__(self, policy='skip_children', distance=3, bands=4, min_shingles=MIN_SHINGLES):
+        if policy not in POLICIES:
+            raise ValueError("Policy must be one of %r, got %r" % (POLICIES, policy))
+        self.policy = policy
+        self.min_shingles = min_shingles
+        self.index = SimHashIndex(distance, bands)
+        self.duplicates = []  # (url, url of the original)
+
+    def check(self, resource, source, encoding):
+        """Returns `(url, filepath)` of the page `resource` duplicates, or
+        None after registering the resource as an original. Pages with too
+        little text to tell them apart are neither."""
+        fp = fingerprint(source, encoding, min_shingles=self.min_shingles)
+        if fp is None:
+            return None
+        original = self.index.query_or_add(fp, (resource.url, resource.filepath))
+        if original is not None:
+            self.duplicates.append((resource.url, original[0]))
+            logger.info("Near-duplicate page [%s] of [%s]", resource.url, original[0])
+        return original
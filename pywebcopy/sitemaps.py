@@ -0,0 +1,256 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Sitemap discovery and streaming ingestion for seeding the crawl frontier.
+
+Following links reaches a page `d` levels deep only after `d` sequential
+round trips. Sitemaps list the urls of a site up front, so the deep pages
+can be queued right away::
+
+    crawler.get(url)
+    seed_frontier(crawler)          # robots.txt `Sitemap:` lines or /sitemap.xml
+    crawler.save_complete()
+
+The sitemaps are read with an incremental xml parser which discards every
+entry once it has been handled, so a 50,000 url sitemap costs as little
+memory as a 10 url one. Gzipped sitemaps are recognised by their magic
+bytes and sitemap indexes are followed up to `max_depth` levels.
+
+Seeds are ranked by the sitemap `<priority>` (0.5 if missing) scaled up for
+recently modified pages, so with a budget the fresh and important pages
+are fetched first (see :mod:`pywebcopy.frontier`).
+"""
+import calendar
+import gzip
+import io
+import logging
+import re
+import time
+from collections import namedtuple
+
+from lxml import etree
+from six.moves.urllib.parse import urljoin
+from six.moves.urllib.parse import urlsplit
+
+__all__ = ['SitemapEntry', 'discover', 'iter_sitemap', 'walk', 'parse_lastmod',
+           'seed_priority', 'seed_frontier', 'SitemapError']
+
+logger = logging.getLogger(__name__)
+
+#: upper bound of an uncompressed sitemap as per sitemaps.org (50MB)
+MAX_SITEMAP_BYTES = 50 * 1024 * 1024
+
+SitemapEntry = namedtuple('SitemapEntry', 'kind loc lastmod priority changefreq')
+SitemapEntry.__doc__ = """An url (`kind='url'`) or a child sitemap (`kind='sitemap'`),
+`lastmod` is a unix timestamp or None, `priority` a float or None."""
+
+
+class SitemapError(ValueError):
+    """Malformed or oversized sitemap."""
+
+
+class _Limited(io.RawIOBase):
+    """Raises once more than `limit` bytes were read, guards against
+    compression bombs."""
+
+    def __init__(self, fp, limit):
+        self.fp = fp
+        self.limit = limit
+        self.count = 0
+
+    def readable(self):
+        return True
+
+    def readinto(self, b):
+        data = self.fp.read(len(b))
+        n = len(data)
+        self.count += n
+        if self.count > self.limit:
+            raise SitemapError("Sitemap is larger than %d bytes." % self.limit)
+        b[:n] = data
+        return n
+
+
+def _open(fp, limit):
+    """Returns a reader of the uncompressed contents of `fp`."""
+    buf = fp if hasattr(fp, 'peek') else io.BufferedReader(fp)
+    if buf.peek(2)[:2] == b'\x1f\x8b':
+        buf = gzip.GzipFile(fileobj=buf, mode='rb')
+    return _Limited(buf, limit)
+
+
+_w3c = re.compile(
+    r'^\s*(\d{4})(?:-(\d{2})(?:-(\d{2})(?:[T ](\d{2}):(\d{2})(?::(\d{2})(?:\.\d+)?)?'
+    r'\s*(Z|[+-]\d{2}:?\d{2})?)?)?)?\s*$')
+
+
+def parse_lastmod(text):
+    """Unix timestamp of a W3C datetime (`2004-12-23`, `2004-12-23T18:00:15+00:00`)
+    or None if it can not be read."""
+    if not text:
+        return None
+    m = _w3c.match(text)
+    if m is None:
+        return None
+    year, month, day, hour, minute, second, tz = m.groups()
+    try:
+        ts = calendar.timegm((int(year), int(month or 1), int(day or 1),
+                              int(hour or 0), int(minute or 0), int(second or 0), 0, 0, 0))
+    except (ValueError, OverflowError):
+        return None
+    if tz and tz != 'Z':
+        sign = -1 if tz[0] == '+' else 1
+        tz = tz[1:].replace(':', '')
+        ts += sign * (int(tz[:2]) * 3600 + int(tz[2:]) * 60)
+    return float(ts)
+
+
+def _local(tag):
+    return tag.rsplit('}', 1)[-1] if isinstance(tag, str) else ''
+
+
+def iter_sitemap(fp, max_bytes=MAX_SITEMAP_BYTES):
+    """Yields the :class:`SitemapEntry` of a sitemap or sitemap index read
+    from the binary file object `fp` (optionally gzipped)."""
+    source = _open(fp, max_bytes)
+    context = etree.iterparse(
+        source, events=('end',), resolve_entities=False, no_network=True,
+        load_dtd=False, huge_tree=False, recover=True)
+    try:
+        for _, elem in context:
+            kind = _local(elem.tag)
+            if kind not in ('url', 'sitemap'):
+                continue
+            fields = {}
+            for child in elem:
+                name = _local(child.tag)
+                if name in ('loc', 'lastmod', 'priority', 'changefreq') and child.text:
+                    fields[name] = child.text.strip()
+            # drop the handled entry and its already parsed siblings
+            elem.clear()
+            while elem.getprevious() is not None:
+                del elem.getparent()[0]
+            loc = fields.get('loc')
+            if not loc:
+                continue
+            try:
+                priority = float(fields['priority']) if 'priority' in fields else None
+            except ValueError:
+                priority = None
+            yield SitemapEntry(kind, loc, parse_lastmod(fields.get('lastmod')),
+                               priority, fields.get('changefreq'))
+    except etree.XMLSyntaxError as e:
+        raise SitemapError("Malformed sitemap: %s" % e)
+    finally:
+        del context
+
+
+def _robots_sitemaps(session, robots_url, timeout):
+    parser = getattr(session, 'robots_registry', {}).get(robots_url)
+    if parser is not None and hasattr(parser, 'site_maps'):
+        return list(parser.site_maps() or ())
+    try:
+        response = session.get(robots_url, timeout=timeout)
+    except Exception as e:
+        logger.debug("Failed to fetch %s: %r", robots_url, e)
+        return []
+    if response.status_code != 200:
+        return []
+    out = []
+    for line in response.text.splitlines():
+        key, sep, value = line.partition(':')
+        if sep and key.strip().lower() == 'sitemap' and value.strip():
+            out.append(urljoin(robots_url, value.strip()))
+    return out
+
+
+def discover(session, base_url, timeout=None):
+    """Returns the sitemap urls announced in the robots.txt of the host of
+    `base_url`, or its `/sitemap.xml` if there are none."""
+    parts = urlsplit(base_url)
+    origin = '%s://%s' % (parts.scheme, parts.netloc)
+    return _robots_sitemaps(session, origin + '/robots.txt', timeout) or [origin + '/sitemap.xml']
+
+
+def walk(session, sitemap_urls, max_depth=2, max_urls=None, allow=None, timeout=None,
+         max_bytes=MAX_SITEMAP_BYTES):
+    """Yields the url entries of the sitemaps, following sitemap indexes
+    breadth first up to `max_depth` levels.
+
+    :param allow: optional callable deciding which page urls are kept,
+        e.g. `scope.allows`.
+    """
+    queue = [(url, 0) for url in sitemap_urls]
+    seen = set(sitemap_urls)
+    count = 0
+    while queue:
+        url, depth = queue.pop(0)
+        try:
+            response = session.get(url, stream=True, timeout=timeout)
+        except Exception as e:
+            logger.error("Failed to fetch sitemap [%s]: %r", url, e)
+            continue
+        if response.status_code != 200:
+            logger.info("Sitemap [%s] answered %s.", url, response.status_code)
+            response.close()
+            continue
+        raw = response.raw
+        if hasattr(raw, 'decode_content'):
+            raw.decode_content = True
+        try:
+            for entry in iter_sitemap(raw, max_bytes):
+                if entry.kind == 'sitemap':
+                    if depth < max_depth and entry.loc not in seen:
+                        seen.add(entry.loc)
+                        queue.append((entry.loc, depth + 1))
+                    continue
+                if allow is not None and not allow(entry.loc):
+                    continue
+                yield entry
+                count += 1
+                if max_urls is not None and count >= max_urls:
+                    return
+        except SitemapError as e:
+            logger.error("Skipping the rest of sitemap [%s]: %s", url, e)
+        finally:
+            response.close()
+
+
+def seed_priority(entry, now=None, half_life=30 * 86400.0):
+    """Frontier cash of a sitemap entry, its `<priority>` (default 0.5)
+    doubled for a page modified just now and halving every `half_life`
+    seconds of age back to the plain priority."""
+    priority = 0.5 if entry.priority is None else min(1.0, max(0.0, entry.priority))
+    if entry.lastmod is None:
+        return priority
+    now = time.time() if now is None else now
+    age = max(0.0, now - entry.lastmod)
+    return priority * (1.0 + 0.5 ** (age / half_life))
+
+
+def seed_frontier(crawler, sitemap_urls=None, max_urls=None, max_depth=2, timeout=None,
+                  half_life=30 * 86400.0, now=None):
+    """Queues the pages listed in the sitemaps of the crawled site in the
+    :class:`pywebcopy.frontier.FrontierScheduler` of `crawler`.
+
+    The pages go through the same validation as discovered links (base
+    url or scope, traps). Returns the number of queued pages.
+    """
+    scheduler = crawler.scheduler
+    if not hasattr(scheduler, 'seed'):
+        raise TypeError("Seeding needs a FrontierScheduler, got %r" % scheduler)
+    session, config, context = crawler.session, crawler.config, crawler.context
+    if sitemap_urls is None:
+        sitemap_urls = discover(session, context.base_url, timeout)
+    # the scheduler validates the pages again, the scope only saves
+    # creating resources for urls which would be refused anyway
+    allow = scheduler.scope.allows if scheduler.scope is not None else None
+
+    queued = 0
+    for entry in walk(session, sitemap_urls, max_depth, max_urls, allow, timeout):
+        resource = scheduler.get_handler(
+            'a', session, config, scheduler, context.create_new_from_url(entry.loc))
+        if scheduler.seed(resource, seed_priority(entry, now, half_life)):
+            queued += 1
+    logger.info("Seeded %d pages from %d sitemaps.", queued, len(sitemap_urls))
+    return queued
@@ -0,0 +1,123 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""Fixtures shared by the test modules."""
+import io
+import os
+import threading
+import time
+from http.server import BaseHTTPRequestHandler
+from http.server import ThreadingHTTPServer
+
+from requests import Response
+
+
+class CountingReader(io.BytesIO):
+    """Response body recording how many bytes were read from it."""
+
+    def __init__(self, data):
+        super(CountingReader, self).__init__(data)
+        self.count = 0
+
+    def read(self, n=-1):
+        data = super(CountingReader, self).read(n)
+        self.count += len(data)
+        return data
+
+
+class FakeSession(object):
+    """Serves the bodies of `files` (url -> str or bytes) with the extra
+    `headers` of each url, unknown urls are 404. Records the requested
+    urls and the body of every response in `raws`."""
+
+    def __init__(self, files, headers=None):
+        self.files = files
+        self.headers = headers or {}
+        self.requested = []
+        self.raws = {}
+
+    def get(self, url, **kwargs):
+        self.requested.append(url)
+        response = Response()
+        response.url = url
+        body = self.files.get(url)
+        if not isinstance(body, (bytes, type(None))):
+            body = body.encode('utf-8')
+        response.status_code = 200 if body is not None else 404
+        response.reason = 'OK' if body is not None else 'Not Found'
+        response.headers['Content-Type'] = 'text/plain' if url.endswith('.txt') else 'text/html'
+        response.headers.update(self.headers.get(url, {}))
+        response.raw = self.raws[url] = CountingReader(body if body is not None else b'not found')
+        return response
+
+
+class SiteHandler(BaseHTTPRequestHandler):
+    """Answers the requests to a :class:`LocalSite`."""
+    protocol_version = 'HTTP/1.1'
+
+    def do_GET(self):
+        site = self.server
+        with site.lock:
+            site.hits.append(self.path)
+            site.clients.add(self.client_address)
+            # the first request to a stalling path is stuck
+            stall = self.path.startswith('/stall') and site.hits.count(self.path) == 1
+        if stall:
+            time.sleep(site.stall)
+        if self.path in site.slow:
+            time.sleep(site.slow[self.path])
+        if self.path in site.redirects:
+            self.send_response(302)
+            self.send_header('Location', site.redirects[self.path])
+            self.send_header('Content-Length', '0')
+            self.end_headers()
+            return
+        if site.pages is None:
+            body, ctype = b'ok', 'text/plain'
+        else:
+            body = site.pages.get(self.path)
+            ctype = site.types.get(os.path.splitext(self.path)[1], 'text/html')
+        self.send_response(200 if body is not None else 404)
+        body = body if body is not None else b'not found'
+        self.send_header('Content-Type', ctype)
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    do_POST = do_GET
+
+    def log_message(self, *args):
+        pass
+
+
+class LocalSite(ThreadingHTTPServer):
+    """Local http server of the `pages` (path -> bytes) typed by extension
+    with `types`, unknown paths are 404; without `pages` every path is
+    served as ``ok``. Records the path of every request in `hits` and the
+    client in `clients`. A path in `slow` is delayed by that many seconds,
+    the first request to a path starting with ``/stall`` by `stall`, and
+    a path in `redirects` is redirected to the location given.
+    """
+    daemon_threads = True
+
+    def __init__(self, pages=None, types=None):
+        ThreadingHTTPServer.__init__(self, ('127.0.0.1', 0), SiteHandler)
+        self.pages = pages
+        self.types = types or {}
+        self.lock = threading.Lock()
+        self.hits = []
+        self.clients = set()
+        self.slow = {}
+        self.redirects = {}
+        self.stall = 1.0
+        threading.Thread(target=self.serve_forever, daemon=True).start()
+
+    def handle_error(self, request, client_address):
+        # closed keep-alive connections are no errors
+        pass
+
+    def url(self, host='127.0.0.1'):
+        return 'http://%s:%d/' % (host, self.server_address[1])
+
+    def close(self):
+        self.shutdown()
+        self.server_close()
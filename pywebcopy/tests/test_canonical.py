@@ -0,0 +1,110 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import io
+import shutil
+import tempfile
+import unittest
+
+from pywebcopy.canonical import Canonicals
+from pywebcopy.configs import get_config
+from pywebcopy.core import Crawler
+from pywebcopy.parsers import Prefixed
+from pywebcopy.parsers import head_urls
+from pywebcopy.parsers import read_head
+from pywebcopy.schedulers import crawler_scheduler
+from pywebcopy.tests.support import FakeSession
+
+BASE = 'http://x.org/'
+
+
+def page(canonical, body=''):
+    return ('<html><head><link rel="canonical" href="%s"></head>'
+            '<body>%s%s</body></html>' % (canonical, body, ' filler' * 2000)).encode()
+
+
+class TestHead(unittest.TestCase):
+    def test_head_urls(self):
+        head = (b'<html><head><meta property="og:url" content="/og">'
+                b'<link rel="Alternate Canonical" href=" /c "></head>'
+                b'<body><link rel="canonical" href="/late"></body></html>')
+        self.assertEqual(head_urls(head), ('/c', '/og'))
+        self.assertEqual(head_urls(b'<html><body><link rel="canonical" href="/b">'), (None, None))
+
+    def test_read_head_puts_back(self):
+        data = page('/c')
+        source = io.BytesIO(data)
+        head = read_head(source)
+        self.assertLess(len(head), len(data))
+        self.assertIn(b'</head>', head)
+        reader = Prefixed(head, source)
+        self.assertEqual(reader.read(10) + reader.read(), data)
+
+
+class TestCrawl(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def crawl(self, files, policy, headers=None):
+        config = get_config(BASE, self.folder, 'canonical', bypass_robots=True)
+        session = FakeSession(files, headers)
+        scheduler = crawler_scheduler()
+        scheduler.canonicals = Canonicals(policy)
+        crawler = Crawler(session, config, scheduler, config.create_context())
+        crawler.get(BASE)
+        crawler.save_complete()
+        return session, scheduler
+
+    def variants(self):
+        files = {BASE: ('<html><body>%s<a href="item">canonical</a></body></html>' % ''.join(
+            '<a href="item?ref=%d">v</a>' % i for i in range(3))).encode()}
+        for i in range(3):
+            files[BASE + 'item?ref=%d' % i] = page('/item', '<a href="child%d.html">c</a>' % i)
+        for i in range(3):
+            files[BASE + 'child%d.html' % i] = b'<html><body>child</body></html>'
+        return files
+
+    def test_children_are_not_expanded_again(self):
+        session, scheduler = self.crawl(self.variants(), 'skip_children')
+        self.assertIn(BASE + 'child0.html', session.requested)
+        self.assertNotIn(BASE + 'child1.html', session.requested)
+        self.assertNotIn(BASE + 'child2.html', session.requested)
+        # the canonical url is served by the first variant
+        self.assertNotIn(BASE + 'item', session.requested)
+        self.assertEqual(scheduler.index.get_entry(BASE + 'item'),
+                         scheduler.index.get_entry(BASE + 'item?ref=0'))
+        self.assertEqual(len(scheduler.canonicals.duplicates), 2)
+
+    def test_skip_downloads_only_the_head(self):
+        files = self.variants()
+        session, scheduler = self.crawl(files, 'skip')
+        url = BASE + 'item?ref=1'
+        self.assertLess(session.raws[url].count, len(files[url]))
+        with open(scheduler.index.get_entry(url), 'rb') as fh:
+            stub = fh.read()
+        self.assertIn(b'http-equiv="refresh"', stub)
+        self.assertLess(len(stub), 512)
+
+    def test_content_location_and_foreign_hosts(self):
+        files = {BASE: b'<html><body><a href="a?x=1">1</a><a href="a?x=2">2</a><a href="b">b</a></body></html>',
+                 BASE + 'a?x=1': b'<html><body><a href="c1">c</a></body></html>',
+                 BASE + 'a?x=2': b'<html><body><a href="c2">c</a></body></html>',
+                 BASE + 'b': page('http://evil.org/a', '<a href="c3">c</a>')}
+        headers = {BASE + 'a?x=1': {'Content-Location': '/a'}, BASE + 'a?x=2': {'Content-Location': '/a'}}
+        session, scheduler = self.crawl(files, 'skip_children', headers)
+        self.assertIn(BASE + 'c1', session.requested)
+        self.assertNotIn(BASE + 'c2', session.requested)
+        self.assertIn(BASE + 'c3', session.requested)
+
+    def test_canonical_link_is_not_fetched(self):
+        files = {BASE: page(BASE + 'home')}
+        session, scheduler = self.crawl(files, 'skip_children')
+        self.assertNotIn(BASE + 'home', session.requested)
+        with open(scheduler.index.get_entry(BASE), 'rb') as fh:
+            self.assertIn(b'href="http://x.org/home"', fh.read())
+
+
+if __name__ == '__main__':
+    unittest.main()
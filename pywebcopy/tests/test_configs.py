@@ -47,6 +47,47 @@ class TestConfigs(unittest.TestCase):
                          configs.default_headers(**configs.safe_http_headers))
 
 
+class TestConfigSnapshot(unittest.TestCase):
+    def test_values_and_get(self):
+        ans = configs.get_config('http://localhost:5000', delay=2)
+        ans.__setitem__('Encoding', 'utf-8')
+        ans.__setitem__('custom_key', 1)
+        snap = ans.freeze()
+        self.assertIsInstance(snap, configs.ConfigSnapshot)
+        self.assertIs(snap.freeze(), snap)
+        self.assertEqual(snap.project_url, 'http://localhost:5000')
+        self.assertEqual(snap.delay, 2)
+        self.assertEqual(snap.encoding, 'utf-8')
+        self.assertEqual(snap.get('OVERWRITE'), False)
+        self.assertEqual(snap.get('custom_key'), 1)
+        self.assertEqual(snap.get('missing', 'x'), 'x')
+        self.assertTrue(snap.is_set())
+
+    def test_read_only_and_detached(self):
+        ans = configs.get_config('http://localhost:5000')
+        snap = ans.freeze()
+        with self.assertRaises(configs.ConfigError):
+            snap.overwrite = True
+        ans.set_overwrite(True)
+        self.assertFalse(snap.overwrite)
+        self.assertTrue(ans.freeze().overwrite)
+
+    def test_resources_share_snapshot(self):
+        ans = configs.get_config('http://localhost:5000')
+        page = ans.create_page()
+        self.assertIs(page.config, ans)
+        self.assertIsInstance(page.settings, configs.ConfigSnapshot)
+        child = page.__class__(page.session, page.config, page.scheduler, page.context)
+        self.assertIs(child.settings, page.settings)
+        # the handler stays usable, later resources see the change
+        page.config.set_overwrite(True)
+        self.assertTrue(page.config['overwrite'])
+        self.assertFalse(page.settings.overwrite)
+        self.assertTrue(ans.freeze().overwrite)
+        del ans['overwrite']
+        self.assertFalse(ans.freeze().overwrite)
+
+
 class TestGetConfigFactory(unittest.TestCase):
     def test_simple(self):
         ans = configs.get_config('http://localhost:5000')
@@ -0,0 +1,235 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import os
+import shutil
+import socket
+import tempfile
+import threading
+import time
+import unittest
+
+from pywebcopy.daemon import Daemon
+from pywebcopy.daemon import DaemonClient
+from pywebcopy.daemon import FairPool
+from pywebcopy.daemon import Job
+from pywebcopy.tests.support import LocalSite
+from pywebcopy.tests.test_service import PAGES
+from pywebcopy.tests.test_service import TYPES
+
+
+class TestFairPool(unittest.TestCase):
+    def setUp(self):
+        self.pool = FairPool(workers=1, quantum=1000, task_cost=0)
+        self.order = []
+        self.gate = threading.Event()
+
+    def tearDown(self):
+        self.gate.set()
+        self.pool.close()
+
+    def task(self, name, cost=1000):
+        self.order.append(name)
+        return cost
+
+    def hold(self):
+        """Keeps the worker busy until the gate opens, so that the tasks
+        queued meanwhile compete for it."""
+        blocker = Job(0, 'blocker')
+        self.pool.submit(blocker, self.gate.wait)
+        return blocker
+
+    def test_weights_are_honoured(self):
+        blocker = self.hold()
+        light, heavy = Job(1, 'light', weight=1), Job(2, 'heavy', weight=3)
+        for _ in range(40):
+            self.pool.submit(light, self.task, 'light')
+            self.pool.submit(heavy, self.task, 'heavy')
+        self.gate.set()
+        self.assertTrue(light.done.wait(10) and heavy.done.wait(10))
+        first = self.order[:20]
+        self.assertEqual(first.count('heavy'), 15)
+        self.assertEqual(first.count('light'), 5)
+        self.assertEqual(blocker.state, 'done')
+        self.assertEqual(light.state, 'done')
+
+    def test_large_files_are_charged(self):
+        self.hold()
+        big, small = Job(1, 'big'), Job(2, 'small')
+        for _ in range(10):
+            self.pool.submit(big, self.task, 'big', 4000)
+            self.pool.submit(small, self.task, 'small', 1000)
+        self.gate.set()
+        self.assertTrue(big.done.wait(10) and small.done.wait(10))
+        # same bandwidth for both, so four small files per big one
+        first = self.order[:10]
+        self.assertEqual(first.count('big'), 2)
+
+    def test_small_job_is_not_starved(self):
+        self.hold()
+        huge = Job(1, 'huge')
+        for _ in range(200):
+            self.pool.submit(huge, self.task, 'huge')
+        small = Job(2, 'small')
+        for _ in range(3):
+            self.pool.submit(small, self.task, 'small')
+        self.gate.set()
+        self.assertTrue(small.done.wait(10))
+        self.assertLessEqual(self.order.index('small') + 3, 8)
+        self.assertTrue(huge.done.wait(10))
+
+    def test_share_of_workers(self):
+        pool = FairPool(workers=4)
+        try:
+            a, b = Job(1, 'a', weight=1), Job(2, 'b', weight=3)
+            pool.ring.extend([a, b])
+            a.queue.append(None)
+            b.queue.append(None)
+            self.assertEqual(pool.share(a), 1)
+            self.assertEqual(pool.share(b), 3)
+            b.queue.clear()
+            self.assertEqual(pool.share(a), 4)
+            a.queue.clear()
+        finally:
+            pool.ring[:] = []
+            pool.close()
+
+    def test_cancel_drops_the_queue(self):
+        self.hold()
+        job = Job(1, 'job')
+        for _ in range(5):
+            self.pool.submit(job, self.task, 'job')
+        self.assertTrue(self.pool.cancel(job))
+        self.assertEqual(job.state, 'cancelled')
+        self.assertEqual(job.stats['dropped'], 5)
+        self.assertTrue(job.done.is_set())
+        self.assertFalse(self.pool.submit(job, self.task, 'job'))
+        self.assertFalse(self.pool.cancel(job))
+        self.gate.set()
+        self.pool.close()
+        self.assertEqual(self.order, [])
+
+    def test_invalid_jobs(self):
+        self.assertRaises(ValueError, Job, 1, 'u', kind='book')
+        self.assertRaises(ValueError, Job, 1, 'u', weight=0)
+
+
+class TestDaemon(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.server = LocalSite(PAGES, TYPES)
+        self.base = self.server.url('localhost')
+        self.socket_path = os.path.join(self.folder, 'daemon.sock')
+        self.daemon = Daemon(self.socket_path, self.folder, workers=4)
+        self.thread = threading.Thread(target=self.daemon.serve_forever, daemon=True)
+        self.thread.start()
+
+    def tearDown(self):
+        self.daemon.shutdown()
+        self.daemon.server_close()
+        self.server.close()
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def wait(self, client, job):
+        deadline = time.time() + 30
+        while time.time() < deadline:
+            stats = client.stats(job)
+            if stats['state'] not in ('queued', 'running'):
+                return stats
+            time.sleep(0.05)
+        self.fail("job %d did not finish" % job)
+
+    def test_jobs_over_the_socket(self):
+        with DaemonClient(self.socket_path) as client:
+            site = client.submit(self.base, kind='site', tenant='docs', weight=2)
+            page = client.submit(self.base + 'a.html', tenant='blog')
+            stats = self.wait(client, site)
+            self.assertEqual(stats['state'], 'done')
+            self.assertEqual(stats['tenant'], 'docs')
+            self.assertEqual(stats['pages'], 2)
+            self.assertEqual(stats['files'], 4)
+            self.assertTrue(os.path.isfile(stats['filepath']))
+            # the page, its stylesheet and the image of that
+            self.assertEqual(self.wait(client, page)['files'], 3)
+
+            listed = client.request('list')['jobs']
+            self.assertEqual([j['id'] for j in listed], [site, page])
+            self.assertEqual(client.stats()['workers'], 4)
+
+    def test_budget(self):
+        # a single worker, no file is in flight when the budget runs out
+        path = os.path.join(self.folder, 'single.sock')
+        daemon = Daemon(path, self.folder, workers=1)
+        threading.Thread(target=daemon.serve_forever, daemon=True).start()
+        try:
+            with DaemonClient(path) as client:
+                job = client.submit(self.base, kind='site', max_pages=1)
+                stats = self.wait(client, job)
+        finally:
+            daemon.shutdown()
+            daemon.server_close()
+        self.assertEqual(stats['state'], 'exhausted')
+        self.assertEqual(stats['pages'], 1)
+        self.assertEqual(stats['files'], 1)
+        self.assertEqual(stats['dropped'], 2)
+
+    def test_errors(self):
+        with DaemonClient(self.socket_path) as client:
+            job = client.submit(self.base, max_pages=1)
+            self.wait(client, job)
+
+            with self.assertRaises(RuntimeError):
+                client.submit(self.base, kind='book')
+            with self.assertRaises(RuntimeError):
+                client.cancel(1000)
+            with self.assertRaises(RuntimeError):
+                client.request('rewind')
+            self.assertFalse(client.cancel(job))
+
+    def test_unexpected_errors_are_answered(self):
+        def submit(**request):
+            raise OSError("disk full")
+        self.daemon.submit = submit
+        with DaemonClient(self.socket_path) as client:
+            with self.assertLogs('pywebcopy', 'ERROR'):
+                with self.assertRaisesRegex(RuntimeError, 'disk full'):
+                    client.submit(self.base)
+            self.assertEqual(client.stats()['jobs'], [])
+
+    def test_project_name_stays_in_the_folder(self):
+        with DaemonClient(self.socket_path) as client:
+            job = client.submit(self.base, project_name='../../escape', max_pages=1)
+            stats = self.wait(client, job)
+            with self.assertRaises(RuntimeError):
+                client.submit(self.base, project_name='..')
+        folder = os.path.realpath(self.folder)
+        self.assertTrue(os.path.realpath(stats['filepath']).startswith(folder + os.sep))
+        self.assertFalse(os.path.exists(os.path.join(self.folder, '..', '..', 'escape')))
+
+    def test_socket_path_is_checked(self):
+        # a running daemon is left alone
+        with self.assertRaises(OSError):
+            Daemon(self.socket_path, self.folder)
+        with DaemonClient(self.socket_path) as client:
+            self.assertEqual(client.stats()['jobs'], [])
+        # so is anything which is not a socket
+        path = os.path.join(self.folder, 'notes.txt')
+        with open(path, 'w') as fh:
+            fh.write('keep')
+        with self.assertRaises(OSError):
+            Daemon(path, self.folder)
+        with open(path) as fh:
+            self.assertEqual(fh.read(), 'keep')
+        # the socket of a daemon which is gone is replaced
+        path = os.path.join(self.folder, 'stale.sock')
+        stale = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        stale.bind(path)
+        stale.close()
+        daemon = Daemon(path, self.folder, workers=1)
+        daemon.server_close()
+
+    def test_socket_is_private(self):
+        self.assertEqual(os.stat(self.socket_path).st_mode & 0o777, 0o600)
+
+
+if __name__ == '__main__':
+    unittest.main()
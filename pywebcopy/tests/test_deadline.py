@@ -0,0 +1,141 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import os
+import shutil
+import tempfile
+import time
+import unittest
+
+from pywebcopy import save_page
+from pywebcopy.configs import get_config
+from pywebcopy.deadline import capture_before
+from pywebcopy.deadline import is_critical
+from pywebcopy.elements import GenericResource
+from pywebcopy.tests.support import LocalSite
+from pywebcopy.urls import Context
+from pywebcopy.urls import HIERARCHY
+
+PAGES = {
+    '/': b'<html><head><script src="/app.js"></script>'
+         b'<img src="/a.png"><img src="/slow.png"><img src="/b.png">'
+         b'<link rel="stylesheet" href="/s.css"></head><body></body></html>',
+    '/s.css': b'@font-face {src: url(/f.woff2)} body {background: url(/bg.png)}',
+    '/f.woff2': b'font',
+    '/bg.png': b'png',
+    '/a.png': b'png',
+    '/b.png': b'png',
+    '/slow.png': b'png',
+    '/app.js': b'var a = 1;',
+}
+TYPES = {'.css': 'text/css', '.png': 'image/png', '.woff2': 'font/woff2',
+         '.js': 'application/javascript'}
+
+
+class TestDeadline(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.server = LocalSite(PAGES, TYPES)
+        self.base = self.server.url()
+
+    def tearDown(self):
+        self.server.close()
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def capture(self, deadline, grace=2.0):
+        config = get_config(self.base, self.folder, 'deadline', bypass_robots=True)
+        page = config.create_page()
+        return page, capture_before(page, deadline, grace=grace)
+
+    def read(self, path):
+        with open(path, 'rb') as fh:
+            return fh.read()
+
+    def test_complete_capture(self):
+        page, report = self.capture(10)
+        self.assertTrue(report.complete)
+        self.assertEqual(report.filepath, page.filepath)
+        self.assertEqual(len(report.fetched), 8)
+        self.assertEqual(report.dropped, [])
+        self.assertLess(report.seconds, 10)
+        html = self.read(report.filepath)
+        self.assertNotIn(self.base.encode(), html.split(b'-->', 1)[1])
+        self.assertIsNone(page.scheduler.deadline)
+
+    def test_slow_asset_is_cancelled(self):
+        self.server.slow['/slow.png'] = 3
+        start = time.time()
+        page, report = self.capture(1)
+        self.assertLess(time.time() - start, 2.5)
+        self.assertFalse(report.complete)
+        self.assertEqual(report.cancelled, [self.base + 'slow.png'])
+        html = self.read(report.filepath)
+        # left online, the others are local
+        self.assertIn(('src="%sslow.png"' % self.base).encode(), html)
+        self.assertIn(b'a.png"', html)
+        self.assertNotIn(('src="%sa.png"' % self.base).encode(), html)
+        folder = os.path.dirname(report.filepath)
+        self.assertFalse(os.path.exists(os.path.join(folder, 'slow.png')))
+        self.assertTrue(os.path.exists(os.path.join(folder, 'f.woff2')))
+        # fetched again by a later capture
+        self.assertIsNone(page.scheduler.index.get_entry(self.base + 'slow.png'))
+
+    def test_stalled_stylesheet_is_cancelled_after_the_grace(self):
+        self.server.slow['/s.css'] = 5
+        start = time.time()
+        page, report = self.capture(0.5, grace=0.5)
+        self.assertLess(time.time() - start, 3)
+        self.assertIn(self.base + 's.css', report.cancelled)
+        self.assertIn(('href="%ss.css"' % self.base).encode(), self.read(report.filepath))
+
+    def test_save_complete_returns_the_path(self):
+        config = get_config(self.base, self.folder, 'deadline', bypass_robots=True)
+        page = config.create_page()
+        self.assertEqual(page.save_complete(deadline=10), page.filepath)
+        self.assertTrue(os.path.isfile(page.filepath))
+        self.assertTrue(page.deadline_report.complete)
+        self.assertEqual(page.deadline_report.filepath, page.filepath)
+
+    def test_save_page_fetches_the_page_once(self):
+        report = save_page(self.base, self.folder, 'deadline', bypass_robots=True,
+                           open_in_browser=False, deadline=10)
+        self.assertTrue(report.complete)
+        self.assertEqual(self.server.hits.count('/'), 1)
+
+    def test_critical_files_first(self):
+        self.server.slow['/a.png'] = 0.3
+        config = get_config(self.base, self.folder, 'deadline', bypass_robots=True)
+        page = config.create_page()
+        report = capture_before(page, 10, workers=1)
+        self.assertTrue(report.complete)
+        hits = self.server.hits
+        # the stylesheet and its font go before the images, the calling
+        # thread and the worker start on the first two files at once
+        self.assertLess(hits.index('/s.css'), hits.index('/a.png'))
+        self.assertLessEqual(hits.index('/s.css'), 2)
+        self.assertLess(hits.index('/f.woff2'), hits.index('/b.png'))
+
+    def test_nothing_left_after_the_deadline(self):
+        self.server.slow['/'] = 0.5
+        page, report = self.capture(0.2)
+        # the page itself is finished, its files are dropped
+        self.assertTrue(os.path.isfile(report.filepath))
+        self.assertEqual(report.fetched, [self.base])
+        self.assertEqual(len(report.dropped), 5)
+        self.assertIn(('href="%ss.css"' % self.base).encode(), self.read(report.filepath))
+
+    def test_is_critical(self):
+        config = get_config(self.base, self.folder, 'deadline', bypass_robots=True)
+
+        def resource(path, ctype=None):
+            context = Context(self.base + path, self.base, self.folder, HIERARCHY, ctype)
+            return GenericResource(None, config, None, context)
+
+        self.assertTrue(is_critical(resource('s.css')))
+        self.assertTrue(is_critical(resource('f.woff2')))
+        self.assertTrue(is_critical(resource('x', 'text/html')))
+        self.assertFalse(is_critical(resource('a.png')))
+        self.assertFalse(is_critical(resource('x')))
+
+
+if __name__ == '__main__':
+    unittest.main()
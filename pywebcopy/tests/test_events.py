@@ -0,0 +1,125 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import logging
+import threading
+import unittest
+
+from pywebcopy import events
+
+
+class Counted(object):
+    formatted = 0
+
+    def __repr__(self):
+        Counted.formatted += 1
+        return 'Counted'
+
+
+class TestEvents(unittest.TestCase):
+    def setUp(self):
+        events.clear()
+        Counted.formatted = 0
+
+    def tearDown(self):
+        events.stop_recording()
+        events.clear()
+
+    def test_disabled_by_default(self):
+        self.assertFalse(events.enabled)
+
+    def test_define_rejects_duplicates(self):
+        events.define('test.duplicate', 'x')
+        with self.assertRaises(ValueError):
+            events.define('test.duplicate', 'y')
+
+    def test_record_is_lazy_and_per_thread(self):
+        ev = events.define('test.record', 'value %r in %s')
+        events.record()
+        self.assertTrue(events.enabled)
+        events.emit(ev, Counted(), 'main')
+        t = threading.Thread(target=events.emit, args=(ev, Counted(), 'worker'), name='events-worker')
+        t.start()
+        t.join()
+        self.assertEqual(Counted.formatted, 0)
+        recs = [r for r in events.records() if r[2] is ev]
+        self.assertEqual([r[3] for r in recs], ['value Counted in main', 'value Counted in worker'])
+        self.assertEqual(recs[1][1], 'events-worker')
+        self.assertEqual(Counted.formatted, 2)
+
+    def test_ring_buffer_capacity(self):
+        ev = events.define('test.ring', '%d')
+        events.record(capacity=3)
+        try:
+            for i in range(10):
+                events.emit(ev, i)
+            self.assertEqual([r[3] for r in events.records() if r[2] is ev], ['7', '8', '9'])
+        finally:
+            events.record(capacity=4096)
+
+    def test_sampling(self):
+        ev = events.define('test.sample', '%d')
+        events.set_sample(ev, 4)
+        events.record()
+        for i in range(10):
+            events.emit(ev, i)
+        self.assertEqual([r[3] for r in events.records() if r[2] is ev], ['0', '4', '8'])
+
+    def test_logging_sink_skips_disabled_levels(self):
+        ev = events.define('test.sink', '%r', level=logging.DEBUG, logger='pywebcopy.tests.events')
+        lg = logging.getLogger('pywebcopy.tests.events')
+        lg.setLevel(logging.INFO)
+        sink = events.enable_logging()
+        try:
+            events.emit(ev, Counted())
+            self.assertEqual(Counted.formatted, 0)
+            with self.assertLogs(lg, logging.DEBUG) as cm:
+                events.emit(ev, Counted())
+            self.assertEqual(cm.output, ['DEBUG:pywebcopy.tests.events:Counted'])
+        finally:
+            events.remove_sink(sink)
+        self.assertFalse(events.enabled)
+
+    def test_info_events_are_always_logged(self):
+        ev = events.define('test.info', 'written %s', level=logging.INFO, logger='pywebcopy.tests.info')
+        lg = logging.getLogger('pywebcopy.tests.info.Scheduler')
+        self.assertFalse(events.enabled)
+        with self.assertLogs('pywebcopy.tests.info', logging.INFO) as cm:
+            events.log(lg, ev, 'a')
+            events.log(None, ev, 'b')
+        self.assertEqual(cm.output, ['INFO:pywebcopy.tests.info.Scheduler:written a',
+                                     'INFO:pywebcopy.tests.info:written b'])
+
+    def test_debug_events_reach_debug_loggers(self):
+        ev = events.define('test.debug', 'got %r', logger='pywebcopy.tests.debug')
+        lg = logging.getLogger('pywebcopy.tests.debug.Scheduler')
+        lg.setLevel(logging.INFO)
+        try:
+            events.log(lg, ev, Counted())
+            self.assertEqual(Counted.formatted, 0)
+            lg.setLevel(logging.DEBUG)
+            with self.assertLogs(lg, logging.DEBUG) as cm:
+                events.log(lg, ev, Counted())
+        finally:
+            lg.setLevel(logging.NOTSET)
+        self.assertFalse(events.enabled)
+        self.assertEqual(cm.output, ['DEBUG:pywebcopy.tests.debug.Scheduler:got Counted'])
+        self.assertEqual(events.records(), [])
+
+    def test_logging_sink_keeps_the_logger_names(self):
+        debug = events.define('test.names', 'debug %s', logger='pywebcopy.tests.names')
+        info = events.define('test.names.info', 'info %s', level=logging.INFO, logger='pywebcopy.tests.names')
+        lg = logging.getLogger('pywebcopy.tests.names.HTMLResource')
+        sink = events.enable_logging()
+        try:
+            with self.assertLogs('pywebcopy.tests.names', logging.DEBUG) as cm:
+                events.log(lg, debug, 'a')
+                events.log(lg, info, 'b')
+        finally:
+            events.remove_sink(sink)
+        # logged once each
+        self.assertEqual(cm.output, ['DEBUG:pywebcopy.tests.names.HTMLResource:debug a',
+                                     'INFO:pywebcopy.tests.names.HTMLResource:info b'])
+
+
+if __name__ == '__main__':
+    unittest.main()
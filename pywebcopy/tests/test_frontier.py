@@ -0,0 +1,154 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import os
+import shutil
+import tempfile
+import unittest
+
+from pywebcopy.configs import get_config
+from pywebcopy.core import Crawler
+from pywebcopy.frontier import Budget
+from pywebcopy.frontier import OPIC
+from pywebcopy.frontier import frontier_crawler_scheduler
+from pywebcopy.tests.support import FakeSession
+
+
+def links(*paths):
+    return '<html><body>%s</body></html>' % ''.join('<a href="%s">x</a>' % p for p in paths)
+
+
+class TestOPIC(unittest.TestCase):
+    def test_most_linked_page_first(self):
+        opic = OPIC()
+        opic.add('root')
+        self.assertEqual(opic.pop(), 'root')
+        opic.distribute('root', ['a', 'b', 'c', 'd'])
+        self.assertEqual(opic.pop(), 'a')
+        opic.distribute('a', ['d', 'e'])
+        # d now has 1/4 + 1/8 of the cash
+        self.assertEqual(opic.pop(), 'd')
+        self.assertAlmostEqual(opic.importance('d'), 0.375)
+        self.assertEqual(len(opic), 3)
+
+    def test_crawled_pages_collect_history(self):
+        opic = OPIC()
+        opic.add('root')
+        opic.pop()
+        opic.distribute('root', ['a'])
+        opic.pop()
+        opic.distribute('a', ['root'])
+        self.assertIsNone(opic.pop())
+        self.assertAlmostEqual(opic.importance('root'), 2.0)
+        self.assertFalse(opic.add('root'))
+
+    def test_fifo_order(self):
+        opic = OPIC('fifo')
+        opic.add('root')
+        opic.pop()
+        opic.distribute('root', ['a', 'b'])
+        opic.add('b', 5.0)
+        self.assertEqual(sorted([opic.pop(), opic.pop()]), ['a', 'b'])
+        with self.assertRaises(ValueError):
+            OPIC('random')
+
+    def test_budget(self):
+        self.assertFalse(Budget().exhausted(10 ** 6, 10 ** 12, 10 ** 6))
+        self.assertTrue(Budget(pages=3).exhausted(3, 0, 0))
+        self.assertTrue(Budget(bytes=100).exhausted(0, 100, 0))
+        self.assertFalse(Budget(seconds=5).exhausted(100, 100, 1))
+
+
+class TestFrontierScheduler(unittest.TestCase):
+    base = 'http://site.test/'
+
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        # /popular.html is linked from every page but discovered last
+        b = self.base
+        self.pages = {
+            b: links('a.html', 'b.html', 'c.html', 'popular.html', 'http://other.test/'),
+            b + 'a.html': links('a1.html', 'a2.html', 'popular.html'),
+            b + 'b.html': links('b1.html', 'popular.html'),
+            b + 'c.html': links('c1.html', 'popular.html'),
+            b + 'popular.html': links('a.html'),
+            b + 'a1.html': links(), b + 'a2.html': links(),
+            b + 'b1.html': links(), b + 'c1.html': links(),
+        }
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def crawl(self, **kwargs):
+        config = get_config(self.base, self.folder, 'frontier', bypass_robots=True)
+        session = FakeSession(self.pages)
+        scheduler = frontier_crawler_scheduler(**kwargs)
+        crawler = Crawler(session, config, scheduler, config.create_context())
+        crawler.get(self.base)
+        crawler.save_complete()
+        return session, scheduler
+
+    def test_complete_crawl(self):
+        session, scheduler = self.crawl()
+        self.assertEqual(set(session.requested), set(self.pages))
+        self.assertEqual(scheduler.stats['pages'], len(self.pages))
+        self.assertEqual(scheduler.stats['skipped'], 0)
+
+    def test_budget_prefers_linked_pages(self):
+        session, scheduler = self.crawl(max_pages=4)
+        crawled = session.requested[1:]  # the first request is `crawler.get`
+        self.assertEqual(len(crawled), 4)
+        self.assertIn(self.base + 'popular.html', crawled)
+        self.assertEqual(scheduler.stats['skipped'], len(scheduler.skipped()))
+        self.assertNotIn(self.base + 'popular.html', scheduler.skipped())
+
+    def test_dead_links_spend_no_budget(self):
+        # unknown urls are 404 on the fake session
+        self.pages = {self.base: links('d1.html', 'd2.html', 'd3.html', 'a.html'),
+                      self.base + 'a.html': links()}
+        session, scheduler = self.crawl(max_pages=2)
+        self.assertIn(self.base + 'a.html', session.requested)
+        self.assertEqual(scheduler.stats['pages'], 2)
+        self.assertEqual(scheduler.stats['skipped'], 0)
+
+    def test_refused_seed_is_not_indexed(self):
+        config = get_config(self.base, self.folder, 'frontier', bypass_robots=True)
+        scheduler = frontier_crawler_scheduler()
+        crawler = Crawler(FakeSession(self.pages), config, scheduler, config.create_context())
+        url = self.base + 'popular.html'
+        context = crawler.context.create_new_from_url(url)
+        scheduler.validate_resource = lambda resource: False
+        self.assertFalse(scheduler.seed(crawler.__class__(None, config, scheduler, context)))
+        self.assertIsNone(scheduler.index.get_entry(url))
+        del scheduler.validate_resource
+        self.assertTrue(scheduler.seed(crawler.__class__(None, config, scheduler, context)))
+        self.assertIsNotNone(scheduler.index.get_entry(url))
+
+    def test_deferred_pages_keep_linked_path(self):
+        self.crawl()
+        with open(os.path.join(self.folder, 'frontier', 'site.test', 'index.html'), 'rb') as fh:
+            root = fh.read()
+        self.assertIn(b'href="./popular.html"', root)
+        self.assertTrue(os.path.exists(os.path.join(self.folder, 'frontier', 'site.test', 'popular.html')))
+
+    def test_deferred_page_which_is_not_html(self):
+        self.pages[self.base] = links('report')
+        self.pages[self.base + 'report'] = b'%PDF-1.4 report'
+        config = get_config(self.base, self.folder, 'frontier', bypass_robots=True)
+        session = FakeSession(self.pages, {self.base + 'report': {'Content-Type': 'application/pdf'}})
+        scheduler = frontier_crawler_scheduler()
+        crawler = Crawler(session, config, scheduler, config.create_context())
+        crawler.get(self.base)
+        crawler.save_complete()
+        site = os.path.join(self.folder, 'frontier', 'site.test')
+        with open(os.path.join(site, 'report.html'), 'rb') as fh:
+            stub = fh.read()
+        self.assertNotIn(b'%PDF', stub)
+        self.assertIn(b'http-equiv="refresh"', stub)
+        saved = scheduler.index.get_entry(self.base + 'report')
+        self.assertNotEqual(os.path.splitext(saved)[1], '.html')
+        with open(saved, 'rb') as fh:
+            self.assertEqual(fh.read(), b'%PDF-1.4 report')
+
+
+if __name__ == '__main__':
+    unittest.main()
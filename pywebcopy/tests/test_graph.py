@@ -0,0 +1,121 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import io
+import os
+import shutil
+import tempfile
+import unittest
+
+from requests import Response
+
+import pywebcopy.graph
+from pywebcopy.configs import get_config
+from pywebcopy.elements import HTMLResource
+from pywebcopy.graph import CSRGraph
+from pywebcopy.graph import IMAGE
+from pywebcopy.graph import LINK
+from pywebcopy.graph import LinkGraph
+from pywebcopy.graph import SCRIPT
+from pywebcopy.graph import STYLESHEET
+from pywebcopy.graph import url_fingerprint
+from pywebcopy.schedulers import crawler_scheduler
+from pywebcopy.urls import Context
+from pywebcopy.urls import HIERARCHY
+
+
+class TestLinkGraph(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.path = os.path.join(self.folder, 'site.graph')
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def test_fingerprint_ignores_fragment(self):
+        self.assertEqual(url_fingerprint('http://x.org/a#top'), url_fingerprint('http://x.org/a'))
+        self.assertNotEqual(url_fingerprint('http://x.org/a'), url_fingerprint('http://x.org/b'))
+
+    def test_export_and_load(self):
+        graph = LinkGraph()
+        graph.add_edges('http://x.org/', [
+            ('http://x.org/a', LINK), ('http://x.org/s.css', STYLESHEET),
+            ('http://x.org/a#frag', LINK), ('http://x.org/j.js', SCRIPT)])
+        graph.add_edges('http://x.org/a', [('http://x.org/', LINK), ('http://x.org/é.png', IMAGE)])
+        graph.add('http://x.org/s.css', 'http://x.org/bg.png', IMAGE)
+        self.assertEqual(len(graph), 6)
+        self.assertEqual(graph.export(self.path), (6, 6))
+
+        with CSRGraph.load(self.path) as g:
+            self.assertEqual((len(g), g.num_edges), (6, 6))
+            root = g.node('http://x.org/')
+            self.assertEqual(g.url(root), 'http://x.org/')
+            self.assertEqual(g.out_degree(root), 3)
+            self.assertEqual(sorted((g.url(t), k) for t, k in g.edges(root)), [
+                ('http://x.org/a', LINK), ('http://x.org/j.js', SCRIPT), ('http://x.org/s.css', STYLESHEET)])
+            a = g.node('http://x.org/a')
+            self.assertIn(root, list(g.successors(a)))
+            self.assertIn(('http://x.org/é.png', IMAGE), [(g.url(t), k) for t, k in g.edges(a)])
+            self.assertEqual(g.out_degree(g.node('http://x.org/j.js')), 0)
+            self.assertIsNone(g.node('http://x.org/missing'))
+
+    def test_chunked_export_matches_the_python_one(self):
+        graph = LinkGraph()
+        for i in range(300):
+            graph.add_edges('http://x.org/%d' % (i % 37), [('http://x.org/%d' % ((i * 7 + j) % 91), j % 5)
+                                                           for j in range(i % 4 + 1)])
+        graph.export(self.path, chunk=64)
+        with open(self.path, 'rb') as fh:
+            chunked = fh.read()
+        numpy, pywebcopy.graph.numpy = pywebcopy.graph.numpy, None
+        try:
+            graph.export(self.path)
+        finally:
+            pywebcopy.graph.numpy = numpy
+        with open(self.path, 'rb') as fh:
+            self.assertEqual(fh.read(), chunked)
+        with CSRGraph.load(self.path) as g:
+            self.assertEqual(g.num_edges, len(graph))
+
+    def test_empty_graph(self):
+        self.assertEqual(LinkGraph().export(self.path), (0, 0))
+        with CSRGraph.load(self.path) as g:
+            self.assertEqual(len(g), 0)
+            self.assertIsNone(g.node('http://x.org/'))
+
+    def test_bad_file(self):
+        with open(self.path, 'wb') as fh:
+            fh.write(b'x' * 128)
+        with self.assertRaises(ValueError):
+            CSRGraph.load(self.path)
+
+
+class TestGraphRecording(unittest.TestCase):
+    def test_page_edges_are_recorded(self):
+        folder = tempfile.mkdtemp()
+        try:
+            config = get_config('http://localhost/', folder, 'graph', bypass_robots=True)
+            scheduler = crawler_scheduler()
+            scheduler.graph = LinkGraph()
+            scheduler.handle_resource = lambda res: None
+            response = Response()
+            response.status_code = 200
+            response.url = 'http://localhost/index.html'
+            response.headers['Content-Type'] = 'text/html'
+            response.raw = io.BytesIO(
+                b'<html><head><link rel="stylesheet" href="s.css"><script src="/j.js"></script>'
+                b'</head><body><a href="p.html">p</a><a href="p.html">again</a>'
+                b'<img src="i.png"></body></html>')
+            context = Context('http://localhost/index.html', 'http://localhost/', folder, HIERARCHY)
+            HTMLResource(None, config, scheduler, context, response).retrieve()
+            self.assertEqual(sorted(zip(scheduler.graph.targets, scheduler.graph.kinds)), sorted([
+                (url_fingerprint('http://localhost/s.css'), STYLESHEET),
+                (url_fingerprint('http://localhost/j.js'), SCRIPT),
+                (url_fingerprint('http://localhost/p.html'), LINK),
+                (url_fingerprint('http://localhost/i.png'), IMAGE)]))
+            self.assertEqual(set(scheduler.graph.sources), {url_fingerprint('http://localhost/index.html')})
+        finally:
+            shutil.rmtree(folder, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,128 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import threading
+import time
+import unittest
+
+from pywebcopy.hedge import Hedger
+from pywebcopy.hedge import HostLatency
+from pywebcopy.hedge import TokenBucket
+from pywebcopy.session import Session
+from pywebcopy.tests.support import LocalSite
+
+
+class TestHedger(unittest.TestCase):
+    def setUp(self):
+        self.server = LocalSite()
+        self.base = self.server.url()
+        self.session = Session()
+
+    def tearDown(self):
+        self.session.close()
+        self.server.close()
+
+    def warm_up(self, n=40):
+        for i in range(n):
+            self.session.get(self.base + 'a%d' % i, stream=True).close()
+
+    def test_slow_request_is_hedged(self):
+        hedge = self.session.enable_hedging(ratio=0.1, min_samples=20)
+        self.warm_up()
+        self.assertIsNotNone(hedge.delay('127.0.0.1:%d' % self.server.server_address[1]))
+        start = time.time()
+        response = self.session.get(self.base + 'stall', stream=True)
+        self.assertLess(time.time() - start, 0.8)
+        self.assertEqual(response.content, b'ok')
+        self.assertEqual(self.server.hits.count('/stall'), 2)
+        self.assertEqual(hedge.stats['hedged'], 1)
+        self.assertEqual(hedge.stats['won'], 1)
+        # the stuck connection is shut down, its time is not recorded
+        self.assertEqual(hedge.stats['cancelled'], 1)
+        latency = hedge.latency('127.0.0.1:%d' % self.server.server_address[1])
+        self.assertLess(max(latency.samples), 0.8)
+
+    def test_redirects_are_not_hedged_again(self):
+        # more callers than threads in the pool, each redirected once
+        hedge = self.session.enable_hedging(ratio=1.0, min_samples=20, workers=2)
+        self.warm_up()
+        for i in range(4):
+            self.server.redirects['/stall-r%d' % i] = '/stall-a%d' % i
+        responses = []
+
+        def get(i):
+            responses.append(self.session.get(self.base + 'stall-r%d' % i, stream=True))
+
+        self.server.stall = 0.3
+        threads = [threading.Thread(target=get, args=(i,), daemon=True) for i in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join(10)
+        self.assertFalse(any(t.is_alive() for t in threads))
+        self.assertEqual([r.content for r in responses], [b'ok'] * 4)
+        self.assertEqual(hedge.stats['requests'], 44)
+
+    def test_budget(self):
+        # no tokens are ever earned
+        hedge = self.session.enable_hedging(ratio=0.0)
+        self.server.stall = 0.3
+        self.warm_up()
+        start = time.time()
+        self.session.get(self.base + 'stall', stream=True).close()
+        self.assertGreaterEqual(time.time() - start, 0.3)
+        self.assertEqual(self.server.hits.count('/stall'), 1)
+        self.assertEqual(hedge.stats['hedged'], 0)
+        self.assertEqual(hedge.stats['denied'], 1)
+
+    def test_only_idempotent_streamed_requests(self):
+        hedge = self.session.enable_hedging(ratio=1.0)
+        self.server.stall = 0.3
+        self.warm_up()
+        requests = hedge.stats['requests']
+        self.session.post(self.base + 'stall-post', stream=True).close()
+        self.session.get(self.base + 'stall-get')
+        self.assertEqual(self.server.hits.count('/stall-post'), 1)
+        self.assertEqual(self.server.hits.count('/stall-get'), 1)
+        self.assertEqual(hedge.stats['requests'], requests)
+
+    def test_no_hedge_without_samples(self):
+        hedge = self.session.enable_hedging(ratio=1.0, min_samples=20)
+        self.server.stall = 0.2
+        self.session.get(self.base + 'stall', stream=True).close()
+        self.assertEqual(hedge.stats['hedged'], 0)
+
+    def test_invalid_percentile(self):
+        self.assertRaises(ValueError, Hedger, percentile=100)
+
+
+class TestParts(unittest.TestCase):
+    def test_latency_window(self):
+        latency = HostLatency(window=20, percentile=95)
+        self.assertIsNone(latency.threshold())
+        for i in range(100):
+            latency.add(float(i))
+        # only the last twenty are kept
+        self.assertEqual(len(latency), 20)
+        self.assertEqual(latency.threshold(), 99.0)
+        for i in range(19):
+            latency.add(1.0)
+        self.assertEqual(latency.threshold(), 99.0)
+        latency.add(1.0)
+        self.assertEqual(latency.threshold(), 1.0)
+
+    def test_bucket(self):
+        bucket = TokenBucket(ratio=0.25, burst=2)
+        self.assertFalse(bucket.take())
+        for _ in range(4):
+            bucket.earn()
+        self.assertTrue(bucket.take())
+        self.assertFalse(bucket.take())
+        for _ in range(100):
+            bucket.earn()
+        self.assertTrue(bucket.take())
+        self.assertTrue(bucket.take())
+        self.assertFalse(bucket.take())
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,83 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import json
+import unittest
+
+from pywebcopy import memtrace
+
+MB = 1024 * 1024
+
+
+class Resource(object):
+    def __init__(self, content_type=None):
+        self.response = object() if content_type else None
+        self.content_type = content_type
+
+
+class TestMemoryTracer(unittest.TestCase):
+    def tearDown(self):
+        memtrace.disable()
+
+    def test_disabled_stage_is_a_shared_noop(self):
+        self.assertIsNone(memtrace.current())
+        first = memtrace.stage('parse', Resource('text/html'))
+        self.assertIs(first, memtrace._null_stage)
+        self.assertIs(memtrace.stage('write'), first)
+        with first as entered:
+            self.assertIs(entered, first)
+        self.assertIsNone(memtrace.disable())
+
+    def test_nested_stage_peaks(self):
+        tracer = memtrace.enable(interval=60)
+        self.assertIs(memtrace.enable(), tracer)
+        page, image = Resource('text/html'), Resource('image/png')
+        with memtrace.stage('parse', page):
+            kept = bytearray(MB)
+            with memtrace.stage('write', image):
+                dropped = bytearray(2 * MB)
+                del dropped
+        self.assertIs(memtrace.disable(), tracer)
+        self.assertIsNone(memtrace.current())
+
+        parse = tracer.stats[('parse', 'text/html')].as_dict()
+        write = tracer.stats[('write', 'image/png')].as_dict()
+        self.assertEqual((parse['calls'], write['calls']), (1, 1))
+        # peaks are inclusive of the nested stages
+        self.assertGreaterEqual(write['max_peak'], 2 * MB)
+        self.assertLess(write['max_peak'], 2 * MB + MB // 4)
+        self.assertGreaterEqual(parse['max_peak'], 3 * MB)
+        # retained bytes are exclusive
+        self.assertGreaterEqual(parse['retained'], MB)
+        self.assertLess(parse['retained'], MB + MB // 4)
+        self.assertLess(write['retained'], MB // 4)
+        self.assertEqual(len(kept), MB)
+
+    def test_breakdown_by_stage_and_kind(self):
+        tracer = memtrace.enable(interval=60)
+        for resource in (Resource('text/html'), Resource('text/html'), Resource('text/css'),
+                         Resource(), None):
+            with memtrace.stage('fetch', resource):
+                pass
+            with memtrace.stage('write', resource):
+                pass
+        memtrace.disable()
+
+        kinds = tracer.by_kind()
+        self.assertEqual(sorted(kinds), ['-', 'Resource', 'text/css', 'text/html'])
+        self.assertEqual(kinds['text/html'].calls, 4)
+        self.assertEqual(kinds['-'].calls, 2)
+        stages = tracer.by_stage()
+        self.assertEqual(sorted(stages), ['fetch', 'write'])
+        self.assertEqual(stages['fetch'].calls, 5)
+
+        summary = json.loads(json.dumps(tracer.summary()))
+        self.assertEqual(summary['stages']['write']['calls'], 5)
+        self.assertEqual(len(summary['detail']), 8)
+        self.assertGreater(summary['rss_peak'], 0)
+        report = tracer.report()
+        self.assertIn('fetch', report)
+        self.assertIn('text/css', report)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,111 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import io
+import re
+import shutil
+import tempfile
+import unittest
+
+from requests import Response
+
+from pywebcopy.configs import get_config
+from pywebcopy.elements import HTMLResource
+from pywebcopy.graph import IMAGE
+from pywebcopy.graph import LINK
+from pywebcopy.graph import STYLESHEET
+from pywebcopy.offload import InterpreterPoolExecutor
+from pywebcopy.offload import Offloader
+from pywebcopy.offload import SharedBody
+from pywebcopy.offload import available_cpus
+from pywebcopy.offload import link_table
+from pywebcopy.offload import rewrite
+from pywebcopy.schedulers import crawler_scheduler
+from pywebcopy.urls import Context
+from pywebcopy.urls import HIERARCHY
+
+PAGE = (b'<html><head><link rel="stylesheet" href="/s.css"><link rel="canonical" href="/c">'
+        b'</head><body><a href="p.html">p</a><img src="i.png" srcset="a.png 1x, b.png 2x">'
+        b'<a href="mailto:x@y.org">m</a><div style="background: url(bg.png)"></div>'
+        b'</body></html>')
+
+_watermark = re.compile(br'<!--.*?-->', re.S)
+
+
+class TestPhases(unittest.TestCase):
+    def test_link_table(self):
+        table = link_table(PAGE, 'utf-8')
+        self.assertEqual(table[:3], [('link', '/s.css', STYLESHEET, False),
+                                     ('link', '/c', LINK, True),
+                                     ('a', 'p.html', LINK, False)])
+        self.assertIn(('div', 'bg.png', IMAGE, False), table)
+
+    def test_rewrite_by_row(self):
+        table = link_table(PAGE, 'utf-8')
+        replacements = [None] * len(table)
+        replacements[2] = 'local/p.html'
+        out = rewrite(PAGE, 'utf-8', replacements, 'mark')
+        self.assertIn(b'href="local/p.html"', out)
+        self.assertIn(b'href="/s.css"', out)
+        self.assertIn(b'<!--mark-->', out)
+        # a short table leaves the rest of the document alone
+        self.assertIn(b'bg.png', rewrite(PAGE, 'utf-8', [], None))
+
+
+class TestOffloadedRetrieve(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def retrieve(self, offload):
+        config = get_config('http://localhost/', self.folder, 'offload', bypass_robots=True)
+        scheduler = crawler_scheduler()
+        scheduler.offload = offload
+        scheduler._handle_resource = lambda res: None
+        response = Response()
+        response.status_code = 200
+        response.url = 'http://localhost/'
+        response.headers['Content-Type'] = 'text/html'
+        response.raw = io.BytesIO(PAGE)
+        context = Context('http://localhost/', 'http://localhost/', self.folder, HIERARCHY)
+        with open(HTMLResource(None, config, scheduler, context, response).retrieve(), 'rb') as fh:
+            return _watermark.sub(b'', fh.read()), sorted(scheduler.index.keys())
+
+    def test_same_output_as_inline(self):
+        inline = self.retrieve(None)
+        for mode in ('threads', 'processes'):
+            with Offloader(workers=2, mode=mode) as offload:
+                self.assertEqual(self.retrieve(offload), inline, mode)
+
+    def test_shared_body(self):
+        with Offloader(workers=1, mode='processes') as offload:
+            body = offload.share(PAGE)
+            self.assertIsInstance(body, SharedBody)
+            try:
+                self.assertEqual(link_table(body, 'utf-8'), link_table(PAGE, 'utf-8'))
+                self.assertEqual(offload.links(body, 'utf-8').result(), link_table(PAGE, 'utf-8'))
+            finally:
+                offload.release(body)
+            self.assertRaises(FileNotFoundError, offload.release, body)
+        with Offloader(workers=1, mode='threads') as offload:
+            self.assertIs(offload.share(PAGE), PAGE)
+
+    @unittest.skipUnless(InterpreterPoolExecutor, "needs Python 3.14+")
+    def test_interpreters(self):
+        inline = self.retrieve(None)
+        with Offloader(workers=2, mode='interpreters') as offload:
+            # or processes if lxml could not be loaded in them
+            self.assertIn(offload.mode, ('interpreters', 'processes'))
+            self.assertEqual(self.retrieve(offload), inline)
+
+    def test_modes(self):
+        self.assertRaises(ValueError, Offloader, mode='fibers')
+        with Offloader(workers=1, mode='auto') as offload:
+            self.assertEqual(offload.mode, 'processes')
+        with Offloader(mode='threads') as offload:
+            self.assertEqual(offload.workers, available_cpus())
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,67 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import os
+import tempfile
+import threading
+import unittest
+
+from pywebcopy.profiler import SamplingProfiler
+
+
+def _busy_wait(event):
+    while not event.is_set():
+        pass
+
+
+class TestSamplingProfiler(unittest.TestCase):
+    def test_invalid_mode(self):
+        with self.assertRaises(ValueError):
+            SamplingProfiler(mode='cprofile')
+
+    def test_sample_covers_all_threads(self):
+        done = threading.Event()
+        worker = threading.Thread(target=_busy_wait, args=(done,), name='busy-worker')
+        worker.start()
+        try:
+            prof = SamplingProfiler()
+            prof.sample()
+        finally:
+            done.set()
+            worker.join()
+        threads = set(stack.split(';', 1)[0] for stack in prof.stacks)
+        self.assertIn('busy-worker', threads)
+        self.assertIn(threading.current_thread().name, threads)
+        self.assertTrue(any('_busy_wait' in stack for stack in prof.stacks))
+
+    def test_top_self_and_total(self):
+        prof = SamplingProfiler()
+        prof.stacks['MainThread;a (x.py:1);b (x.py:2)'] = 3
+        prof.stacks['MainThread;a (x.py:1)'] = 1
+        own, total = prof.top(5)
+        self.assertEqual(own[0], ('b (x.py:2)', 3))
+        self.assertEqual(total[0], ('a (x.py:1)', 4))
+
+    def test_thread_mode_writes_collapsed_stacks(self):
+        prof = SamplingProfiler(interval=0.001).start()
+        done = threading.Event()
+        timer = threading.Timer(0.05, done.set)
+        timer.start()
+        _busy_wait(done)
+        prof.stop()
+        self.assertGreater(prof.samples, 0)
+        fd, path = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            prof.write_collapsed(path)
+            with open(path) as fh:
+                lines = fh.read().splitlines()
+            self.assertTrue(lines)
+            for line in lines:
+                stack, count = line.rsplit(' ', 1)
+                self.assertTrue(int(count) > 0)
+        finally:
+            os.remove(path)
+
+
+if __name__ == '__main__':
+    unittest.main()
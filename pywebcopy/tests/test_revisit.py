@@ -0,0 +1,167 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import io
+import math
+import os
+import random
+import shutil
+import tempfile
+import unittest
+
+from requests import Response
+
+from pywebcopy.configs import get_config
+from pywebcopy.elements import GenericResource
+from pywebcopy.elements import HTMLResource
+from pywebcopy.revisit import RevisitStore
+from pywebcopy.revisit import estimate_rate
+from pywebcopy.revisit import freshness
+from pywebcopy.schedulers import crawler_scheduler
+from pywebcopy.urls import Context
+from pywebcopy.urls import HIERARCHY
+
+HOUR = 3600.0
+
+
+class TestEstimator(unittest.TestCase):
+    def test_formula(self):
+        self.assertIsNone(estimate_rate(0, 0, 0))
+        self.assertEqual(estimate_rate(10, 0, 10 * HOUR), 0.0)
+        self.assertAlmostEqual(estimate_rate(10, 5, 10 * HOUR), -math.log(5.5 / 10.5) / HOUR)
+
+    def test_converges_on_poisson_changes(self):
+        rng = random.Random(3)
+        rate = 1 / (6 * HOUR)
+        n = 2000
+        changes = sum(rng.random() < 1 - math.exp(-rate * HOUR) for _ in range(n))
+        self.assertAlmostEqual(estimate_rate(n, changes, n * HOUR) / rate, 1.0, delta=0.1)
+
+    def test_freshness(self):
+        self.assertEqual(freshness(0, 1), 1.0)
+        self.assertEqual(freshness(1, 0), 0.0)
+        self.assertAlmostEqual(freshness(1.0, 1.0), 1 - math.exp(-1))
+
+
+class TestRevisitStore(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.store = RevisitStore(os.path.join(self.folder, 'revisits.db'))
+
+    def tearDown(self):
+        self.store.close()
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def test_change_detection(self):
+        s = self.store
+        self.assertIsNone(s.observe('u', etag='"a"', when=0))
+        self.assertFalse(s.observe('u', etag='"a"', when=HOUR))
+        self.assertTrue(s.observe('u', etag='"b"', when=2 * HOUR))
+        # the digest wins over validators which did not change
+        self.assertIsNone(s.observe('v', etag='"a"', digest='1', when=0))
+        self.assertTrue(s.observe('v', etag='"a"', digest='2', when=HOUR))
+        self.assertAlmostEqual(s.rate('u'), estimate_rate(2, 1, 2 * HOUR))
+        self.assertEqual(s.rate('w'), None)
+
+    def test_persistence(self):
+        self.store.observe('u', digest='1', when=0)
+        self.store.observe('u', digest='2', when=HOUR)
+        self.store.close()
+        self.store = RevisitStore(os.path.join(self.folder, 'revisits.db'))
+        self.assertEqual(len(self.store), 1)
+        self.assertAlmostEqual(self.store.rate('u'), estimate_rate(1, 1, HOUR))
+
+    def observe_history(self, url, changes, visits, every=HOUR):
+        for k in range(visits + 1):
+            self.store.observe(url, digest=str(k if k <= changes else changes), when=k * every)
+
+    def test_plan_favours_pages_worth_revisiting(self):
+        self.observe_history('static', 0, 20)
+        self.observe_history('daily', 1, 24)
+        self.observe_history('hourly', 10, 20)
+        self.observe_history('frantic', 20, 20, every=60)
+        plan = self.store.plan(fetches_per_hour=2, now=30 * HOUR)
+        self.assertAlmostEqual(sum(1 / i for i in plan.values()) * HOUR, 2, places=3)
+        self.assertEqual(plan['static'], self.store.max_interval)
+        self.assertEqual(plan['frantic'], self.store.max_interval)
+        self.assertLess(plan['hourly'], plan['daily'])
+        uniform = dict.fromkeys(plan, 4 * HOUR / 2)
+        self.assertGreater(self.store.expected_freshness(plan), self.store.expected_freshness(uniform))
+
+    def test_due(self):
+        self.observe_history('a', 5, 5)
+        self.observe_history('b', 0, 5)
+        plan = self.store.plan(fetches_per_hour=10, now=5 * HOUR)
+        self.assertEqual(self.store.due(now=5 * HOUR), [])
+        self.assertEqual(self.store.due(now=5 * HOUR + plan['a']), ['a'])
+        self.store.observe('a', digest='x', when=5 * HOUR + plan['a'])
+        self.assertEqual(self.store.due(now=5 * HOUR + plan['a']), [])
+
+
+class TestRetrieveHook(unittest.TestCase):
+    def test_html_watermark_is_ignored(self):
+        folder = tempfile.mkdtemp()
+        try:
+            config = get_config('http://localhost/', folder, 'revisit', bypass_robots=True)
+            scheduler = crawler_scheduler()
+            scheduler.revisits = RevisitStore()
+            scheduler.handle_resource = lambda res: None
+            results = []
+            for body in (b'<html><body>one</body></html>', b'<html><body>one</body></html>',
+                         b'<html><body>two</body></html>'):
+                response = Response()
+                response.status_code = 200
+                response.url = 'http://localhost/'
+                response.headers['Content-Type'] = 'text/html'
+                response.raw = io.BytesIO(body)
+                context = Context('http://localhost/', 'http://localhost/', folder, HIERARCHY)
+                HTMLResource(None, config, scheduler, context, response).retrieve()
+                results.append(scheduler.revisits.rate('http://localhost/'))
+            self.assertEqual(results[1], 0.0)
+            self.assertGreater(results[2], 0.0)
+        finally:
+            shutil.rmtree(folder, ignore_errors=True)
+
+    def test_kept_asset_is_compared_by_validators(self):
+        folder = tempfile.mkdtemp()
+        try:
+            config = get_config('http://localhost/', folder, 'revisit', bypass_robots=True)
+            scheduler = crawler_scheduler()
+            scheduler.revisits = RevisitStore()
+            url = 'http://localhost/logo.png'
+            results = []
+            for body, etag in ((b'one', '"1"'), (b'two', '"2"'), (b'three', None)):
+                response = Response()
+                response.status_code = 200
+                response.url = url
+                response.headers['Content-Type'] = 'image/png'
+                if etag:
+                    response.headers['ETag'] = etag
+                response.raw = io.BytesIO(body)
+                context = Context(url, 'http://localhost/', folder, HIERARCHY)
+                resource = GenericResource(None, config, scheduler, context, response)
+                resource.retrieve()
+                results.append(scheduler.revisits.rate(url))
+            # the file of the first visit is kept, the etag tells the change
+            with open(resource.filepath, 'rb') as fh:
+                self.assertEqual(fh.read(), b'one')
+            self.assertGreater(results[1], 0.0)
+            # neither a digest nor an etag to compare, the visit is not counted
+            self.assertEqual(results[2], results[1])
+        finally:
+            shutil.rmtree(folder, ignore_errors=True)
+
+    def test_file_digest_in_chunks(self):
+        folder = tempfile.mkdtemp()
+        try:
+            path = os.path.join(folder, 'a.bin')
+            data = os.urandom(300000)
+            with open(path, 'wb') as fh:
+                fh.write(data)
+            self.assertEqual(RevisitStore.file_digest(path, chunk=4096), RevisitStore.file_digest(path))
+            self.assertIsNone(RevisitStore.file_digest(os.path.join(folder, 'missing')))
+        finally:
+            shutil.rmtree(folder, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    unittest.main()
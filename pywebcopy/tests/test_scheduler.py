@@ -1,12 +1,31 @@
 # Copyright 2019; Raja Tomar
+import gc
+import io
+import os
+import shutil
+import tempfile
+import threading
+import time
+import tracemalloc
 import unittest
 
 from requests import Response
 
 from pywebcopy.schedulers import Index
 from pywebcopy.schedulers import Scheduler
+from pywebcopy.schedulers import ThreadPoolScheduler
+from pywebcopy.schedulers import ThreadingScheduler
 from pywebcopy.configs import get_config
+from pywebcopy.core import Crawler
+from pywebcopy.elements import CSSResource
+from pywebcopy.elements import HTMLResource
+from pywebcopy.elements import ResourceRecord
 from pywebcopy.elements import VoidResource
+from pywebcopy.schedulers import crawler_scheduler
+from pywebcopy.schedulers import default_scheduler
+from pywebcopy.schedulers import no_js_scheduler
+from pywebcopy.urls import Context
+from pywebcopy.urls import HIERARCHY
 
 
 class TestIndex(unittest.TestCase):
@@ -60,4 +79,260 @@ class TestIndex(unittest.TestCase):
         self.assertEqual(ans.get(self.resource.url), self.context.resolve())
         self.assertEqual(ans.get(self.response.url), self.context.resolve())
         self.assertEqual(ans.get(rdr1.url), self.context.resolve())
-        self.assertEqual(ans.get(rdr2.url), self.context.resolve())
\ No newline at end of file
+        self.assertEqual(ans.get(rdr2.url), self.context.resolve())
+
+
+def traced(build):
+    gc.collect()
+    before = tracemalloc.get_traced_memory()[0]
+    obj = build()
+    gc.collect()
+    return obj, tracemalloc.get_traced_memory()[0] - before
+
+
+class TestFlyweights(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.config = get_config('http://localhost/', self.folder, 'flyweights', bypass_robots=True)
+        self.context = Context('http://localhost/', 'http://localhost/', self.folder, HIERARCHY)
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def test_stateless_links_create_no_resource(self):
+        scheduler = no_js_scheduler()
+        child = self.context.create_new_from_url('/x.js')
+        self.assertEqual(scheduler.resolve_stateless('a', child), 'http://localhost/x.js')
+        self.assertEqual(scheduler.resolve_stateless('script', child), '#')
+        self.assertIsNone(scheduler.resolve_stateless('img', child))
+
+        scheduler.handle_resource = lambda res: self.fail("resource created for %r" % res)
+        response = Response()
+        response.status_code = 200
+        response.url = 'http://localhost/'
+        response.headers['Content-Type'] = 'text/html'
+        response.raw = io.BytesIO(b'<html><body><a href="/p">p</a><script src="x.js"></script></body></html>')
+        resource = HTMLResource(None, self.config, scheduler, self.context, response)
+        with open(resource.retrieve(), 'rb') as fh:
+            html = fh.read()
+        self.assertIn(b'href="http://localhost/p"', html)
+        self.assertIn(b'src="#"', html)
+        self.assertEqual(len(scheduler.index), 0)
+
+    def test_record_round_trip(self):
+        scheduler = crawler_scheduler()
+        resource = HTMLResource(None, self.config, scheduler, self.context.create_new_from_url('/p'))
+        resource.follow_links = False
+        record = ResourceRecord.from_resource(resource)
+        self.assertIsNone(record.filepath)
+        resource.filepath  # noqa: resolved like before queueing
+        record = ResourceRecord.from_resource(resource)
+        again = record.create(None, self.config, scheduler)
+        self.assertIs(type(again), HTMLResource)
+        self.assertEqual(again.filepath, resource.filepath)
+        self.assertFalse(again.follow_links)
+
+    def test_record_memory(self):
+        scheduler = default_scheduler()
+        config = self.config.freeze()
+        contexts = [self.context.create_new_from_url('/p%d.html' % i) for i in range(1000)]
+
+        def queued(context):
+            resource = HTMLResource(None, config, scheduler, context)
+            resource.filepath  # noqa: resolved like before queueing
+            return resource
+
+        ResourceRecord.from_resource(queued(contexts[0]))  # warm up
+        tracemalloc.start()
+        try:
+            resources, full = traced(lambda: [queued(c) for c in contexts])
+            records, compact = traced(lambda: [
+                ResourceRecord.from_resource(r) for r in resources])
+        finally:
+            tracemalloc.stop()
+        self.assertLess(compact / len(records), 100)
+        self.assertLess(compact * 3, full)
+
+
+class SlowSession(object):
+    """Answers every url after a delay and counts the overlapping requests."""
+
+    def __init__(self, delay=0.05):
+        self.delay = delay
+        self.requested = []
+        self.running = self.peak = 0
+        self.lock = threading.Lock()
+
+    def get(self, url, **kwargs):
+        with self.lock:
+            self.requested.append(url)
+            self.running += 1
+            self.peak = max(self.peak, self.running)
+        time.sleep(self.delay)
+        with self.lock:
+            self.running -= 1
+        response = Response()
+        response.url = url
+        response.status_code = 200
+        response.reason = 'OK'
+        css = url.endswith('.css')
+        response.headers['Content-Type'] = 'text/css' if css else 'image/png'
+        response.raw = io.BytesIO(b'body {}' if css else b'png')
+        return response
+
+
+class Branching(object):
+    """Resource which submits `fanout` children from its worker until
+    `depth` is reached, recording every retrieval in `done`."""
+
+    def __init__(self, scheduler, done, name='r', depth=2, fanout=3):
+        self.scheduler = scheduler
+        self.done = done
+        self.url = 'http://localhost/%s' % name
+        self.context = Context(self.url, 'http://localhost/', tempfile.gettempdir(), HIERARCHY)
+        self.filepath = None
+        self.depth = depth
+        self.fanout = fanout
+
+    def get(self, url, **kwargs):
+        time.sleep(0.02)
+
+    def retrieve(self):
+        time.sleep(0.02)
+        if self.depth:
+            for i in range(self.fanout):
+                self.scheduler._handle_resource(Branching(
+                    self.scheduler, self.done, '%s.%d' % (self.url.rsplit('/', 1)[1], i),
+                    self.depth - 1, self.fanout))
+        self.done.append(self.url)
+
+
+class TestJoin(unittest.TestCase):
+    def check(self, scheduler):
+        done = []
+        try:
+            scheduler._handle_resource(Branching(scheduler, done))
+            # the children are submitted by the workers meanwhile
+            self.assertTrue(scheduler.join(timeout=10))
+            self.assertEqual(len(done), 1 + 3 + 9)
+        finally:
+            scheduler.close()
+
+    def test_threading_scheduler(self):
+        self.check(ThreadingScheduler())
+
+    def test_thread_pool_scheduler(self):
+        self.check(ThreadPoolScheduler(maxsize=2))
+
+    def test_thread_pool_submit_after_close(self):
+        scheduler = ThreadPoolScheduler(maxsize=1)
+        scheduler.close(wait=True)
+        with self.assertRaises(RuntimeError):
+            scheduler._handle_resource(Branching(scheduler, [], depth=0))
+        self.assertEqual(scheduler.pending, 0)
+        self.assertTrue(scheduler.join(timeout=1))
+
+
+class TestHandleMany(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.config = get_config('http://localhost/', self.folder, 'many', bypass_robots=True)
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def retrieve(self, css, session):
+        url = 'http://localhost/s.css'
+        response = Response()
+        response.status_code = 200
+        response.url = url
+        response.headers['Content-Type'] = 'text/css'
+        response.raw = io.BytesIO(css)
+        context = Context(url, 'http://localhost/', self.folder, HIERARCHY)
+        resource = CSSResource(session, self.config, default_scheduler(), context, response)
+        with open(resource.retrieve(), 'rb') as fh:
+            return fh.read()
+
+    def test_stylesheet_children_are_fetched_together(self):
+        css = b''.join(b'.a%d {background: url("i%d.png")}' % (i, i) for i in range(16))
+        session = SlowSession()
+        start = time.time()
+        out = self.retrieve(css + b'.b {background: url(i0.png)}', session)
+        self.assertLess(time.time() - start, 16 * session.delay)
+        self.assertGreater(session.peak, 1)
+        self.assertEqual(sorted(session.requested),
+                         sorted('http://localhost/i%d.png' % i for i in range(16)))
+        self.assertEqual(out.count(b"url('./i0.png')"), 2)
+        self.assertIn(b".a15 {background: url('./i15.png')}", out)
+
+    def test_rewrite_keeps_the_rest(self):
+        css = (b'@import "t.css";\n@import url(n.css);\n'
+               b'.a {background: url(data:image/png;base64,AA==)}\n'
+               b".b {background: URL( 'i.png' )}")
+        out = self.retrieve(css, SlowSession(0))
+        self.assertEqual(out, (b'@import "./t.css";\n@import url(\'./n.css\');\n'
+                               b'.a {background: url(data:image/png;base64,AA==)}\n'
+                               b".b {background: url('./i.png')}"))
+
+
+class TestSpeculativePaths(unittest.TestCase):
+    files = {
+        'http://localhost/': ('text/html', b'<html><head><link rel="stylesheet" href="theme">'
+                                           b'<script src="app.js"></script></head><body>'
+                                           b'<a href="doc">doc</a><img src="i.png"></body></html>'),
+        'http://localhost/theme': ('text/css', b'body {background: url(bg)}'),
+        'http://localhost/app.js': ('text/javascript', b'var a = 1;'),
+        'http://localhost/doc': ('application/pdf', b'%PDF-1.4'),
+        'http://localhost/i.png': ('image/png', b'png'),
+        'http://localhost/bg': ('image/gif', b'gif'),
+    }
+
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.config = get_config('http://localhost/', self.folder, 'speculative', bypass_robots=True)
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def test_parent_is_written_before_the_children(self):
+        root = os.path.join(self.folder, 'speculative', 'localhost', 'index.html')
+        written = {}
+
+        class Session(object):
+            def get(this, url, **kwargs):
+                written[url] = os.path.exists(root)
+                ctype, body = self.files[url]
+                response = Response()
+                response.url = url
+                response.status_code = 200
+                response.reason = 'OK'
+                response.headers['Content-Type'] = ctype
+                response.raw = io.BytesIO(body)
+                return response
+
+        scheduler = crawler_scheduler()
+        scheduler.speculative_paths = True
+        crawler = Crawler(Session(), self.config, scheduler, self.config.create_context())
+        crawler.get('http://localhost/')
+        crawler.save_complete()
+
+        for url in self.files:
+            if url != 'http://localhost/':
+                self.assertTrue(written[url], url)
+        with open(root, 'rb') as fh:
+            page = fh.read()
+        for link in (b'href="./doc.html"', b'href="./theme.css"', b'src="./app.js"', b'src="./i.png"'):
+            self.assertIn(link, page)
+
+        site = os.path.dirname(root)
+        # the image without an extension is named after its type
+        self.assertTrue(os.path.exists(os.path.join(site, 'bg.gif')))
+        # kept at the pinned path
+        with open(os.path.join(site, 'app.js'), 'rb') as fh:
+            self.assertEqual(fh.read(), b'var a = 1;')
+        # a page which is not one redirects to the real file
+        with open(os.path.join(site, 'doc.html'), 'rb') as fh:
+            self.assertIn(b'url=./doc.pdf', fh.read())
+        with open(os.path.join(site, 'doc.pdf'), 'rb') as fh:
+            self.assertEqual(fh.read(), b'%PDF-1.4')
+        self.assertEqual(scheduler.index.get_entry('http://localhost/doc'), os.path.join(site, 'doc.pdf'))
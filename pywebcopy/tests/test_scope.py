@@ -0,0 +1,110 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import unittest
+
+from requests import Request
+
+from pywebcopy.scope import Scope
+from pywebcopy.scope import ScopeError
+from pywebcopy.scope import public_suffix
+from pywebcopy.scope import registrable_domain
+from pywebcopy.session import Session
+
+
+class TestPublicSuffix(unittest.TestCase):
+    def test_registrable_domain(self):
+        self.assertEqual(public_suffix('news.bbc.co.uk'), 'co.uk')
+        self.assertEqual(registrable_domain('news.bbc.co.uk'), 'bbc.co.uk')
+        self.assertEqual(registrable_domain('www.example.com'), 'example.com')
+        self.assertEqual(registrable_domain('user.github.io'), 'user.github.io')
+        self.assertEqual(registrable_domain('a.b.example.unknowntld'), 'example.unknowntld')
+        self.assertEqual(registrable_domain('co.uk'), 'co.uk')
+
+
+class TestScope(unittest.TestCase):
+    def test_empty_scope_allows_everything(self):
+        self.assertTrue(Scope().allows('http://anything.org/x'))
+
+    def test_host_suffix_rules(self):
+        scope = Scope().allow('example.com').deny('ads.example.com')
+        self.assertTrue(scope.allows('http://example.com/'))
+        self.assertTrue(scope.allows('http://www.example.com/a'))
+        self.assertFalse(scope.allows('http://ads.example.com/a'))
+        self.assertFalse(scope.allows('http://x.ads.example.com/a'))
+        self.assertFalse(scope.allows('http://notexample.com/'))
+        self.assertFalse(scope.allows('http://example.org/'))
+
+    def test_more_specific_allow_overrides_deny(self):
+        scope = Scope().deny('example.com').allow('docs.example.com')
+        self.assertFalse(scope.allows('http://www.example.com/'))
+        self.assertTrue(scope.allows('http://docs.example.com/'))
+
+    def test_exact_and_subdomain_rules(self):
+        scope = Scope().allow('=example.com', '*.cdn.net')
+        self.assertTrue(scope.allows('https://example.com/'))
+        self.assertFalse(scope.allows('https://www.example.com/'))
+        self.assertTrue(scope.allows('https://a.cdn.net/x.png'))
+        self.assertFalse(scope.allows('https://cdn.net/x.png'))
+
+    def test_site_rule_uses_registrable_domain(self):
+        scope = Scope().allow('site:https://www.bbc.co.uk/news')
+        self.assertTrue(scope.allows('https://sport.bbc.co.uk/'))
+        self.assertFalse(scope.allows('https://itv.co.uk/'))
+
+    def test_patterns(self):
+        scope = Scope().allow('example.com').deny('path:/private/*', r're:\.(zip|exe)$')
+        self.assertTrue(scope.allows('http://example.com/public/a.html'))
+        self.assertFalse(scope.allows('http://example.com/private/a.html'))
+        self.assertFalse(scope.allows('http://example.com/files/setup.exe'))
+        allowed, rule = scope.classify('http://www.example.com/private/?q=1')
+        self.assertEqual((allowed, rule), (False, 'path:/private/*'))
+
+    def test_regexes_which_cannot_be_merged(self):
+        scope = Scope().allow('a.com').deny(r're:(?i)\.zip$', r're:(a)\1', r're:(b)\1', r're:\.gz$')
+        self.assertEqual(scope.classify('http://a.com/X.ZIP'), (False, r're:(?i)\.zip$'))
+        self.assertEqual(scope.classify('http://a.com/bb'), (False, r're:(b)\1'))
+        self.assertEqual(scope.classify('http://a.com/x.gz'), (False, r're:\.gz$'))
+        self.assertTrue(scope.allows('http://a.com/ab'))
+
+    def test_deny_pattern_beats_allow_pattern(self):
+        scope = Scope().allow('url:http://example.com/*').deny('path:/blog/drafts/*')
+        self.assertTrue(scope.allows('http://example.com/blog/post'))
+        self.assertFalse(scope.allows('http://example.com/blog/drafts/post'))
+        self.assertFalse(scope.allows('http://other.com/'))
+
+    def test_from_base_url(self):
+        scope = Scope.from_base_url('http://localhost:5000/docs/')
+        self.assertTrue(scope.allows('http://localhost:5000/docs/a.html'))
+        self.assertFalse(scope.allows('http://localhost:5000/other.html'))
+
+    def test_rules_added_after_use_are_compiled(self):
+        scope = Scope().allow('example.com')
+        self.assertTrue(scope.allows('http://a.example.com/'))
+        scope.deny('a.example.com')
+        self.assertFalse(scope.allows('http://a.example.com/'))
+
+    def test_many_rules(self):
+        scope = Scope()
+        for i in range(500):
+            scope.deny('host%d.example.com' % i)
+            scope.deny('path:/section%d/*' % i)
+        self.assertFalse(scope.allows('http://host250.example.com/'))
+        self.assertFalse(scope.allows('http://example.com/section499/x'))
+        self.assertTrue(scope.allows('http://example.com/section500/x'))
+
+    def test_invalid_rules(self):
+        for rule in ('', 'path:', 're:(', 'exa mple.com', None):
+            with self.assertRaises(ScopeError):
+                Scope().allow(rule)
+
+
+class TestSessionScope(unittest.TestCase):
+    def test_block_domain_patterns(self):
+        sess = Session()
+        sess.block_domain('*.ads.net')
+        self.assertFalse(sess.is_allowed(Request('GET', 'http://x.ads.net/a').prepare()))
+        self.assertTrue(sess.is_allowed(Request('GET', 'http://example.com/').prepare()))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,114 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import os
+import shutil
+import socket
+import tempfile
+import unittest
+
+from pywebcopy.service import CaptureService
+from pywebcopy.service import DNSCache
+from pywebcopy.service import shared_session
+from pywebcopy.tests.support import LocalSite
+
+PAGES = {
+    '/': b'<html><body><a href="/a.html">a</a><img src="/i.png"></body></html>',
+    '/a.html': b'<html><head><link rel="stylesheet" href="/s.css"></head>'
+               b'<body><a href="/">home</a></body></html>',
+    '/s.css': b'body {background: url(/i.png)}',
+    '/i.png': b'png',
+    '/robots.txt': b'User-agent: *\nDisallow: /private',
+}
+TYPES = {'.css': 'text/css', '.png': 'image/png', '.txt': 'text/plain'}
+
+
+class TestCaptureService(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.server = LocalSite(PAGES, TYPES)
+        self.base = self.server.url('localhost')
+
+    def tearDown(self):
+        self.server.close()
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def test_pages_share_the_session(self):
+        original = socket.getaddrinfo
+        with CaptureService(self.folder, workers=3) as service:
+            futures = [service.submit_page(self.base) for _ in range(6)]
+            results = [f.result(timeout=30) for f in futures]
+            dns = service.dns
+            # the resolver of the process is left alone
+            self.assertIs(socket.getaddrinfo, original)
+
+        self.assertEqual(len(set(r.folder for r in results)), 6)
+        for r in results:
+            self.assertTrue(os.path.isfile(r.filepath))
+            self.assertTrue(r.filepath.startswith(r.folder))
+            self.assertEqual(r.stats['files'], 2)
+            self.assertGreater(r.stats['bytes'], 0)
+        hits = self.server.hits
+        self.assertEqual(hits.count('/robots.txt'), 1)
+        # every capture is a copy of its own
+        self.assertEqual(hits.count('/'), 6)
+        # connections are kept alive across the jobs
+        self.assertLess(len(self.server.clients), len(hits))
+        self.assertGreater(dns.hits, 0)
+        self.assertLessEqual(dns.misses, 3)
+
+    def test_site(self):
+        with CaptureService(self.folder, workers=2, bypass_robots=True) as service:
+            result = service.submit_site(self.base, project_name='site').result(timeout=30)
+        self.assertEqual(result.kind, 'site')
+        self.assertEqual(os.path.basename(result.folder), 'site')
+        self.assertNotIn('/robots.txt', self.server.hits)
+        self.assertEqual(sorted(set(self.server.hits)), ['/', '/a.html', '/i.png', '/s.css'])
+        self.assertEqual(result.stats['files'], 4)
+
+    def test_connects_through_the_cache(self):
+        port = self.server.server_address[1]
+        answers = socket.getaddrinfo('127.0.0.1', port, 0, socket.SOCK_STREAM)
+        cache = DNSCache(resolver=lambda *args: answers)
+        session = shared_session(bypass_robots=True, dns=cache)
+        try:
+            # the made up host is only known to the cache
+            self.assertEqual(session.get('http://cached.invalid:%d/' % port).status_code, 200)
+            self.assertEqual(cache.misses, 1)
+        finally:
+            session.close()
+
+    def test_closed(self):
+        service = CaptureService(self.folder, dns_ttl=None)
+        service.close()
+        with self.assertRaises(RuntimeError):
+            service.submit_page(self.base)
+        with self.assertRaises(ValueError):
+            CaptureService(self.folder, dns_ttl=None).submit(self.base, 'book')
+
+
+class TestDNSCache(unittest.TestCase):
+    def test_ttl(self):
+        calls = []
+        cache = DNSCache(ttl=60, resolver=lambda *args: calls.append(args) or [('answer',)])
+        self.assertEqual(cache.getaddrinfo('x.org', 80), [('answer',)])
+        self.assertEqual(cache.getaddrinfo('x.org', 80), [('answer',)])
+        self.assertEqual(len(calls), 1)
+        cache.ttl = -1
+        cache.getaddrinfo('y.org', 80)
+        cache.getaddrinfo('y.org', 80)
+        self.assertEqual(len(calls), 3)
+        self.assertEqual((cache.hits, cache.misses), (1, 3))
+
+    def test_caches_do_not_nest(self):
+        first, second = DNSCache(), DNSCache()
+        sessions = [shared_session(dns=first), shared_session(dns=second)]
+        del first
+        self.assertEqual(socket.getaddrinfo('localhost', 80)[0][4][1], 80)
+        adapter = sessions[1].get_adapter('http://')
+        pool = adapter.poolmanager.connection_from_url('http://localhost:1/')
+        self.assertIs(pool.ConnectionCls.dns, second)
+        for session in sessions:
+            session.close()
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,144 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import io
+import os
+import random
+import shutil
+import tempfile
+import unittest
+
+from requests import Response
+
+from pywebcopy.configs import get_config
+from pywebcopy.elements import HTMLResource
+from pywebcopy.schedulers import crawler_scheduler
+from pywebcopy.simhash import NearDuplicates
+from pywebcopy.simhash import SimHashIndex
+from pywebcopy.simhash import fingerprint
+from pywebcopy.simhash import hamming
+from pywebcopy.simhash import simhash
+from pywebcopy.urls import Context
+from pywebcopy.urls import HIERARCHY
+
+rng = random.Random(7)
+vocabulary = ['word%d' % i for i in range(2000)]
+
+
+def page(words, extra=''):
+    return ('<html><head><title>t</title><script>var x = 1;</script></head><body>'
+            '<a href="/next.html">next</a><p>%s</p>%s</body></html>' % (' '.join(words), extra)).encode('utf-8')
+
+
+class TestSimHash(unittest.TestCase):
+    def test_hamming(self):
+        self.assertEqual(hamming(0, 0), 0)
+        self.assertEqual(hamming(0b1011, 0b0001), 2)
+        self.assertEqual(hamming(0, (1 << 64) - 1), 64)
+
+    def test_stable_simhash(self):
+        features = [b'alpha beta', b'beta gamma', b'gamma delta']
+        self.assertEqual(simhash(features), simhash(list(features)))
+        self.assertEqual(simhash([]), 0)
+        self.assertLess(simhash(features), 1 << 64)
+
+    def test_variants_are_close_and_other_pages_far(self):
+        words = [rng.choice(vocabulary) for _ in range(800)]
+        other = [rng.choice(vocabulary) for _ in range(800)]
+        base = fingerprint(page(words))
+        variant = fingerprint(page(words, '<div>Sorted by price</div>'))
+        # string hashes are seeded per process, allow for a few unlucky bits
+        self.assertLessEqual(hamming(base, variant), 6)
+        self.assertGreater(hamming(base, fingerprint(page(other))), 15)
+
+    def test_pages_without_text_have_no_fingerprint(self):
+        self.assertIsNone(fingerprint(b'<frameset><frame src="a.html"></frameset>'))
+        self.assertIsNone(fingerprint(page(['only', 'a', 'few', 'words'])))
+        self.assertIsNotNone(fingerprint(page(['word%d' % i for i in range(10)])))
+
+    def test_markup_is_ignored(self):
+        words = [rng.choice(vocabulary) for _ in range(50)]
+        self.assertEqual(fingerprint(page(words)),
+                         fingerprint(page(words).replace(b'var x = 1;', b'var y = 2;')))
+
+
+class TestSimHashIndex(unittest.TestCase):
+    def test_bad_parameters(self):
+        with self.assertRaises(ValueError):
+            SimHashIndex(distance=4, bands=4)
+        with self.assertRaises(ValueError):
+            SimHashIndex(distance=2, bands=5)
+
+    def test_query_within_distance(self):
+        index = SimHashIndex(distance=3, bands=4)
+        fp = rng.getrandbits(64)
+        index.add(fp, 'a')
+        self.assertEqual(index.query(fp ^ 0b111), 'a')
+        self.assertEqual(index.query(fp ^ (1 | 1 << 20 | 1 << 40)), 'a')
+        self.assertIsNone(index.query(fp ^ 0b1111))
+        self.assertEqual(len(index), 1)
+
+    def test_query_or_add(self):
+        index = SimHashIndex()
+        fp = rng.getrandbits(64)
+        self.assertIsNone(index.query_or_add(fp, 'a'))
+        self.assertEqual(index.query_or_add(fp ^ 1, 'b'), 'a')
+        self.assertEqual(len(index), 1)
+
+    def test_bad_policy(self):
+        with self.assertRaises(ValueError):
+            NearDuplicates(policy='drop')
+
+
+class TestDuplicatePolicies(unittest.TestCase):
+    def setUp(self):
+        self.folder = tempfile.mkdtemp()
+        self.config = get_config('http://localhost/', self.folder, 'dedup', bypass_robots=True)
+        self.words = [rng.choice(vocabulary) for _ in range(400)]
+
+    def tearDown(self):
+        shutil.rmtree(self.folder, ignore_errors=True)
+
+    def retrieve(self, scheduler, url, body):
+        response = Response()
+        response.status_code = 200
+        response.url = url
+        response.headers['Content-Type'] = 'text/html; charset=utf-8'
+        response.raw = io.BytesIO(body)
+        context = Context(url, 'http://localhost/', self.folder, HIERARCHY)
+        resource = HTMLResource(None, self.config, scheduler, context, response)
+        scheduler.handle_resource = lambda res: None
+        resource.retrieve()
+        with open(resource.filepath, 'rb') as fh:
+            return fh.read()
+
+    def test_skip_children_leaves_links_absolute(self):
+        scheduler = crawler_scheduler()
+        scheduler.dedup = NearDuplicates(policy='skip_children')
+        first = self.retrieve(scheduler, 'http://localhost/a.html', page(self.words))
+        second = self.retrieve(scheduler, 'http://localhost/a.html?sort=1', page(self.words, '<i class="sort"></i>'))
+        self.assertNotIn(b'http://localhost/next.html', first)
+        self.assertIn(b'href="http://localhost/next.html"', second)
+        self.assertEqual(scheduler.dedup.duplicates,
+                         [('http://localhost/a.html?sort=1', 'http://localhost/a.html')])
+
+    def test_skip_writes_redirect(self):
+        scheduler = crawler_scheduler()
+        scheduler.dedup = NearDuplicates(policy='skip')
+        self.retrieve(scheduler, 'http://localhost/a.html', page(self.words))
+        stub = self.retrieve(scheduler, 'http://localhost/b/c.html', page(self.words))
+        self.assertIn(b'url=../a.html', stub)
+        self.assertNotIn(self.words[0].encode(), stub)
+
+    def test_pages_without_text_are_kept(self):
+        scheduler = crawler_scheduler()
+        scheduler.dedup = NearDuplicates(policy='skip')
+        shell = b'<html><body><div id="app"></div><script src="/app.js"></script></body></html>'
+        self.retrieve(scheduler, 'http://localhost/a.html', shell)
+        second = self.retrieve(scheduler, 'http://localhost/b.html', shell)
+        self.assertIn(b'id="app"', second)
+        self.assertEqual(scheduler.dedup.duplicates, [])
+        self.assertEqual(len(scheduler.dedup.index), 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
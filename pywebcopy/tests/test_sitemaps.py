@@ -0,0 +1,137 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import gzip
+import io
+import shutil
+import tempfile
+import tracemalloc
+import unittest
+
+from pywebcopy.configs import get_config
+from pywebcopy.core import Crawler
+from pywebcopy.frontier import frontier_crawler_scheduler
+from pywebcopy.sitemaps import SitemapEntry
+from pywebcopy.sitemaps import SitemapError
+from pywebcopy.sitemaps import discover
+from pywebcopy.sitemaps import iter_sitemap
+from pywebcopy.sitemaps import parse_lastmod
+from pywebcopy.sitemaps import seed_frontier
+from pywebcopy.sitemaps import seed_priority
+from pywebcopy.sitemaps import walk
+from pywebcopy.tests.support import FakeSession
+
+NS = 'xmlns="http://www.sitemaps.org/schemas/sitemap/0.9"'
+
+
+def urlset(*entries):
+    return ('<?xml version="1.0" encoding="UTF-8"?><urlset %s>%s</urlset>' % (NS, ''.join(
+        '<url><loc>%s</loc>%s</url>' % (loc, extra) for loc, extra in entries))).encode('utf-8')
+
+
+def index(*locs):
+    return ('<?xml version="1.0"?><sitemapindex %s>%s</sitemapindex>' % (NS, ''.join(
+        '<sitemap><loc>%s</loc></sitemap>' % loc for loc in locs))).encode('utf-8')
+
+
+class TestParsing(unittest.TestCase):
+    def test_lastmod(self):
+        self.assertEqual(parse_lastmod('1970-01-02'), 86400.0)
+        self.assertEqual(parse_lastmod('1970-01-01T01:00:00+01:00'), 0.0)
+        self.assertEqual(parse_lastmod('1970-01-01T00:00Z'), 0.0)
+        self.assertEqual(parse_lastmod('1970'), 0.0)
+        self.assertIsNone(parse_lastmod('yesterday'))
+        self.assertIsNone(parse_lastmod('1970-13-01'))
+
+    def test_urlset_and_gzip(self):
+        data = urlset(('http://x.org/a', '<lastmod>1970-01-02</lastmod><priority>0.8</priority>'),
+                      ('http://x.org/b', '<priority>high</priority>'))
+        for raw in (data, gzip.compress(data)):
+            entries = list(iter_sitemap(io.BytesIO(raw)))
+            self.assertEqual(entries, [
+                SitemapEntry('url', 'http://x.org/a', 86400.0, 0.8, None),
+                SitemapEntry('url', 'http://x.org/b', None, None, None)])
+
+    def test_index(self):
+        entries = list(iter_sitemap(io.BytesIO(index('http://x.org/s1.xml'))))
+        self.assertEqual([(e.kind, e.loc) for e in entries], [('sitemap', 'http://x.org/s1.xml')])
+
+    def test_size_limit(self):
+        bomb = gzip.compress(urlset(*[('http://x.org/%d' % i, '') for i in range(2000)]))
+        with self.assertRaises(SitemapError):
+            list(iter_sitemap(io.BytesIO(bomb), max_bytes=10000))
+
+    def test_streaming_memory(self):
+        def peak(n):
+            data = urlset(*[('http://x.org/page/%d' % i, '<lastmod>2020-01-01</lastmod>') for i in range(n)])
+            source = io.BytesIO(data)
+            del data
+            tracemalloc.start()
+            try:
+                count = sum(1 for _ in iter_sitemap(source))
+                return count, tracemalloc.get_traced_memory()[1]
+            finally:
+                tracemalloc.stop()
+
+        small, big = peak(100), peak(10000)
+        self.assertEqual((small[0], big[0]), (100, 10000))
+        self.assertLess(big[1], small[1] * 3)
+
+    def test_seed_priority(self):
+        day = 86400.0
+        entry = SitemapEntry('url', 'u', 100 * day, 0.8, None)
+        self.assertAlmostEqual(seed_priority(entry, now=100 * day), 1.6)
+        self.assertAlmostEqual(seed_priority(entry, now=130 * day), 1.2)
+        self.assertEqual(seed_priority(SitemapEntry('url', 'u', None, None, None)), 0.5)
+
+
+class TestDiscovery(unittest.TestCase):
+    def test_robots_and_fallback(self):
+        session = FakeSession({'http://x.org/robots.txt': b'User-agent: *\nSitemap: /maps/index.xml\n'})
+        self.assertEqual(discover(session, 'http://x.org/blog/'), ['http://x.org/maps/index.xml'])
+        self.assertEqual(discover(FakeSession({}), 'http://x.org/'), ['http://x.org/sitemap.xml'])
+
+    def test_walk_follows_indexes(self):
+        session = FakeSession({
+            'http://x.org/index.xml': index('http://x.org/s1.xml', 'http://x.org/s2.xml.gz',
+                                            'http://x.org/missing.xml'),
+            'http://x.org/s1.xml': urlset(('http://x.org/a', ''), ('http://y.org/b', '')),
+            'http://x.org/s2.xml.gz': gzip.compress(urlset(('http://x.org/c', ''))),
+        })
+        locs = [e.loc for e in walk(session, ['http://x.org/index.xml'],
+                                    allow=lambda u: u.startswith('http://x.org/'))]
+        self.assertEqual(locs, ['http://x.org/a', 'http://x.org/c'])
+        self.assertEqual(len(list(walk(session, ['http://x.org/index.xml'], max_depth=0))), 0)
+        self.assertEqual(len(list(walk(session, ['http://x.org/index.xml'], max_urls=1))), 1)
+
+
+class TestSeeding(unittest.TestCase):
+    def test_deep_page_is_fetched_first(self):
+        base = 'http://x.org/'
+        # a chain of pages, the last one is only reachable after 10 hops
+        files = {base + 'robots.txt': b'Sitemap: http://x.org/sitemap.xml\n'}
+        for i in range(10):
+            files[base + 'p%d.html' % i] = ('<html><body><a href="p%d.html">next</a></body></html>' % (i + 1)).encode()
+        files[base] = b'<html><body><a href="p0.html">start</a></body></html>'
+        files[base + 'p10.html'] = b'<html><body>deep</body></html>'
+        files[base + 'sitemap.xml'] = urlset(
+            (base + 'p10.html', '<priority>1.0</priority>'), ('http://other.org/x.html', ''))
+
+        folder = tempfile.mkdtemp()
+        try:
+            config = get_config(base, folder, 'sitemaps', bypass_robots=True)
+            session = FakeSession(files)
+            scheduler = frontier_crawler_scheduler(max_pages=3)
+            crawler = Crawler(session, config, scheduler, config.create_context())
+            crawler.get(base)
+            self.assertEqual(seed_frontier(crawler), 1)
+            crawler.save_complete()
+            pages = [u for u in session.requested if u.endswith('.html') or u == base]
+            self.assertIn(base + 'p10.html', pages)
+            self.assertNotIn('http://other.org/x.html', session.requested)
+            self.assertEqual(seed_frontier(crawler), 0)
+        finally:
+            shutil.rmtree(folder, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    unittest.main()
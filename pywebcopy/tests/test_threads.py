@@ -0,0 +1,143 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import io
+import shutil
+import sys
+import tempfile
+import threading
+import time
+import unittest
+
+from requests import Request
+from requests import Response
+from six.moves.urllib.robotparser import RobotFileParser
+
+from pywebcopy.configs import get_config
+from pywebcopy.elements import HTMLResource
+from pywebcopy.helpers import lru_cache
+from pywebcopy.schedulers import Index
+from pywebcopy.schedulers import crawler_scheduler
+from pywebcopy.session import Session
+from pywebcopy.urls import Context
+from pywebcopy.urls import HIERARCHY
+
+
+def hammer(target, threads=8):
+    """Runs `target(i)` on many threads at once and re-raises the first
+    error; a tiny switch interval makes races likely on GIL builds too."""
+    errors = []
+    barrier = threading.Barrier(threads)
+
+    def run(i):
+        barrier.wait()
+        try:
+            target(i)
+        except Exception as e:  # pragma: no cover
+            errors.append(e)
+
+    interval = sys.getswitchinterval()
+    sys.setswitchinterval(1e-6)
+    try:
+        workers = [threading.Thread(target=run, args=(i,)) for i in range(threads)]
+        for t in workers:
+            t.start()
+        for t in workers:
+            t.join()
+    finally:
+        sys.setswitchinterval(interval)
+    if errors:
+        raise errors[0]
+
+
+class TestSharedStructures(unittest.TestCase):
+    def test_index(self):
+        index = Index()
+        claims = []
+
+        def run(i):
+            for k in range(2000):
+                url = 'http://x.org/%d' % (k % 300)
+                index.get_entry(url)
+                if index.claim(url, 'path%d' % k) is None:
+                    claims.append(url)
+                if k % 7 == 0:
+                    list(index.items())
+
+        hammer(run)
+        self.assertEqual(len(index), 300)
+        # every url was processed by exactly one thread
+        self.assertEqual(sorted(claims), sorted(index.keys()))
+
+    def test_lru_cache(self):
+        @lru_cache(maxsize=50)
+        def square(x):
+            return x * x
+
+        def run(i):
+            for k in range(3000):
+                self.assertEqual(square(k % 80), (k % 80) ** 2)
+                if k % 500 == 0:
+                    square.cache_clear()
+
+        hammer(run)
+
+    def test_robots_are_loaded_once(self):
+        loads = []
+
+        class CountingSession(Session):
+            def load_rules_from_url(self, robots_url, timeout=None):
+                loads.append(robots_url)
+                time.sleep(0.01)  # a slow server widens the race
+                parser = RobotFileParser()
+                parser.parse(['User-agent: *', 'Disallow: /private'])
+                self.robots_registry[robots_url] = parser
+                return parser
+
+        session = CountingSession()
+        session.set_follow_robots_txt(True)
+
+        def run(i):
+            for k in range(50):
+                host = 'host%d.org' % ((i + k) % 5)
+                self.assertTrue(session.is_allowed(Request('GET', 'http://%s/page' % host)))
+                self.assertFalse(session.is_allowed(Request('GET', 'http://%s/private' % host)))
+                last_host, rules = session._last
+                self.assertIs(session.robots_registry['http://%s/robots.txt' % last_host], rules)
+
+        hammer(run)
+        self.assertEqual(sorted(loads), ['http://host%d.org/robots.txt' % i for i in range(5)])
+
+
+class TestParallelRetrieve(unittest.TestCase):
+    def test_pages_share_one_scheduler(self):
+        folder = tempfile.mkdtemp()
+        try:
+            config = get_config('http://localhost/', folder, 'threads', bypass_robots=True).freeze()
+            scheduler = crawler_scheduler()
+            handled = []
+            # children are claimed in the shared index but not fetched
+            scheduler._handle_resource = handled.append
+
+            def run(i):
+                for k in range(20):
+                    url = 'http://localhost/p%d_%d.html' % (i, k)
+                    body = ''.join('<a href="/c%d.html">c</a><img src="/i%d.png">' % (j, j)
+                                   for j in range(30))
+                    response = Response()
+                    response.status_code = 200
+                    response.url = url
+                    response.headers['Content-Type'] = 'text/html'
+                    response.raw = io.BytesIO(('<html><body>%s</body></html>' % body).encode())
+                    context = Context(url, 'http://localhost/', folder, HIERARCHY)
+                    HTMLResource(None, config, scheduler, context, response).retrieve()
+
+            hammer(run)
+            urls = [r.context.url for r in handled]
+            self.assertEqual(len(urls), len(set(urls)))
+            self.assertEqual(len(urls), 60)
+        finally:
+            shutil.rmtree(folder, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,84 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+import unittest
+
+from pywebcopy.configs import get_config
+from pywebcopy.elements import HTMLResource
+from pywebcopy.schedulers import crawler_scheduler
+from pywebcopy.traps import ALLOW
+from pywebcopy.traps import DEMOTE
+from pywebcopy.traps import REFUSE
+from pywebcopy.traps import TrapDetector
+from pywebcopy.traps import template
+
+
+class TestTemplate(unittest.TestCase):
+    def test_numbers_dates_and_ids(self):
+        self.assertEqual(template('http://Example.com/events/2021/03/14/list.html?page=7&sort=asc'),
+                         ('example.com', '/events/{n}/{n}/{n}/list.html?page&sort'))
+        self.assertEqual(template('http://x.org/day/2021-03-14')[1], '/day/{date}')
+        self.assertEqual(template('http://x.org/item/9f86d081884c7d65')[1], '/item/{id}')
+        self.assertEqual(template('http://x.org/about/')[1], '/about')
+
+
+class TestTrapDetector(unittest.TestCase):
+    def test_ordinary_urls_are_allowed(self):
+        traps = TrapDetector()
+        for i in range(50):
+            self.assertEqual(traps.check('http://x.org/page/%d.html' % i), (ALLOW, None))
+        self.assertEqual(traps.report(), [])
+
+    def test_depth_and_repeated_segments(self):
+        traps = TrapDetector(max_depth=5, max_repeats=2)
+        self.assertEqual(traps.check('http://x.org/a/b/c/d/e/f'), (REFUSE, 'depth'))
+        self.assertEqual(traps.check('http://x.org/a/b/a/b'), (ALLOW, None))
+        self.assertEqual(traps.check('http://x.org/a/b/a/b/a'), (REFUSE, 'repeated segments'))
+
+    def test_calendar_is_demoted_then_refused(self):
+        traps = TrapDetector(max_per_template=10)
+        decisions = [traps.check('http://x.org/calendar/%d/%d' % divmod(i, 12))[0] for i in range(30)]
+        self.assertEqual(decisions, [ALLOW] * 10 + [DEMOTE] * 10 + [REFUSE] * 10)
+        self.assertEqual(traps.check('http://x.org/about.html'), (ALLOW, None))
+        self.assertEqual(traps.check('http://y.org/calendar/1/1'), (ALLOW, None))
+        report = traps.report()
+        self.assertEqual(len(report), 1)
+        self.assertEqual(report[0]['host'], 'x.org')
+        self.assertEqual((report[0]['demoted'], report[0]['refused']), (10, 10))
+        self.assertIn(('/calendar/{n}/{n}', 'template', DEMOTE, 10), report[0]['patterns'])
+
+    def test_parameter_cardinality(self):
+        traps = TrapDetector(max_param_values=3)
+        for sid in 'abc':
+            self.assertEqual(traps.check('http://x.org/?sid=%s' % sid)[0], ALLOW)
+        self.assertEqual(traps.check('http://x.org/p?sid=d'), (DEMOTE, 'parameter sid'))
+        self.assertEqual(traps.check('http://x.org/q?sid=a')[0], ALLOW)
+
+    def test_trapped_host(self):
+        traps = TrapDetector(max_depth=2, max_host_refusals=3)
+        for i in range(3):
+            traps.check('http://x.org/a/b/c/%d' % i)
+        self.assertTrue(traps.is_trapped('X.org'))
+        self.assertEqual(traps.check('http://x.org/index.html'), (REFUSE, 'trapped host'))
+        self.assertEqual(traps.check('http://y.org/index.html'), (ALLOW, None))
+
+
+class TestSchedulerTraps(unittest.TestCase):
+    def test_scheduler_demotes_and_refuses(self):
+        config = get_config('http://x.org/', bypass_robots=True)
+        context = config.create_context()
+        scheduler = crawler_scheduler()
+        scheduler.traps = TrapDetector(max_per_template=1)
+
+        def resource(url):
+            return HTMLResource(None, config, scheduler, context.create_new_from_url(url))
+
+        first, second, third = resource('/p/1'), resource('/p/2'), resource('/p/3')
+        self.assertTrue(scheduler.validate_resource(first))
+        self.assertTrue(first.follow_links)
+        self.assertTrue(scheduler.validate_resource(second))
+        self.assertFalse(second.follow_links)
+        self.assertFalse(scheduler.validate_resource(third))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -13,6 +13,7 @@ from pywebcopy.urls import get_prefix
 from pywebcopy.urls import common_suffix_map
 from pywebcopy.urls import get_suffix
 from pywebcopy.urls import get_content_type_from_headers
+from pywebcopy.urls import guess_content_type
 from pywebcopy.urls import Url
 from pywebcopy.urls import parse_url
 from pywebcopy.urls import get_host
@@ -49,6 +50,13 @@ class TestBasicTools(unittest.TestCase):
         self.assertEqual(None, get_content_type_from_headers({}, default=None))
         self.assertEqual('text/html', get_content_type_from_headers({}, default='text/html'))
 
+    def test_guess_content_type(self):
+        self.assertEqual('application/javascript', guess_content_type('http://x.org/a.js?v=1.css'))
+        self.assertEqual('image/png', guess_content_type('http://x.org/IMG.PNG#a.css'))
+        self.assertEqual('text/html', guess_content_type('http://x.org/a.htm'))
+        self.assertEqual('text/css', guess_content_type('http://x.org/a.b/style', 'text/css'))
+        self.assertIsNone(guess_content_type('http://x.org/page.php'))
+
     def test_parse_url(self):
         # This functionality is copied from urllib3 so it shouldn't require rigorous testing.
         self.assertEqual(parse_url('http://google.com/mail/'),
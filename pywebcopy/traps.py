@@ -0,0 +1,194 @@
+# Copyright 2020; Raja Tomar
+# See license for more details
+"""
+Crawler trap detection from url pattern statistics.
+
+Calendars, endless pagination, session ids and recursive relative links
+(`/a/b/a/b/...`) produce an unbounded number of distinct urls on one host.
+The detector reduces every url to a path template, numbers become `{n}`,
+hex ids `{id}` and dates `{date}`, and keeps compact per-host statistics::
+
+    /events/2021/03/14/list.html?page=7&sort=asc
+    -> /events/{n}/{n}/{n}/list.html?page&sort
+
+A url is checked against these thresholds, in this order:
+
+    max_depth           path segments; deeper urls are refused
+    max_repeats         occurrences of one segment in the path (`/a/b/a/b/a`);
+                        more are refused
+    max_param_values    distinct values of one query parameter on a host;
+                        urls with further new values are demoted
+    max_per_template    urls sharing a template; further urls are demoted,
+                        past twice the limit they are refused
+    max_host_refusals   refusals on one host after which the host is trapped
+                        and every further new url of it is refused
+
+A demoted page is still saved but its links to other pages are left
+absolute so the pattern stops spreading; a refused url is not fetched.
+
+Usage::
+
+    traps = TrapDetector(max_per_template=200)
+    scheduler.traps = traps
+    ...
+    for host in traps.report():
+        print(host['host'], host['refused'], host['patterns'])
+"""
+import logging
+import re
+import threading
+from collections import Counter
+
+from six.moves.urllib.parse import urlsplit
+
+__all__ = ['TrapDetector', 'template', 'ALLOW', 'DEMOTE', 'REFUSE']
+
+logger = logging.getLogger(__name__)
+
+ALLOW = 'allow'
+DEMOTE = 'demote'
+REFUSE = 'refuse'
+
+_number = re.compile(r'\d+')
+_date = re.compile(r'\d{4}-\d{1,2}(?:-\d{1,2})?')
+_ident = re.compile(r'(?i)[0-9a-f]{8,}|[0-9a-f]{8}(?:-[0-9a-f]{4}){3}-[0-9a-f]{12}')
+
+
+def _segment(seg):
+    if _ident.fullmatch(seg) and not seg.isalpha():
+        return '{id}'
+    seg = _date.sub('{date}', seg)
+    return _number.sub('{n}', seg)
+
+
+def _split(url):
+    parts = urlsplit(url)
+    segments = [s for s in parts.path.split('/') if s]
+    params = [p.partition('=') for p in parts.query.split('&') if p]
+    return (parts.hostname or '').lower(), segments, params
+
+
+def template(url):
+    """Returns `(host, template)` of the url, see the module docs."""
+    host, segments, params = _split(url)
+    return host, _template(segments, params)
+
+
+def _template(segments, params):
+    path = '/' + '/'.join(_segment(s) for s in segments)
+    if params:
+        path += '?' + '&'.join(sorted(set(k for k, _, _ in params)))
+    return path
+
+
+class _HostStats(object):
+    __slots__ = ('templates', 'values', 'seen', 'demoted', 'refused', 'patterns', 'trapped')
+
+    def __init__(self):
+        self.templates = Counter()
+        #: parameter -> set of values, stops growing at the threshold
+        self.values = {}
+        self.seen = 0
+        self.demoted = 0
+        self.refused = 0
+        #: (template, reason, decision) -> count
+        self.patterns = {}
+        self.trapped = False
+
+
+class TrapDetector(object):
+    """Per-host url statistics deciding whether a new url is allowed,
+    demoted (saved without following its links) or refused.
+
+    All limits are counted in distinct urls; the schedulers only consult
+    the detector for urls which are not in their index yet.
+    """
+
+    def __init__(self, max_depth=16, max_repeats=2, max_per_template=500,
+                 max_param_values=100, max_host_refusals=1000):
+        self.max_depth = max_depth
+        self.max_repeats = max_repeats
+        self.max_per_template = max_per_template
+        self.max_param_values = max_param_values
+        self.max_host_refusals = max_host_refusals
+        self.hosts = {}
+        self.lock = threading.Lock()
+
+    def __repr__(self):
+        return '<TrapDetector(%d hosts)>' % len(self.hosts)
+
+    def check(self, url):
+        """Returns `(decision, reason)` for a new url, reason is None for
+        allowed urls."""
+        host, segments, params = _split(url)
+        tpl = _template(segments, params)
+        with self.lock:
+            stats = self.hosts.get(host)
+            if stats is None:
+                stats = self.hosts[host] = _HostStats()
+            stats.seen += 1
+            decision, reason = self._decide(stats, segments, params, tpl)
+            if decision is ALLOW:
+                return decision, reason
+            key = (tpl, reason, decision)
+            count = stats.patterns.get(key, 0)
+            stats.patterns[key] = count + 1
+            if decision is DEMOTE:
+                stats.demoted += 1
+            else:
+                stats.refused += 1
+                if not stats.trapped and stats.refused >= self.max_host_refusals:
+                    stats.trapped = True
+                    logger.warning("Host [%s] is trapped after %d refused urls.", host, stats.refused)
+        if count == 0:
+            logger.info("Crawler trap %s: %s on [%s] (%s)", reason, tpl, host, decision)
+        return decision, reason
+
+    def _decide(self, stats, segments, params, tpl):
+        if stats.trapped:
+            return REFUSE, 'trapped host'
+        if len(segments) > self.max_depth:
+            return REFUSE, 'depth'
+        if segments and max(Counter(segments).values()) > self.max_repeats:
+            return REFUSE, 'repeated segments'
+
+        demote = None
+        for key, _, value in params:
+            values = stats.values.setdefault(key, set())
+            if value in values:
+                continue
+            if len(values) >= self.max_param_values:
+                demote = 'parameter ' + key
+            else:
+                values.add(value)
+
+        count = stats.templates[tpl] = stats.templates[tpl] + 1
+        if count > 2 * self.max_per_template:
+            return REFUSE, 'template'
+        if count > self.max_per_template:
+            return DEMOTE, 'template'
+        if demote is not None:
+            return DEMOTE, demote
+        return ALLOW, None
+
+    def is_trapped(self, host):
+        stats = self.hosts.get(host.lower())
+        return stats is not None and stats.trapped
+
+    def report(self):
+        """Returns a list with one dict per host which had demoted or
+        refused urls, patterns are `(template, reason, decision, count)`
+        sorted by count."""
+        out = []
+        with self.lock:
+            for host, stats in self.hosts.items():
+                if not stats.patterns:
+                    continue
+                patterns = sorted((key + (count,) for key, count in stats.patterns.items()),
+                                  key=lambda p: -p[3])
+                out.append({
+                    'host': host, 'seen': stats.seen, 'demoted': stats.demoted,
+                    'refused': stats.refused, 'trapped': stats.trapped, 'patterns': patterns,
+                })
+        out.sort(key=lambda h: -(h['refused'] + h['demoted']))
+        return out
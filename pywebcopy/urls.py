@@ -24,7 +24,9 @@ from six import binary_type
 from six import string_types
 from six.moves.urllib.parse import unquote
 from six.moves.urllib.parse import urljoin
+from six.moves.urllib.parse import urlsplit
 
+from . import events
 from .helpers import lru_cache
 
 __all__ = [
@@ -32,6 +34,7 @@ __all__ = [
     'parse_url', 'parse_header', 'get_host', 'get_prefix', 'get_suffix',
     'Url', 'LocationParseError', 'secure_filename', 'split_first',
     'common_prefix_map', 'common_suffix_map', 'get_content_type_from_headers',
+    'common_type_map', 'guess_content_type',
     'Context', 'ContextError', 'retrieve_resource', 'urlretrieve'
 ]
 
@@ -388,6 +391,25 @@ def get_prefix(content_type):
     return common_prefix_map.get(content_type)
 
 
+# content types of the extensions of the suffix map, where several types
+# share an extension the first one wins.
+common_type_map = {}
+for _ctype, _suffix in common_suffix_map.items():
+    common_type_map.setdefault(_suffix, _ctype)
+common_type_map['.htm'] = 'text/html'
+# server side scripts answer with anything, mostly html
+common_type_map.pop('.php')
+del _ctype, _suffix
+
+
+def guess_content_type(url, default=None):
+    """Guesses the content type of `url` from its extension before it is
+    fetched, returns `default` for unknown extensions."""
+    path = urlsplit(url).path
+    ext = os.path.splitext(path.rpartition('/')[2])[1].lower()
+    return common_type_map.get(ext, default)
+
+
 HIERARCHY = 'HIERARCHY'
 LINEAR = 'LINEAR'
 
@@ -679,17 +701,15 @@ def make_fd(location, url=None, overwrite=False):
     except (OSError, IOError) as e:
         if e.errno == errno.EEXIST or ((os.name == 'nt' and os.path.isdir(
                 base_dir) and os.access(base_dir, os.W_OK))):
-            logger.debug(
-                "[FILE] Sub-directories exists for: <%r>" % location)
+            events.log(logger, events.FILE_DIRS_EXIST, location)
         # dead on arrival
         else:
             logger.error(
                 "[File] Failed to create target location <%r> "
-                "for the file <%r> on the disk." % (location, url))
+                "for the file <%r> on the disk.", location, url)
             return -1
     else:
-        logger.debug(
-            "[File] Sub-directories created for: <%r>" % location)
+        events.log(logger, events.FILE_DIRS_CREATED, location)
     try:
 
         # sys.audit("%s.resource" % __title__, location)
@@ -702,14 +722,13 @@ def make_fd(location, url=None, overwrite=False):
 
     except (OSError, IOError) as e:
         if e.errno == errno.EEXIST:
-            logger.debug(
-                "[FILE] <%s> already exists at: <%s>" % (url, location))
+            events.log(logger, events.FILE_EXISTS, url, location)
         elif e.errno == errno.ENAMETOOLONG:
             logger.debug(
-                "[FILE] Path too long for <%s> at: <%s>" % (url, location))
+                "[FILE] Path too long for <%s> at: <%s>", url, location)
         else:
             logger.error(
-                "[File] Cannot write <%s> to <%s>! %r" % (url, location, e))
+                "[File] Cannot write <%s> to <%s>! %r", url, location, e)
         return -1
     else:
         return fd
@@ -735,9 +754,7 @@ def retrieve_resource(content, location, url=None, overwrite=False):
     if url is None:
         raise ValueError("Url can't be of NoneType.")
 
-    logger.debug(
-        "[File] Preparing to write file from <%r> to the disk at <%r>."
-        % (url, location))
+    events.log(logger, events.FILE_PREPARE, url, location)
 
     fd = make_fd(location, url, overwrite)
     if fd == -1:
@@ -746,8 +763,7 @@ def retrieve_resource(content, location, url=None, overwrite=False):
     with closing(os.fdopen(fd, 'w+b')) as dst:
         copyfileobj(content, dst)
 
-    logger.info(
-        "[File] Written the file from <%s> to <%s>" % (url, location))
+    events.log(logger, events.FILE_WRITTEN, url, location)
     return location
 
 
@@ -787,9 +803,10 @@ class Context(namedtuple('Context', context_attrs)):
 
     @classmethod
     def from_config(cls, config):
-        url = config.get('project_url')
-        path = config.get('project_folder')
-        tree_type = config.get('tree_type')
+        config = config.freeze()
+        url = config.project_url
+        path = config.project_folder
+        tree_type = config.tree_type
         if None in (url, path, tree_type):
             raise AttributeError("Values can't be NoneType.", url, path, tree_type)
         return cls(url, url, path, tree_type, None)
@@ -39,6 +39,7 @@ setup(
     classifiers=[
         "License :: OSI Approved :: MIT License",
         "Programming Language :: Python :: 3",
+        "Programming Language :: Python :: Free Threading :: 2 - Beta",
         "Operating System :: OS Independent",
     ],
 )